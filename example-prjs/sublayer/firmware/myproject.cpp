@@ -91,12 +91,8 @@ void myproject(
 }
 
 void compute_layer2(layer1_t layer1_out[N_LAYER_1], layer2_t logits2[N_LAYER_2]) {
-    layer2_t logits2_0[16];
-    #pragma HLS ARRAY_PARTITION variable=logits2_0 complete dim=0
-    layer2_t logits2_1[16];
-    #pragma HLS ARRAY_PARTITION variable=logits2_1 complete dim=0
-    nnet::compute_layer<layer1_t, layer2_t, config2_0>(layer1_out, logits2_0, w2_0, b2_0);
-    nnet::compute_layer<layer1_t, layer2_t, config2_1>(layer1_out, logits2_1, w2_1, b2_1);
-    nnet::merge<layer2_t, 16, 16>(logits2_0, logits2_1, logits2);
+    #pragma HLS INLINE recursive
+    nnet::compute_layer<layer1_t, layer2_t, config2_0>(layer1_out, &logits2[0], w2_0, b2_0);
+    nnet::compute_layer<layer1_t, layer2_t, config2_1>(layer1_out, &logits2[16], w2_1, b2_1);
 }
 
@@ -0,0 +1,10 @@
+#!/bin/bash
+# Builds the C model as a shared library with the C interface of myproject_bridge.cpp,
+# for hls-writer/csim_library.py. The ap_fixed headers are taken from the Vivado HLS
+# install, or from AP_TYPES_INCLUDE. Extra compiler flags go in CXXFLAGS, e.g.
+# -DNNET_FAST_CSIM or -DNNET_WEIGHTS_MEM (see nnet_weights.h)
+cd "$(dirname "$0")"
+AP_TYPES_INCLUDE=${AP_TYPES_INCLUDE:-${XILINX_VIVADO}/include}
+${CXX:-g++} -std=c++11 -O2 -fPIC -shared -pthread -I"${AP_TYPES_INCLUDE}" -Innet_utils \
+  -DNNET_WEIGHTS_DIR="\"$(pwd)/firmware/weights/\"" ${CXXFLAGS} \
+  myproject_bridge.cpp firmware/myproject.cpp -o libmyproject.so
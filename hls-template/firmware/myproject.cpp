@@ -24,9 +24,11 @@
 #include "nnet_layer.h"
 #include "nnet_conv.h"
 #include "nnet_conv2d.h"
+#include "nnet_sepconv2d.h"
 #include "nnet_batchnorm.h"
 #include "nnet_activation.h"
 #include "nnet_pooling.h"
+#include "nnet_merge.h"
 
 //hls-fpga-machine-learning insert weights
 
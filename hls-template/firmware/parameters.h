@@ -7,10 +7,15 @@
 #include "nnet_layer.h"
 #include "nnet_conv.h"
 #include "nnet_conv2d.h"
+#include "nnet_sepconv2d.h"
+#include "nnet_binary.h"
 #include "nnet_activation.h"
 #include "nnet_common.h"
 #include "nnet_batchnorm.h"
 #include "nnet_pooling.h"
+#include "nnet_merge.h"
+#include "nnet_fixed.h"
+#include "nnet_stream.h"
 
 //hls-fpga-machine-learning insert numbers
 
@@ -0,0 +1,119 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// Runs the C model over a file of events on several threads:
+//   myproject_batch INPUT_FILE OUTPUT_FILE [N_THREADS]
+// The input file is either a binary tensor file (see nnet_tensor.h) or a text file
+// with the flattened inputs of one event per line. The outputs are written in the
+// same format.
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+#include "firmware/parameters.h"
+#include "firmware/myproject.h"
+#include "nnet_batch.h"
+#include "nnet_tensor.h"
+
+//hls-fpga-machine-learning insert event size
+
+void run_event(input_t *data, result_t *res)
+{
+  unsigned short size_in, size_out;
+  //hls-fpga-machine-learning insert top call
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " INPUT_FILE OUTPUT_FILE [N_THREADS]" << std::endl;
+    return 1;
+  }
+  unsigned n_threads = argc > 3 ? atoi(argv[3]) : 0;
+
+  std::vector<input_t> data;
+  nnet::tensor_file tensor;
+  int status = nnet::open_tensor_file(argv[1], tensor);
+  bool binary = status == 0;
+  if (status == -1) {
+    std::cerr << "ERROR: Cannot open " << argv[1] << std::endl;
+    return 1;
+  }
+  if (binary) {
+    if (tensor.event_size != N_EVENT_INPUTS) {
+      std::cerr << "ERROR: Expected " << N_EVENT_INPUTS << " inputs per event, got " << tensor.event_size << std::endl;
+      return 1;
+    }
+    data.resize(tensor.shape[0] * N_EVENT_INPUTS);
+    nnet::read_tensor_events(tensor, 0, tensor.shape[0], data.data());
+    nnet::close_tensor_file(tensor);
+  } else {
+    std::ifstream fin(argv[1]);
+    std::string line;
+    while (std::getline(fin, line)) {
+      std::istringstream values(line);
+      float x;
+      unsigned n = 0;
+      while (values >> x) {
+        data.push_back(x);
+        n++;
+      }
+      if (n != 0 && n != N_EVENT_INPUTS) {
+        std::cerr << "ERROR: Expected " << N_EVENT_INPUTS << " inputs per event, got " << n << std::endl;
+        return 1;
+      }
+    }
+  }
+  unsigned n_events = data.size() / N_EVENT_INPUTS;
+
+  std::vector<result_t> res(n_events * N_OUTPUTS);
+  nnet::batch_stats stats = nnet::run_batch<input_t, result_t, N_EVENT_INPUTS, N_OUTPUTS>(run_event, data.data(), res.data(), n_events, n_threads);
+
+  if (binary) {
+    if (nnet::write_tensor_file(argv[2], res.data(), n_events, N_OUTPUTS) != 0) {
+      std::cerr << "ERROR: Cannot write " << argv[2] << std::endl;
+      return 1;
+    }
+  } else {
+    std::ofstream fout(argv[2]);
+    for (unsigned i = 0; i < n_events; i++) {
+      for (int j = 0; j < N_OUTPUTS; j++) {
+        fout << res[i * N_OUTPUTS + j] << " ";
+      }
+      fout << std::endl;
+    }
+  }
+  std::cout << stats << std::endl;
+
+#ifdef NNET_TRACE
+  // Outputs of every layer, for hls-writer/compare_trace.py
+  int n_layers = nnet::write_trace("trace");
+  if (n_layers < 0) {
+    std::cerr << "ERROR: Cannot write the layer outputs to trace/" << std::endl;
+    return 1;
+  }
+  std::cout << "Wrote the outputs of " << n_layers << " layers to trace/" << std::endl;
+#endif
+
+  return 0;
+}
@@ -0,0 +1,94 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// C interface of the C model, loaded through ctypes by hls-writer/csim_library.py and
+// built as libmyproject.so by build_lib.sh. Each call runs a batch of events through the
+// firmware arithmetic on several threads (see nnet::run_batch, n_threads 0 uses one per
+// hardware thread). The events are flattened as for the batch runner, N_EVENT_INPUTS
+// values in and N_OUTPUTS values out per event.
+//   myproject_predict: the values as doubles, converted to input_t and from result_t
+//   myproject_predict_fixed: the values as the integers k of k * 2^-frac_bits, the raw
+//     bits of input_t and result_t, see myproject_frac_bits
+// They return 0, myproject_predict_fixed -1 when the types are not fixed point.
+
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+
+#include "firmware/parameters.h"
+#include "firmware/myproject.h"
+#include "nnet_batch.h"
+
+//hls-fpga-machine-learning insert event size
+
+static void run_event(input_t *data, result_t *res)
+{
+  unsigned short size_in, size_out;
+  //hls-fpga-machine-learning insert top call
+}
+
+extern "C" {
+
+int myproject_n_inputs()
+{
+  return N_EVENT_INPUTS;
+}
+
+int myproject_n_outputs()
+{
+  return N_OUTPUTS;
+}
+
+// Fractional bits of input_t (which = 0) and result_t (which = 1), -1 when the type is
+// not fixed point or too wide for the integers of the values to be exact doubles
+int myproject_frac_bits(int which)
+{
+  return which == 0 ? INPUT_FRAC_BITS : RESULT_FRAC_BITS;
+}
+
+int myproject_predict(const double *data, double *res, unsigned n_events, unsigned n_threads)
+{
+  std::vector<input_t> in(data, data + (size_t) n_events * N_EVENT_INPUTS);
+  std::vector<result_t> out((size_t) n_events * N_OUTPUTS);
+  nnet::run_batch<input_t, result_t, N_EVENT_INPUTS, N_OUTPUTS>(run_event, in.data(), out.data(), n_events, n_threads);
+  for (size_t i = 0; i < out.size(); i++) {
+    res[i] = (double) out[i];
+  }
+  return 0;
+}
+
+int myproject_predict_fixed(const int64_t *data, int64_t *res, unsigned n_events, unsigned n_threads)
+{
+  if (INPUT_FRAC_BITS < 0 || RESULT_FRAC_BITS < 0) {
+    return -1;
+  }
+  // Exact, the values are multiples of 2^-frac_bits in the range of the types
+  std::vector<input_t> in((size_t) n_events * N_EVENT_INPUTS);
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i] = ldexp((double) data[i], -INPUT_FRAC_BITS);
+  }
+  std::vector<result_t> out((size_t) n_events * N_OUTPUTS);
+  nnet::run_batch<input_t, result_t, N_EVENT_INPUTS, N_OUTPUTS>(run_event, in.data(), out.data(), n_events, n_threads);
+  for (size_t i = 0; i < out.size(); i++) {
+    res[i] = (int64_t) ldexp((double) out[i], RESULT_FRAC_BITS);
+  }
+  return 0;
+}
+
+}
@@ -0,0 +1,158 @@
+from __future__ import print_function
+import numpy as np
+import argparse
+import importlib
+import os
+import re
+import sys
+from tensor_file import MAGIC, read_tensor_file
+from hls_writer import parse_config
+
+#######################################
+## Layer outputs of the C model, as
+## written by nnet_utils/nnet_trace.h
+#######################################
+def read_trace(dirname):
+
+    layers = []
+    with open(os.path.join(dirname, 'trace.txt')) as f:
+        for n, line in enumerate(f.readlines()):
+            fields = line.split(None, 3)
+            if not fields:
+                continue
+            if len(fields) != 4 or not fields[2].isdigit():
+                raise Exception('ERROR: Invalid layer on line {} of {}: {}'.format(n+1, os.path.join(dirname, 'trace.txt'), line.strip()))
+            values = read_tensor_file(os.path.join(dirname, fields[0] + '.bin'))
+            layers.append({'name': fields[0], 'layout': fields[1], 'precision': fields[3].strip(), 'values': np.asarray(values, dtype=np.float64)})
+    return layers
+
+def read_events(filename):
+
+    # Same inputs as the batch runner, a tensor file or one event per line
+    with open(filename, 'rb') as f:
+        binary = f.read(len(MAGIC)) == MAGIC
+    if binary:
+        x = np.asarray(read_tensor_file(filename), dtype=np.float64)
+    else:
+        x = np.loadtxt(filename, ndmin=2, dtype=np.float64)
+    return x.reshape(x.shape[0], -1)
+
+def get_type_range(precision):
+
+    # (min, max) of ap_fixed, ap_ufixed, ap_int and ap_uint, None for other types
+    m = re.match(r'\s*ap_(u?)(fixed|int)\s*<\s*(\d+)\s*(?:,\s*(-?\d+))?', precision)
+    if m is None or (m.group(2) == 'fixed' and m.group(4) is None):
+        return None
+    width = int(m.group(3))
+    integer = int(m.group(4)) if m.group(2) == 'fixed' else width
+    lsb = 2.0**(integer - width)
+    if m.group(1) == 'u':
+        return 0., 2.0**integer - lsb
+    return -2.0**(integer - 1), 2.0**(integer - 1) - lsb
+
+#######################################
+## Reference outputs of the same layers
+#######################################
+def keras_reference(yamlConfig, names, x, custom_objects):
+
+    from keras.models import Model, model_from_json
+    with open(yamlConfig['KerasJson']) as f:
+        model = model_from_json(f.read(), custom_objects=custom_objects)
+    model.load_weights(yamlConfig['KerasH5'])
+    outputs = Model(inputs=model.input, outputs=[model.get_layer(name).output for name in names]).predict(x.reshape((-1,) + tuple(model.input_shape[1:])))
+    if len(names) == 1:
+        outputs = [outputs]
+    return dict(zip(names, outputs))
+
+def pytorch_reference(yamlConfig, names, x):
+
+    # Layer names are the indices of the modules of a Sequential, see pytorch-to-hls.py
+    import torch
+    model = torch.load(yamlConfig['PytorchModel'], map_location=lambda storage, loc: storage)
+    model.eval()
+    outputs = {}
+    for name in names:
+        model._modules[name].register_forward_hook(lambda module, inputs, output, name=name: outputs.__setitem__(name, output.detach().numpy()))
+    with torch.no_grad():
+        model(torch.from_numpy(x))
+    return outputs
+
+def get_reference(args, names, x):
+
+    if args.reference:
+        reference = np.load(args.reference)
+        return dict((name, reference[name]) for name in names if name in reference.files)
+    configDir = os.path.abspath(os.path.dirname(args.config))
+    yamlConfig = parse_config(args.config)
+    for key in ['KerasJson', 'KerasH5', 'PytorchModel']:
+        if yamlConfig.get(key) and not os.path.isabs(yamlConfig[key]):
+            yamlConfig[key] = os.path.join(configDir, yamlConfig[key])
+    if yamlConfig.get('PytorchModel'):
+        return pytorch_reference(yamlConfig, names, x)
+    custom_objects = {}
+    if args.custom_objects:
+        # Layers and activations that Keras cannot load by itself, e.g. BinaryDense
+        sys.path.insert(0, os.path.dirname(os.path.abspath(args.custom_objects)))
+        module = importlib.import_module(os.path.splitext(os.path.basename(args.custom_objects))[0])
+        custom_objects = dict((key, value) for key, value in vars(module).items() if not key.startswith('_'))
+    return keras_reference(yamlConfig, names, x, custom_objects)
+
+#######################################
+## Per layer errors, overflows and
+## saturation of the C model
+#######################################
+def compare_layer(layer, ref):
+
+    hls = layer['values']
+    n_events = hls.shape[0]
+    ref = np.asarray(ref, dtype=np.float64)[:n_events]
+    if layer['layout'] == 'chw' and ref.ndim == 4:
+        ref = ref.transpose(0, 3, 1, 2)
+    ref = ref.reshape(ref.shape[0], -1)
+    if ref.shape != hls.shape:
+        print('WARNING: Layer {} has outputs of shape {} in the trace and {} in the reference, skipping it'.format(layer['name'], hls.shape, ref.shape))
+        return None
+
+    result = {'max_error': np.max(np.abs(hls - ref)), 'mean_error': np.mean(np.abs(hls - ref))}
+    # Integer bits (sign included) that hold all the reference values
+    max_abs = np.max(np.abs(ref))
+    result['int_bits'] = int(np.floor(np.log2(max_abs))) + 2 if max_abs > 0 else 1
+    type_range = get_type_range(layer['precision'])
+    if type_range is None:
+        result['overflows'] = result['saturation'] = None
+    else:
+        # References out of range wrap or saturate, outputs at the ends of the range are saturated
+        result['overflows'] = int(np.sum((ref < type_range[0]) | (ref > type_range[1])))
+        result['saturation'] = np.mean((hls <= type_range[0]) | (hls >= type_range[1]))
+    return result
+
+def main():
+
+    parser = argparse.ArgumentParser(description='Compare the layer outputs of the C model (compiled with -DNNET_TRACE, see nnet_utils/nnet_trace.h) to those of the Keras or PyTorch model')
+    parser.add_argument('trace', help='Trace directory written by the batch runner')
+    parser.add_argument('events', help='Input events given to the batch runner, tensor or text file')
+    parser.add_argument('-c', dest='config', default=None, help='Configuration file of the conversion, for the Keras or PyTorch model')
+    parser.add_argument('-r', '--reference', dest='reference', default=None, help='.npz file with the reference outputs by layer name, instead of running the model')
+    parser.add_argument('-m', '--custom-objects', dest='custom_objects', default=None, help='Python file defining the custom layers and functions of the Keras model')
+    args = parser.parse_args()
+    if not args.config and not args.reference:
+        parser.error('A configuration file or a reference file needs to be specified.')
+
+    layers = read_trace(args.trace)
+    x = read_events(args.events)
+    reference = get_reference(args, [layer['name'] for layer in layers], x)
+
+    print('{:<24} {:<28} {:>12} {:>12} {:>10} {:>10} {:>9}'.format('Layer', 'Precision', 'Max error', 'Mean error', 'Overflows', 'Saturated', 'Int bits'))
+    for layer in layers:
+        if layer['name'] not in reference:
+            print('WARNING: No reference output for layer {}, skipping it'.format(layer['name']))
+            continue
+        result = compare_layer(layer, reference[layer['name']])
+        if result is None:
+            continue
+        overflows = '-' if result['overflows'] is None else str(result['overflows'])
+        saturation = '-' if result['saturation'] is None else '{:.2%}'.format(result['saturation'])
+        print('{:<24} {:<28} {:>12.6g} {:>12.6g} {:>10} {:>10} {:>9}'.format(layer['name'], layer['precision'], result['max_error'], result['mean_error'], overflows, saturation, result['int_bits']))
+
+if __name__ == "__main__":
+    main()
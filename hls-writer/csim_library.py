@@ -0,0 +1,110 @@
+from __future__ import print_function
+import numpy as np
+import argparse
+import ctypes
+import glob
+import os
+import subprocess
+
+#######################################
+## C simulation of a generated project
+## from numpy, through the shared
+## library of build_lib.sh
+#######################################
+
+class CSimLibrary(object):
+
+    def __init__(self, project_dir, project_name=None, build=True):
+
+        self.project_dir = os.path.abspath(project_dir)
+        if project_name is None:
+            bridges = glob.glob(os.path.join(self.project_dir, '*_bridge.cpp'))
+            if len(bridges) != 1:
+                raise Exception('ERROR: Expected one *_bridge.cpp in {}, found {}'.format(self.project_dir, len(bridges)))
+            project_name = os.path.basename(bridges[0])[:-len('_bridge.cpp')]
+        self.project_name = project_name
+
+        library = os.path.join(self.project_dir, 'lib{}.so'.format(project_name))
+        if build and self._outdated(library):
+            if subprocess.call([os.path.join(self.project_dir, 'build_lib.sh')]) != 0:
+                raise Exception('ERROR: build_lib.sh failed in {}'.format(self.project_dir))
+        if not os.path.exists(library):
+            raise Exception('ERROR: Cannot find {}, run build_lib.sh first'.format(library))
+        self.lib = ctypes.CDLL(library)
+
+        for name, arg_type in [('predict', ctypes.c_double), ('predict_fixed', ctypes.c_int64)]:
+            function = getattr(self.lib, '{}_{}'.format(project_name, name))
+            function.argtypes = [ctypes.POINTER(arg_type), ctypes.POINTER(arg_type), ctypes.c_uint, ctypes.c_uint]
+            function.restype = ctypes.c_int
+        frac_bits = getattr(self.lib, '{}_frac_bits'.format(project_name))
+        frac_bits.argtypes = [ctypes.c_int]
+
+        self.n_inputs = getattr(self.lib, '{}_n_inputs'.format(project_name))()
+        self.n_outputs = getattr(self.lib, '{}_n_outputs'.format(project_name))()
+        # Fractional bits of the raw values of predict_fixed, -1 when not fixed point
+        self.input_frac_bits = frac_bits(0)
+        self.result_frac_bits = frac_bits(1)
+
+    def _outdated(self, library):
+
+        # Rebuilt when the project files were written again after the library
+        if not os.path.exists(library):
+            return True
+        sources = glob.glob(os.path.join(self.project_dir, 'firmware', '*')) + glob.glob(os.path.join(self.project_dir, 'firmware', 'weights', '*'))
+        sources.append(os.path.join(self.project_dir, '{}_bridge.cpp'.format(self.project_name)))
+        return max(os.path.getmtime(s) for s in sources) > os.path.getmtime(library)
+
+    def _run(self, name, x, dtype, n_threads):
+
+        x = np.ascontiguousarray(x, dtype=dtype)
+        if x.size % self.n_inputs != 0:
+            raise Exception('ERROR: {} values are not a whole number of events of {} inputs'.format(x.size, self.n_inputs))
+        x = x.reshape(-1, self.n_inputs)
+        y = np.zeros((x.shape[0], self.n_outputs), dtype=dtype)
+        ctype = np.ctypeslib.as_ctypes_type(np.dtype(dtype))
+        status = getattr(self.lib, '{}_{}'.format(self.project_name, name))(x.ctypes.data_as(ctypes.POINTER(ctype)), y.ctypes.data_as(ctypes.POINTER(ctype)), x.shape[0], n_threads)
+        if status != 0:
+            raise Exception('ERROR: {}_{} failed, the input and result types need to be ap_fixed/ap_ufixed of at most 53 bits'.format(self.project_name, name))
+        return y
+
+    def predict(self, x, n_threads=0):
+
+        # Events along the first axis of x, each flattened to n_inputs values.
+        # n_threads 0 uses one thread per hardware thread
+        return self._run('predict', x, np.float64, n_threads)
+
+    def predict_fixed(self, k, n_threads=0):
+
+        # Raw values: integers k of k * 2^-input_frac_bits in, of k * 2^-result_frac_bits out
+        return self._run('predict_fixed', k, np.int64, n_threads)
+
+#######################################
+## Command line
+#######################################
+def main():
+
+    parser = argparse.ArgumentParser(description='Run events through the C simulation of a generated project')
+    parser.add_argument('project_dir', help='Output directory of the project')
+    parser.add_argument('input', help='Text file with one event per line, .npy file or tensor file (see tensor_file.py)')
+    parser.add_argument('output', help='Text or .npy file of the predictions, one event per row')
+    parser.add_argument('-j', '--threads', dest='threads', type=int, default=0, help='Threads, defaults to one per hardware thread')
+    args = parser.parse_args()
+
+    if args.input.endswith('.npy'):
+        x = np.load(args.input)
+    elif args.input.endswith('.txt') or args.input.endswith('.dat'):
+        x = np.loadtxt(args.input, ndmin=2)
+    else:
+        from tensor_file import read_tensor_file
+        x = read_tensor_file(args.input)
+
+    csim = CSimLibrary(args.project_dir)
+    y = csim.predict(x, args.threads)
+    if args.output.endswith('.npy'):
+        np.save(args.output, y)
+    else:
+        np.savetxt(args.output, y)
+    print('Wrote {} predictions of {} values to {}'.format(y.shape[0], y.shape[1], args.output))
+
+if __name__ == "__main__":
+    main()
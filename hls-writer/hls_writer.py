@@ -21,10 +21,12 @@ def hls_writer(layer_list, yamlConfig):
     do_batchnorm = False
     is_dense = False
     is_conv2d = False
+    conv2d_layers = ['Conv2D', 'DepthwiseConv2D', 'SeparableConv2D']
+    global_pooling_layers = ['GlobalMaxPooling1D', 'GlobalMaxPooling2D', 'GlobalAveragePooling1D', 'GlobalAveragePooling2D']
     for i in range(1,len(layer_list)+1):
      if layer_list[i-1]['class_name'] == 'BatchNormalization': do_batchnorm = True
     for i in range(1,len(layer_list)+1):
-     if layer_list[i-1]['class_name']=='Conv2D':
+     if layer_list[i-1]['class_name'] in conv2d_layers:
       is_conv2d = True
       break
     if not is_conv2d:
@@ -34,7 +36,53 @@ def hls_writer(layer_list, yamlConfig):
        break
     
     activation_layers = ['Activation', 'LeakyReLU', 'ThresholdedReLU', 'ELU', 'PReLU']
+    merge_layers = ['Add', 'Subtract', 'Multiply', 'Average', 'Maximum', 'Minimum', 'Concatenate']
+
+    # Per layer settings that match no layer, e.g. misspelled or merged into the previous layer
+    for name in (yamlConfig.get('LayerName') or {}).keys():
+        if str(name) not in [str(layer.get('name')) for layer in layer_list]:
+            print('WARNING: No layer {} for the LayerName config, using the defaults'.format(name))
+
+    # Dense layer implementation, see nnet::compute_layer
+    strategy = yamlConfig.get('Strategy', 'Latency').lower()
+
+    # Softmax implementation, see nnet::softmax. The tables are written for it
+    softmax_impl = yamlConfig.get('SoftmaxImplementation', 'stable').lower()
+
+    # io_stream: the layers pass hls::stream words to each other under DATAFLOW, see
+    # get_stream_layers. The kernels compute all the values of a word in parallel.
+    io_stream = yamlConfig['IOType'] == 'io_stream'
+    config_iotype = 'io_parallel' if io_stream else yamlConfig['IOType']
+    if io_stream:
+        input_word_size, word_sizes = get_stream_word_sizes(layer_list)
+
+    # Number of inputs of one event. The batch runner stores the events flattened and
+    # casts them back to the shape of the top function input
+    if layer_list[0]['class_name']=='Conv1D':
+        event_size = 'Y_INPUTS_1*N_CHAN_1'
+        event_data = 'reinterpret_cast<input_t (*)[N_CHAN_1]>(data)'
+    elif layer_list[0]['class_name'] in conv2d_layers:
+        event_size = 'IN_HEIGHT_1*IN_WIDTH_1*N_CHAN_1'
+        event_data = 'reinterpret_cast<input_t (*)[IN_WIDTH_1][N_CHAN_1]>(data)'
+    elif layer_list[0]['class_name']=='BatchNormalization' and is_conv2d:
+        event_size = 'IN_HEIGHT_1*IN_WIDTH_1*N_FILT_1'
+        event_data = 'reinterpret_cast<input_t (*)[IN_WIDTH_1][N_FILT_1]>(data)'
+    else:
+        event_size = 'N_INPUTS'
+        event_data = 'data'
+
+    # Lookup tables of the activations, as (layer index, [(name, values)]) pairs.
+    # Layers with the same tables share one ROM, see print_table_to_cpp
+    activation_tables = []
+    for i in range(1,len(layer_list)+1):
+        if 'activation' in layer_list[i-1].keys():
+            # With io_stream the activations run on one stream word at a time
+            n_in = word_sizes[i-1] if io_stream else get_activation_n_in(layer_list, i)
+            activation_tables.append((i, get_activation_tables(layer_list[i-1]['activation'], n_in, softmax_impl)))
     
+    # Input types of the PReLU activations, the alpha arrays are of the same type
+    alpha_types = {}
+
     # lines to add to .cpp for sublayers
     sublayerlines = []
     # lines to add to .h for sublayers
@@ -43,15 +91,19 @@ def hls_writer(layer_list, yamlConfig):
         #Add headers to weights and biases
         if 'myproject' in line:
             newline = line.replace('myproject',yamlConfig['ProjectName'])
+        elif 'input_t data[N_INPUTS]' in line and io_stream:
+            newline = line.replace('input_t data[N_INPUTS]','hls::stream<input_axis_t> &data')
+        elif 'result_t res[N_OUTPUTS]' in line and io_stream:
+            newline = line.replace('result_t res[N_OUTPUTS]','hls::stream<result_axis_t> &res')
         elif 'input_t data[N_INPUTS]' in line and layer_list[0]['class_name']=='Conv1D':
             newline = line.replace('input_t data[N_INPUTS]','input_t data[Y_INPUTS_1][N_CHAN_1]')
-        elif 'input_t data[N_INPUTS]' in line and layer_list[0]['class_name']=='Conv2D':
+        elif 'input_t data[N_INPUTS]' in line and layer_list[0]['class_name'] in conv2d_layers:
             newline = line.replace('input_t data[N_INPUTS]','input_t data[IN_HEIGHT_1][IN_WIDTH_1][N_CHAN_1]')
         elif 'input_t data[N_INPUTS]' in line and layer_list[0]['class_name']=='BatchNormalization' and is_conv2d:
             newline = line.replace('input_t data[N_INPUTS]','input_t data[IN_HEIGHT_1][IN_WIDTH_1][N_FILT_1]')
         elif 'const_size_in   = N_INPUTS' in line and layer_list[0]['class_name']=='Conv1D':
             newline = line.replace('const_size_in   = N_INPUTS','const_size_in   = Y_INPUTS_1*N_CHAN_1')
-        elif 'const_size_in   = N_INPUTS' in line and layer_list[0]['class_name']=='Conv2D':
+        elif 'const_size_in   = N_INPUTS' in line and layer_list[0]['class_name'] in conv2d_layers:
             newline = line.replace('const_size_in   = N_INPUTS','const_size_in   = IN_HEIGHT_1*IN_WIDTH_1*N_CHAN_1')
         elif 'const_size_in   = N_INPUTS' in line and layer_list[0]['class_name']=='BatchNormalization' and is_conv2d:
             newline = line.replace('const_size_in   = N_INPUTS','const_size_in   = IN_HEIGHT_1*IN_WIDTH_1*N_FILT_1')
@@ -59,11 +111,13 @@ def hls_writer(layer_list, yamlConfig):
             newline = line
             for i in range(1,len(layer_list)+1):
                 if layer_list[i-1]['class_name'] == 'BatchNormalization':
-                    newline += '#include "weights/beta{}.h"\n'.format(i)
                     newline += '#include "weights/scale{}.h"\n'.format(i)
-                    newline += '#include "weights/mean{}.h"\n'.format(i)
+                    newline += '#include "weights/b{}.h"\n'.format(i)
                 elif 'Pooling' in layer_list[i-1]['class_name']:
                     pass # No weights for pooling
+                elif layer_list[i-1]['class_name'] in merge_layers:
+                    if layer_list[i-1].get('activation') == 'PReLU':
+                        newline += '#include "weights/a{}.h"\n'.format(i)
                 else:
                     if layer_list[i-1]['n_part']>1:
                         for i_part in range(layer_list[i-1]['n_part']):
@@ -72,10 +126,20 @@ def hls_writer(layer_list, yamlConfig):
                     elif layer_list[i-1]['class_name'] not in activation_layers:
                         newline += '#include "weights/w{}.h"\n'.format(i)
                         newline += '#include "weights/b{}.h"\n'.format(i)
+                        if layer_list[i-1]['class_name'] == 'SeparableConv2D':
+                            newline += '#include "weights/dw{}.h"\n'.format(i)
+                            newline += '#include "weights/db{}.h"\n'.format(i)
                         if layer_list[i-1].get('activation') == 'PReLU':
                             newline += '#include "weights/a{}.h"\n'.format(i)
                     elif layer_list[i-1]['class_name'] == 'PReLU':
                         newline += '#include "weights/a{}.h"\n'.format(i)
+            table_names = []
+            for i, tables in activation_tables:
+                for name, values in tables:
+                    if name not in table_names:
+                        print_table_to_cpp(name, values, yamlConfig['OutputDir'], get_table_precision(yamlConfig))
+                        newline += '#include "weights/{}.h"\n'.format(name)
+                        table_names.append(name)
 
         #Add input/output type
         elif '//hls-fpga-machine-learning insert IO' in line:
@@ -84,12 +148,18 @@ def hls_writer(layer_list, yamlConfig):
                 newline += '    #pragma HLS ARRAY_RESHAPE variable=data complete dim=0 \n'
                 newline += '    #pragma HLS ARRAY_RESHAPE variable=res complete dim=0 \n'
                 newline += '    #pragma HLS INTERFACE ap_vld port=data,res \n'
-                newline += '    #pragma HLS PIPELINE \n'
-            if yamlConfig["IOType"] == "io_serial":
+                if strategy == 'resource':
+                    newline += '    #pragma HLS PIPELINE II={} \n'.format(max([get_layer_reuse(yamlConfig, layer) for layer in layer_list]))
+                else:
+                    newline += '    #pragma HLS PIPELINE \n'
+            if yamlConfig["IOType"] == "io_serial" or io_stream:
                 newline += '    #pragma HLS INTERFACE axis port=data,res \n'
                 newline += '    #pragma HLS DATAFLOW \n'
 
         #Add layers
+        elif '//hls-fpga-machine-learning insert layers' in line and io_stream:
+            newline = line + '\n'
+            newline += get_stream_layers(layer_list, yamlConfig, activation_tables, alpha_types)
         elif '//hls-fpga-machine-learning insert layers' in line:
             newline = line + '\n'
             for i in range(1,len(layer_list)+1):
@@ -107,7 +177,7 @@ def hls_writer(layer_list, yamlConfig):
                     input_object = 'layer{}_out'.format(i-1)
                     n_in = 'Y_OUTPUTS_{}*N_FILT_{}'.format(i-1,i-1)
                 #Layer is Dense and previous layer was Conv2D
-                elif layer_list[i-1]['class_name']=='Dense' and layer_list[i-2]['class_name']=='Conv2D':
+                elif layer_list[i-1]['class_name']=='Dense' and layer_list[i-2]['class_name'] in conv2d_layers:
                     input_type = 'layer{}_t'.format(i-1)
                     input_object = 'layer{}_out'.format(i-1)
                     n_in = 'IN_HEIGHT_{}*IN_WIDTH_{}*N_FILT_{}'.format(i-1,i-1,i-1)
@@ -145,14 +215,14 @@ def hls_writer(layer_list, yamlConfig):
                     y_in = 'Y_INPUTS_{}'.format(i)
                     n_chan = 'N_CHAN_{}'.format(i)
                 #First layer and Conv2D
-                elif (i==1 and layer_list[i-1]['class_name']=='Conv2D'):
+                elif (i==1 and layer_list[i-1]['class_name'] in conv2d_layers):
                     input_type = 'input_t'
                     input_object = 'data'
                     in_height = 'IN_HEIGHT_{}'.format(i)
                     in_width = 'IN_WIDTH_{}'.format(i)
                     n_chan = 'N_CHAN_{}'.format(i)
                 #Layer is Conv2D
-                elif layer_list[i-1]['class_name']=='Conv2D':
+                elif layer_list[i-1]['class_name'] in conv2d_layers:
                     input_type = 'layer{}_t'.format(i-1)
                     input_object = 'layer{}_out'.format(i-1)
                     in_height = 'IN_HEIGHT_{}'.format(i)
@@ -170,9 +240,17 @@ def hls_writer(layer_list, yamlConfig):
                     n_filt = 'N_FILT_{}'.format(i)
                 #Currently doesn't allow all combinations
 
+                #Layers of functional models that read another layer than the previous one
+                if 'inputs' in layer_list[i-1]:
+                    input_type, input_object = get_array_input(layer_list, layer_list[i-1]['inputs'][0])
+                    if layer_list[i-1]['class_name']=='Dense': n_in = layer_list[i-1]['n_in']
 
                 #Outputs of compute_layer and activation 
-                if i==len(layer_list) and layer_list[i-1]['class_name']=='Dense':
+                if layer_list[i-1]['class_name'] in merge_layers:
+                    output_type = 'result_t' if i==len(layer_list) else 'layer{}_t'.format(i)
+                    output_object = 'res' if i==len(layer_list) else 'layer{}_out'.format(i)
+                    n_out = 'N_OUTPUTS' if i==len(layer_list) else 'N_LAYER_{}'.format(i)
+                elif i==len(layer_list) and layer_list[i-1]['class_name']=='Dense':
                     output_type = 'result_t'
                     output_object = 'res'
                     n_out = 'N_OUTPUTS'
@@ -181,7 +259,6 @@ def hls_writer(layer_list, yamlConfig):
                     output_type = 'result_t'
                     output_object = 'res'
                     n_out = 'N_OUTPUTS'
-                    input_type = 'result_t'
                 elif i==len(layer_list) and is_dense and layer_list[i-1]['class_name']=='BatchNormalization':
                     output_type = 'result_t'
                     output_object = 'res'
@@ -193,7 +270,7 @@ def hls_writer(layer_list, yamlConfig):
                     out_width = 'OUT_WIDTH_{}'.format(i)
                     n_filt = 'N_FILT_{}'.format(i)
                 elif(i==len(layer_list)-1 and is_dense and layer_list[i-1]['class_name']=='BatchNormalization' and layer_list[i]['class_name'] in activation_layers):
-                    output_type = 'result_t'
+                    output_type = 'layer{}_t'.format(i)
                     output_object = 'layer{}_out'.format(i)
                     n_out = 'N_OUTPUTS' 
                 elif layer_list[i-1]['class_name']=='Dense' or (layer_list[i-1]['class_name']=='BatchNormalization' and is_dense) or (layer_list[i-1]['class_name'] in activation_layers and is_dense):
@@ -205,20 +282,30 @@ def hls_writer(layer_list, yamlConfig):
                     output_object = 'layer{}_out'.format(i)
                     y_out = 'Y_OUTPUTS_{}'.format(i)
                     n_filt = 'N_FILT_{}'.format(i)
-                elif layer_list[i-1]['class_name']=='Conv2D' or (is_conv2d and layer_list[i-1]['class_name']=='BatchNormalization'):
+                elif layer_list[i-1]['class_name'] in conv2d_layers or (is_conv2d and layer_list[i-1]['class_name']=='BatchNormalization'):
                     output_type = 'layer{}_t'.format(i)
                     output_object = 'layer{}_out'.format(i)
                     out_height = 'OUT_HEIGHT_{}'.format(i)
                     out_width = 'OUT_WIDTH_{}'.format(i)
                     n_filt = 'N_FILT_{}'.format(i)
+                elif i==len(layer_list) and layer_list[i-1]['class_name'] in global_pooling_layers:
+                    output_type = 'result_t'
+                    output_object = 'res'
+                    n_out = 'N_OUTPUTS'
+                elif layer_list[i-1]['class_name'] in global_pooling_layers:
+                    output_type = 'layer{}_t'.format(i)
+                    output_object = 'layer{}_out'.format(i)
+                    n_out = 'N_LAYER_{}'.format(i)
                 #Currently assumes end with dense
 
                 if( i!=len(layer_list) ):
                     if layer_list[i-1]['class_name']=='Dense' or (layer_list[i-1]['class_name']=='BatchNormalization' and is_dense) or (layer_list[i-1]['class_name'] in activation_layers and is_dense):
                         newline += '    {} layer{}_out[{}];\n'.format(output_type,i,n_out)
+                    elif layer_list[i-1]['class_name'] in global_pooling_layers or layer_list[i-1]['class_name'] in merge_layers:
+                        newline += '    {} layer{}_out[{}];\n'.format(output_type,i,n_out)
                     elif layer_list[i-1]['class_name']=='Conv1D' or 'Pooling1D' in layer_list[i-1]['class_name']:
                         newline += '    {} layer{}_out[{}*{}];\n'.format(output_type,i,y_out,n_filt)
-                    elif layer_list[i-1]['class_name']=='Conv2D' or 'Pooling2D' in layer_list[i-1]['class_name']:
+                    elif layer_list[i-1]['class_name'] in conv2d_layers or 'Pooling2D' in layer_list[i-1]['class_name']:
                         newline += '    {} layer{}_out[{}*{}*{}];\n'.format(output_type,i,out_height,out_width,n_filt)
                     elif layer_list[i-1]['class_name']=='BatchNormalization' and is_conv2d:
                         if i!= 1: newline += '    {} layer{}_out[{}*{}*{}];\n'.format(output_type,i,out_height,out_width,n_filt)
@@ -236,43 +323,26 @@ def hls_writer(layer_list, yamlConfig):
                     if yamlConfig["IOType"] == "io_parallel": newline += '    #pragma HLS ARRAY_PARTITION variable=logits{} complete dim=0\n'.format(i)
                     if yamlConfig["IOType"] == "io_serial":   newline += '    #pragma HLS STREAM variable=logits{} depth=1\n'.format(i)
                     
-                    if layer_list[i-1]['n_part']==1 or yamlConfig["IOType"]=="io_serial":
+                    if layer_list[i-1].get('quantized'):
+                        newline += '    nnet::compute_layer_binary<{}, {}, config{}>({}, logits{}, w{}, b{});\n'.format(input_type, output_type, i, input_object, i, i, i)
+                    elif strategy == 'sparse':
+                        newline += '    nnet::compute_layer_sparse<{}, {}, config{}>({}, logits{}, w{}, b{});\n'.format(input_type, output_type, i, input_object, i, i, i)
+                    elif layer_list[i-1]['n_part']==1 or yamlConfig["IOType"]=="io_serial":
                         # Use one layer if there's only 1 partition, or if we're using serial mode
                         newline += '    nnet::compute_layer<{}, {}, config{}>({}, logits{}, w{}, b{});\n'.format(input_type, output_type, i, input_object, i, i, i, i)
                     else:
-                        # initialize arrays for sublayer outputs
+                        # Layer split in n_part sublayers, computed by one function
                         newline += '    compute_layer{}({}, logits{});\n'.format(i, input_object, i)
                         sublayerline = 'void compute_layer{}({} {}[{}], {} logits{}[{}]) {{\n'.format(i,input_type, input_object, n_in, output_type, i, n_out)
                         sublayerline_h = 'void compute_layer{}({} {}[{}], {} logits{}[{}]);\n'.format(i,input_type, input_object, n_in, output_type, i, n_out)
                         sublayerlines_h.append(sublayerline_h)
+                        # Inlined down to the kernels, so that the slices of the partitioned layer output are
+                        # constant elements rather than pointers passed to a function
+                        sublayerline += '    #pragma HLS INLINE recursive\n'
+                        # compute sublayer outputs, each into its slice of the layer output
                         for i_part in range(0, layer_list[i-1]['n_part']):
-                            n_subout = layer_list[i-1]['n_subout'][i_part]
-                            sublayerline += '    {} logits{}_{}[{}];\n'.format(output_type,i,i_part,n_subout)                        
-                            if yamlConfig["IOType"] == "io_parallel": sublayerline += '    #pragma HLS ARRAY_PARTITION variable=logits{}_{} complete dim=0\n'.format(i,i_part)
-                            if yamlConfig["IOType"] == "io_serial":   sublayerline += '    #pragma HLS STREAM variable=logits{}_{} depth=1\n'.format(i,i_part)
-
-                        # initialize arrays for merged partial outputs 
-                        for i_part in range(1, layer_list[i-1]['n_part']-1):
-                            n_mergeout = sum([layer_list[i-1]['n_subout'][kk] for kk in range(0, i_part+1)])
-                            sublayerline += '    {} logits{}_0to{}[{}];\n'.format(output_type,i,i_part,n_mergeout)                        
-                            if yamlConfig["IOType"] == "io_parallel": sublayerline += '    #pragma HLS ARRAY_PARTITION variable=logits{}_0to{} complete dim=0\n'.format(i,i_part)
-                            if yamlConfig["IOType"] == "io_serial":   sublayerline += '    #pragma HLS STREAM variable=logits{}_0to{} depth=1\n'.format(i,i_part)
-                        # compute sublayer outputs
-                        for i_part in range(0, layer_list[i-1]['n_part']):
-                            sublayerline += '    nnet::compute_layer<{}, {}, config{}_{}>({}, logits{}_{}, w{}_{}, b{}_{});\n'.format(input_type, output_type, i, i_part, input_object, i, i_part, i, i_part, i, i_part)   
-
-                        # merge sublayer outputs
-                        for i_part in range(0, layer_list[i-1]['n_part']-1):
-                            n_subout = layer_list[i-1]['n_subout'][i_part+1]
-                            n_mergeout = sum([layer_list[i-1]['n_subout'][kk] for kk in range(0, i_part+1)])
-                            if layer_list[i-1]['n_part']==2:
-                                sublayerline += '    nnet::merge<{}, {}, {}>(logits{}_{}, logits{}_{}, logits{});\n'.format(output_type, n_mergeout, n_subout, i, i_part, i, i_part+1, i)
-                            elif i_part==0: 
-                                sublayerline += '    nnet::merge<{}, {}, {}>(logits{}_{}, logits{}_{}, logits{}_0to{});\n'.format(output_type, n_mergeout, n_subout, i, i_part, i, i_part+1, i, i_part+1)
-                            elif i_part==layer_list[i-1]['n_part']-2:
-                                sublayerline += '    nnet::merge<{}, {}, {}>(logits{}_0to{}, logits{}_{}, logits{});\n'.format(output_type, n_mergeout, n_subout, i, i_part, i, i_part+1, i)
-                            else:
-                                sublayerline += '    nnet::merge<{}, {}, {}>(logits{}_0to{}, logits{}_{}, logits{}_0to{});\n'.format(output_type, n_mergeout, n_subout, i, i_part, i, i_part+1, i, i_part+1)
+                            offset = sum(layer_list[i-1]['n_subout'][:i_part])
+                            sublayerline += '    nnet::compute_layer<{}, {}, config{}_{}>({}, &logits{}[{}], w{}_{}, b{}_{});\n'.format(input_type, output_type, i, i_part, input_object, i, offset, i, i_part, i, i_part)
                         sublayerline += '}\n'
                         sublayerlines.append(sublayerline)
                     
@@ -294,36 +364,73 @@ def hls_writer(layer_list, yamlConfig):
                     newline += '    {} logits{}[{}*{}];\n'.format(output_type,i,y_out,n_filt)
                     if yamlConfig["IOType"] == "io_parallel": newline += '    #pragma HLS ARRAY_PARTITION variable=logits{} complete dim=0\n'.format(i)
                     if yamlConfig["IOType"] == "io_serial":   newline += '    #pragma HLS STREAM variable=logits{} complete depth=1\n'.format(i)
-                    newline += '    nnet::flatten<{}, {}, {}>(conv_layer{}_out, logits{});\n'.format(input_type, y_out, n_filt, i, i)
-                elif layer_list[i-1]['class_name']=='Conv2D':
-                    if i>1 and (layer_list[i-2]['class_name']=='Conv2D' or layer_list[i-2]['class_name']=='BatchNormalization'):
+                    newline += '    nnet::flatten<{}, {}, {}>(conv_layer{}_out, logits{});\n'.format(output_type, y_out, n_filt, i, i)
+                elif layer_list[i-1]['class_name'] in conv2d_layers:
+                    i_in = get_input_index(layer_list, i)
+                    # Only the network input is 3D, the outputs of the layers are flattened
+                    if i_in>0:
                         newline += '    {} conv2d_layer{}_in[{}][{}][{}];\n'.format(input_type,i,in_height,in_width,n_chan)
                         if yamlConfig["IOType"] == "io_parallel": newline += '    #pragma HLS ARRAY_PARTITION variable=conv2d_layer{}_in complete dim=0\n'.format(i)
                         if yamlConfig["IOType"] == "io_serial":   newline += '    #pragma HLS STREAM variable=conv2d_layer{}_in depth=1\n'.format(i)
                         newline += '    nnet::unflatten<{}, {}, {}, {}>({}, conv2d_layer{}_in);\n'.format(input_type, in_height, in_width, n_chan, input_object, i)                              
-                        newline += '    {} conv2d_layer{}_out[{}][{}][{}];\n'.format(output_type,i,out_height,out_width,n_filt)
-                        if yamlConfig["IOType"] == "io_parallel": newline += '    #pragma HLS ARRAY_PARTITION variable=conv2d_layer{}_out complete dim=0\n'.format(i)
-                        if yamlConfig["IOType"] == "io_serial":   newline += '    #pragma HLS STREAM variable=conv2d_layer{}_out depth=1\n'.format(i)
-                        newline += '    nnet::conv_2d<{}, {}, config{}>(conv2d_layer{}_in, conv2d_layer{}_out, w{}, b{});\n'.format(input_type, output_type, i, i, i, i, i, i)  
-                    else:                        
-                        newline += '    {} conv2d_layer{}_out[{}][{}][{}];\n'.format(output_type,i,out_height,out_width,n_filt)
-                        if yamlConfig["IOType"] == "io_parallel": newline += '    #pragma HLS ARRAY_PARTITION variable=conv2d_layer{}_out complete dim=0\n'.format(i)
-                        if yamlConfig["IOType"] == "io_serial":   newline += '    #pragma HLS STREAM variable=conv2d_layer{}_out depth=1\n'.format(i)
-                        newline += '    nnet::conv_2d<{}, {}, config{}>({}, conv2d_layer{}_out, w{}, b{});\n'.format(input_type, output_type, i, input_object, i, i, i, i)
+                        conv_input_object = 'conv2d_layer{}_in'.format(i)
+                    else:
+                        conv_input_object = input_object
+                    newline += '    {} conv2d_layer{}_out[{}][{}][{}];\n'.format(output_type,i,out_height,out_width,n_filt)
+                    if yamlConfig["IOType"] == "io_parallel": newline += '    #pragma HLS ARRAY_PARTITION variable=conv2d_layer{}_out complete dim=0\n'.format(i)
+                    if yamlConfig["IOType"] == "io_serial":   newline += '    #pragma HLS STREAM variable=conv2d_layer{}_out depth=1\n'.format(i)
+                    if layer_list[i-1]['class_name']=='SeparableConv2D':
+                        # Depthwise conv into the accumulator type, then the pointwise conv mixes the channels
+                        dw_type = get_layer_type(yamlConfig, layer_list[i-1], i, 'accum')
+                        newline += '    {} sepconv2d_layer{}_dw[{}][{}][{}*{}];\n'.format(dw_type,i,out_height,out_width,n_chan,layer_list[i-1]['depth_multiplier'])
+                        if yamlConfig["IOType"] == "io_parallel": newline += '    #pragma HLS ARRAY_PARTITION variable=sepconv2d_layer{}_dw complete dim=0\n'.format(i)
+                        if yamlConfig["IOType"] == "io_serial":   newline += '    #pragma HLS STREAM variable=sepconv2d_layer{}_dw depth=1\n'.format(i)
+                        newline += '    nnet::depthwise_conv_2d<{}, {}, config{}_depthwise>({}, sepconv2d_layer{}_dw, dw{}, db{});\n'.format(input_type, dw_type, i, conv_input_object, i, i, i)
+                        newline += '    nnet::pointwise_conv_2d<{}, {}, config{}_pointwise>(sepconv2d_layer{}_dw, conv2d_layer{}_out, w{}, b{});\n'.format(dw_type, output_type, i, i, i, i, i)
+                    elif layer_list[i-1]['class_name']=='DepthwiseConv2D':
+                        newline += '    nnet::depthwise_conv_2d<{}, {}, config{}>({}, conv2d_layer{}_out, w{}, b{});\n'.format(input_type, output_type, i, conv_input_object, i, i, i)
+                    elif layer_list[i-1].get('quantized'):
+                        newline += '    nnet::conv_2d_binary<{}, {}, config{}>({}, conv2d_layer{}_out, w{}, b{});\n'.format(input_type, output_type, i, conv_input_object, i, i, i)
+                    elif 'pool' in layer_list[i-1]:
+                        # Max pooling fused into the conv, out_height/out_width are the pooled ones
+                        newline += '    nnet::conv_2d_pool<{}, {}, config{}, config{}_pool>({}, conv2d_layer{}_out, w{}, b{});\n'.format(input_type, output_type, i, i, conv_input_object, i, i, i)
+                    else:
+                        newline += '    nnet::conv_2d<{}, {}, config{}>({}, conv2d_layer{}_out, w{}, b{});\n'.format(input_type, output_type, i, conv_input_object, i, i, i)
                     newline += '    {} logits{}[{}*{}*{}];\n'.format(output_type,i,out_height,out_width,n_filt)
                     if yamlConfig["IOType"] == "io_parallel": newline += '    #pragma HLS ARRAY_PARTITION variable=logits{} complete dim=0\n'.format(i)
                     if yamlConfig["IOType"] == "io_serial":   newline += '    #pragma HLS STREAM variable=logits{} complete depth=1\n'.format(i)
                     newline += '    nnet::flatten<{}, {}, {}, {}>(conv2d_layer{}_out, logits{});\n'.format(output_type, out_height, out_width, n_filt, i, i)
                 elif layer_list[i-1]['class_name'] == 'BatchNormalization' and is_dense:
-                    newline += '    nnet::normalize<{}, {}, config{}>({}, {}, scale{}, beta{}, mean{});\n'.format(input_type, output_type, i, input_object, output_object, i, i, i)
+                    newline += '    nnet::normalize<{}, {}, config{}>({}, {}, scale{}, b{});\n'.format(input_type, output_type, i, input_object, output_object, i, i)
                 elif i==1 and layer_list[i-1]['class_name'] == 'BatchNormalization' and is_conv2d:
                     newline += '    {} logits{}[{}*{}*{}];\n'.format(output_type,i,in_height,in_width,n_filt)
                     if yamlConfig["IOType"] == "io_parallel": newline += '    #pragma HLS ARRAY_PARTITION variable=logits{} complete dim=0\n'.format(i)
                     if yamlConfig["IOType"] == "io_serial":   newline += '    #pragma HLS STREAM variable=logits{} complete depth=1\n'.format(i)
                     newline += '    nnet::flatten<{}, {}, {}, {}>({}, logits{});\n'.format(input_type, in_height, in_width, n_filt, input_object, i)
-                    newline += '    nnet::normalize<{}, {}, config{}>(logits{}, {}, scale{}, beta{}, mean{});\n'.format(output_type, output_type, i, i, output_object, i, i, i)
+                    newline += '    nnet::normalize<{}, {}, config{}>(logits{}, {}, scale{}, b{});\n'.format(output_type, output_type, i, i, output_object, i, i)
                 elif layer_list[i-1]['class_name'] == 'BatchNormalization' and is_conv2d:
-                    newline += '    nnet::normalize<{}, {}, config{}>({}, {}, scale{}, beta{}, mean{});\n'.format(input_type, output_type, i, input_object, output_object, i, i, i)
+                    newline += '    nnet::normalize<{}, {}, config{}>({}, {}, scale{}, b{});\n'.format(input_type, output_type, i, input_object, output_object, i, i)
+                elif layer_list[i-1]['class_name'] in global_pooling_layers:
+                    # An activation after the pooling reads it from logits
+                    pool_object = output_object
+                    if 'activation' in layer_list[i-1].keys():
+                        pool_object = 'logits{}'.format(i)
+                        newline += '    {} logits{}[{}];\n'.format(output_type,i,n_out)
+                        if yamlConfig["IOType"] == "io_parallel": newline += '    #pragma HLS ARRAY_PARTITION variable=logits{} complete dim=0\n'.format(i)
+                        if yamlConfig["IOType"] == "io_serial":   newline += '    #pragma HLS STREAM variable=logits{} depth=1\n'.format(i)
+                    newline += '    nnet::global_pooling<{}, {}, config{}>({}, {});\n'.format(input_type, output_type, i, input_object, pool_object)
+                elif layer_list[i-1]['class_name'] in merge_layers:
+                    # Both branches are computed in parallel within the pipeline of the top function.
+                    # An activation after the merge reads it from logits
+                    merge_object = output_object
+                    if 'activation' in layer_list[i-1].keys():
+                        merge_object = 'logits{}'.format(i)
+                        newline += '    {} logits{}[{}];\n'.format(output_type,i,n_out)
+                        if yamlConfig["IOType"] == "io_parallel": newline += '    #pragma HLS ARRAY_PARTITION variable=logits{} complete dim=0\n'.format(i)
+                    if 0 in layer_list[i-1]['inputs'] and 'out_height' in layer_list[i-1]:
+                        raise Exception('ERROR: {} layer {} reads the 2D input of the model, which is only supported with io_stream'.format(layer_list[i-1]['class_name'], layer_list[i-1]['name']))
+                    (input1_type, input1_object), (input2_type, input2_object) = [get_array_input(layer_list, i_in) for i_in in layer_list[i-1]['inputs']]
+                    newline += '    nnet::{}<{}, {}, {}, config{}>({}, {}, {});\n'.format(get_merge_kernel(layer_list[i-1], io_stream), input1_type, input2_type, output_type, i, input1_object, input2_object, merge_object)
                 elif 'Pooling' in layer_list[i-1]['class_name']:
                     info = layer_list[i-1]['class_name'].split('Pooling')
                     d = int(info[1].split('D')[0]) # n dimensions
@@ -361,41 +468,12 @@ def hls_writer(layer_list, yamlConfig):
                         act_input_type = input_type
                         act_input_object = input_object
                     
-                    activation_name = layer_list[i-1]['activation']+'_config'+str(i)
-                    activation_param = layer_list[i-1].get('activ_param')
-                    if layer_list[i-1]['activation'] == "relu":
-                        newline += '    nnet::relu<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
-                    elif layer_list[i-1]['activation'] == "LeakyReLU":
-                        newline += '    nnet::leaky_relu<{}, {}, {}>({}, {}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, activation_param, output_object)
-                    elif layer_list[i-1]['activation'] == "ThresholdedReLU":
-                        newline += '    nnet::thresholded_relu<{}, {}, {}>({}, {}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, activation_param, output_object)
-                    elif layer_list[i-1]['activation'].lower() == "elu":
-                        if activation_param:
-                            newline += '    nnet::elu<{}, {}, {}>({}, {}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, activation_param, output_object)
-                        else:
-                            newline += '    nnet::elu<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
-                    elif layer_list[i-1]['activation'] == "selu":
-                        newline += '    nnet::selu<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
-                    elif layer_list[i-1]['activation'] == "PReLU":
-                        newline += '    nnet::prelu<{}, {}, {}>({}, a{}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, i, output_object)
-                    elif layer_list[i-1]['activation'] == "softmax":
-                        newline += '    nnet::softmax<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
-                    elif layer_list[i-1]['activation'] == "sigmoid":
-                        newline += '    nnet::sigmoid<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
-                    elif layer_list[i-1]['activation'] == "hard_sigmoid":
-                        newline += '    nnet::hard_sigmoid<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
-                    elif layer_list[i-1]['activation'] == "tanh":
-                        newline += '    nnet::tanh<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
-                    elif layer_list[i-1]['activation'] == "linear": 
-                        #github Issue 53
-                        newline += '    nnet::linear<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
-                    elif layer_list[i-1]['activation'] == "softsign":
-                        newline += '    nnet::softsign<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
-                    elif layer_list[i-1]['activation'] == "softplus":
-                        newline += '    nnet::softplus<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
-                    else:
-                        raise Exception('ERROR: MISSING ACTIVATION')
+                    table_args = ''.join([', ' + name for name, values in dict(activation_tables)[i]])
+                    if layer_list[i-1]['activation'] == "PReLU":
+                        alpha_types[i] = act_input_type
+                    newline += get_activation_call(layer_list[i-1], i, act_input_type, output_type, act_input_object, output_object, table_args)
 
+                newline += '    NNET_TRACE_ARRAY("{}", "{}", "{}", {}, {});\n'.format(get_trace_name(layer_list[i-1]), get_trace_layout(layer_list, i, io_stream), get_layer_precision(yamlConfig, layer_list[i-1], 'result') or yamlConfig["DefaultPrecision"], output_object, get_activation_n_in(layer_list, i))
                 newline += '\n'
 
         #Just copy line
@@ -422,10 +500,12 @@ def hls_writer(layer_list, yamlConfig):
         static const unsigned io_type = nnet::{iotype};
         static const unsigned reuse_factor = {reuse};
         static const unsigned n_zeros = {nzeros};
-        static const bool store_weights_in_bram = false;
-        typedef accum_default_t accum_t;
-        typedef bias_default_t bias_t;
-        typedef weight_default_t weight_t;
+        static const unsigned adder_tree_regs = {tree_regs};
+        static const bool store_weights_in_bram = {bram};
+        static const unsigned strategy = nnet::{strategy};
+        typedef {accum_t} accum_t;
+        typedef {bias_t} bias_t;
+        typedef {weight_t} weight_t;
         }};\n"""
 
     dense_sub_config_template = """struct config{index}_{i_part} : nnet::layer_config {{
@@ -434,10 +514,41 @@ def hls_writer(layer_list, yamlConfig):
         static const unsigned io_type = nnet::{iotype};
         static const unsigned reuse_factor = {reuse};
         static const unsigned n_zeros = {nzeros};
+        static const unsigned adder_tree_regs = {tree_regs};
+        static const bool store_weights_in_bram = {bram};
+        static const unsigned strategy = nnet::{strategy};
+        typedef {accum_t} accum_t;
+        typedef {bias_t} bias_t;
+        typedef {weight_t} weight_t;
+        }};\n"""
+
+    sparse_config_template = """struct config{index} : nnet::layer_config {{
+        static const unsigned n_in = {n_in};
+        static const unsigned n_out = {n_out};
+        static const unsigned io_type = nnet::{iotype};
+        static const unsigned reuse_factor = {reuse};
+        static const unsigned n_zeros = {nzeros};
+        static const unsigned n_nonzeros = {n_nonzeros};
         static const bool store_weights_in_bram = false;
-        typedef accum_default_t accum_t;
-        typedef bias_default_t bias_t;
-        typedef weight_default_t weight_t;
+        static const unsigned strategy = nnet::sparse;
+        static const unsigned adder_tree_regs = {tree_regs};
+        typedef {accum_t} accum_t;
+        typedef {bias_t} bias_t;
+        typedef {weight_t} weight_t;
+        typedef index_default_t index_t;
+        }};\n"""
+
+    binary_dense_config_template = """struct config{index} : nnet::binary_layer_config {{
+        static const unsigned n_in = {n_in};
+        static const unsigned n_out = {n_out};
+        static const unsigned io_type = nnet::{iotype};
+        static const unsigned reuse_factor = {reuse};
+        static const unsigned n_zeros = {nzeros};
+        static const unsigned adder_tree_regs = {tree_regs};
+        static const bool binary_input = {binary_input};
+        typedef {accum_t} accum_t;
+        typedef {bias_t} bias_t;
+        typedef {weight_t} weight_t;
         }};\n"""
 
     batchnorm_config_template = """struct config{index} : nnet::batchnorm_config {{
@@ -446,9 +557,8 @@ def hls_writer(layer_list, yamlConfig):
         static const unsigned io_type = nnet::{iotype};
         static const unsigned reuse_factor = {reuse};
         static const bool store_weights_in_bram = false;
-        typedef beta_default_t beta_t;
-        typedef scale_default_t scale_t;
-        typedef mean_default_t mean_t;
+        typedef {scale_t} scale_t;
+        typedef {bias_t} bias_t;
         }};\n"""
 
     conv_config_template = """struct config{index} : nnet::conv_config {{
@@ -462,10 +572,11 @@ def hls_writer(layer_list, yamlConfig):
         static const unsigned y_out = {y_out};
         static const unsigned reuse_factor = {reuse};
         static const unsigned n_zeros = {nzeros};
+        static const unsigned adder_tree_regs = {tree_regs};
         static const bool store_weights_in_bram = false;
-        typedef accum_default_t accum_t;
-        typedef bias_default_t bias_t;
-        typedef weight_default_t weight_t;
+        typedef {accum_t} accum_t;
+        typedef {bias_t} bias_t;
+        typedef {weight_t} weight_t;
         }};\n"""
 
     conv2d_config_template = """struct config{index} : nnet::conv2d_config {{
@@ -485,10 +596,74 @@ def hls_writer(layer_list, yamlConfig):
         static const unsigned out_width = {out_width};
         static const unsigned reuse_factor = {reuse};
         static const unsigned n_zeros = {nzeros};
+        static const unsigned adder_tree_regs = {tree_regs};
+        static const bool store_weights_in_bram = false;
+        typedef {accum_t} accum_t;
+        typedef {bias_t} bias_t;
+        typedef {weight_t} weight_t;
+        }};\n"""
+
+    binary_conv2d_config_template = """struct config{index} : nnet::binary_conv2d_config {{
+        static const unsigned pad_top = {pad_top};
+        static const unsigned pad_bottom = {pad_bottom};
+        static const unsigned pad_left = {pad_left};
+        static const unsigned pad_right = {pad_right};
+        static const unsigned in_height = {in_height};
+        static const unsigned in_width = {in_width};
+        static const unsigned n_chan = {n_chan};
+        static const unsigned filt_height = {filt_height};
+        static const unsigned filt_width = {filt_width};
+        static const unsigned n_filt = {n_filt};
+        static const unsigned stride_height = {stride_height};
+        static const unsigned stride_width = {stride_width};
+        static const unsigned out_height = {out_height};
+        static const unsigned out_width = {out_width};
+        static const unsigned reuse_factor = {reuse};
+        static const unsigned n_zeros = {nzeros};
+        static const unsigned adder_tree_regs = {tree_regs};
+        static const bool binary_input = {binary_input};
+        typedef {accum_t} accum_t;
+        typedef {bias_t} bias_t;
+        typedef {weight_t} weight_t;
+        }};\n"""
+
+    depthwise_conv2d_config_template = """struct config{index} : nnet::depthwise_conv2d_config {{
+        static const unsigned pad_top = {pad_top};
+        static const unsigned pad_bottom = {pad_bottom};
+        static const unsigned pad_left = {pad_left};
+        static const unsigned pad_right = {pad_right};
+        static const unsigned in_height = {in_height};
+        static const unsigned in_width = {in_width};
+        static const unsigned n_chan = {n_chan};
+        static const unsigned filt_height = {filt_height};
+        static const unsigned filt_width = {filt_width};
+        static const unsigned depth_multiplier = {depth_multiplier};
+        static const unsigned n_filt = {n_filt};
+        static const unsigned stride_height = {stride_height};
+        static const unsigned stride_width = {stride_width};
+        static const unsigned out_height = {out_height};
+        static const unsigned out_width = {out_width};
+        static const unsigned reuse_factor = {reuse};
+        static const unsigned n_zeros = {nzeros};
+        static const unsigned adder_tree_regs = {tree_regs};
         static const bool store_weights_in_bram = false;
-        typedef accum_default_t accum_t;
-        typedef bias_default_t bias_t;
-        typedef weight_default_t weight_t;
+        typedef {accum_t} accum_t;
+        typedef {bias_t} bias_t;
+        typedef {weight_t} weight_t;
+        }};\n"""
+
+    pointwise_conv2d_config_template = """struct config{index} : nnet::pointwise_conv2d_config {{
+        static const unsigned in_height = {in_height};
+        static const unsigned in_width = {in_width};
+        static const unsigned n_chan = {n_chan};
+        static const unsigned n_filt = {n_filt};
+        static const unsigned reuse_factor = {reuse};
+        static const unsigned n_zeros = {nzeros};
+        static const unsigned adder_tree_regs = {tree_regs};
+        static const bool store_weights_in_bram = false;
+        typedef {accum_t} accum_t;
+        typedef {bias_t} bias_t;
+        typedef {weight_t} weight_t;
         }};\n"""
     
     
@@ -496,7 +671,9 @@ def hls_writer(layer_list, yamlConfig):
     activ_config_template = """struct {type}_config{index} : nnet::activ_config {{
         static const unsigned n_in = {n_in};
         static const unsigned table_size = 1024;
+        static const unsigned softmax_impl = nnet::{softmax_impl};
         static const unsigned io_type = nnet::{iotype};
+        typedef table_default_t table_t;
         }};\n"""
 
     pooling1d_config_template = """struct config{index} : nnet::pooling1d_config {{
@@ -528,6 +705,25 @@ def hls_writer(layer_list, yamlConfig):
     }};\n
     """
 
+    global_pooling_config_template = """struct config{index} : nnet::global_pooling_config {{
+        static const unsigned n_in = {n_in};
+        static const unsigned n_filt = {n_filt};
+        static const bool filt_major = {filt_major};
+        static const nnet::Pool_Op pool_op = nnet::{Op};
+        typedef {accum_t} accum_t;
+        typedef {scale_t} scale_t;
+    }};\n"""
+
+    merge_config_template = """struct config{index} : nnet::merge_config {{
+        static const unsigned n_elem = {n_elem};
+    }};\n"""
+
+    concat_config_template = """struct config{index} : nnet::concat_config {{
+        static const unsigned n_outer = {n_outer};
+        static const unsigned n_elem1 = {n_elem1};
+        static const unsigned n_elem2 = {n_elem2};
+    }};\n"""
+
     for line in f.readlines():
 
         #Insert numbers
@@ -537,10 +733,14 @@ def hls_writer(layer_list, yamlConfig):
             newline += 'typedef {precision} weight_default_t;\n'.format(precision=yamlConfig["DefaultPrecision"])
             newline += 'typedef {precision} bias_default_t;\n'.format(precision=yamlConfig["DefaultPrecision"])
             newline += 'typedef {precision} input_t;\n'.format(precision=yamlConfig["DefaultPrecision"])
-            newline += 'typedef {precision} result_t;\n'.format(precision=yamlConfig["DefaultPrecision"])
+            newline += 'typedef {precision} result_t;\n'.format(precision=get_layer_precision(yamlConfig, layer_list[-1], 'result') or yamlConfig["DefaultPrecision"])
+            newline += 'typedef {} table_default_t;\n'.format(get_table_precision(yamlConfig))
+            if strategy == 'sparse':
+             # Wide enough to index the inputs and outputs of every dense layer
+             max_index = max([max(layer['n_in'], layer['n_out']) for layer in layer_list if layer['class_name']=='Dense'])
+             newline += 'typedef ap_uint<{}> index_default_t;\n'.format(int(np.ceil(np.log2(max_index))) if max_index > 1 else 1)
+             newline += 'typedef nnet::sparse_weight<weight_default_t, index_default_t> sparse_weight_default_t;\n'
             if do_batchnorm:
-             newline += 'typedef {precision} beta_default_t;\n'.format(precision=yamlConfig["DefaultPrecision"])
-             newline += 'typedef {precision} mean_default_t;\n'.format(precision=yamlConfig["DefaultPrecision"])
              newline += 'typedef {precision} scale_default_t;\n'.format(precision=yamlConfig["DefaultPrecision"])
 
             for i in range(1,len(layer_list)+1):
@@ -560,7 +760,7 @@ def hls_writer(layer_list, yamlConfig):
                 elif i==len(layer_list) and layer_list[i-1]['class_name']=='Dense':
                     newline += '#define N_OUTPUTS {}\n'.format(layer_list[i-1]['n_out'])
                 elif i==len(layer_list) and layer_list[i-1]['class_name'] in activation_layers:
-                    newline += '#define N_OUTPUTS {}\n'.format(layer_list[i-2]['n_out']) 
+                    newline += '#define N_OUTPUTS {}\n'.format(get_activation_n_in(layer_list, i)) 
                 elif i==len(layer_list) and layer_list[i-1]['class_name']=='BatchNormalization':
                     newline += '#define N_OUTPUTS {}\n'.format(layer_list[i-1]['n_out']) 
                     newline += '#define N_FILT_{} {}\n'.format(i-1, layer_list[i-1]['n_filt']) 
@@ -570,13 +770,13 @@ def hls_writer(layer_list, yamlConfig):
                     newline += '#define N_LAYER_{} {}\n'.format(i, layer_list[i-1]['n_out'])  
                     newline += '#define N_FILT_{} {}\n'.format(i-1, layer_list[i-1]['n_filt']) 	
                 elif layer_list[i-1]['class_name'] in activation_layers:        
-                    newline += '#define N_LAYER_{} {}\n'.format(i, layer_list[i-2]['n_out'])
+                    newline += '#define N_LAYER_{} {}\n'.format(i, get_activation_n_in(layer_list, i))
                 elif layer_list[i-1]['class_name']=='Conv1D':
                     newline += '#define Y_INPUTS_{} {}\n'.format(i, layer_list[i-1]['y_in'])
                     newline += '#define N_CHAN_{} {}\n'.format(i, layer_list[i-1]['n_chan'])
                     newline += '#define Y_OUTPUTS_{} {}\n'.format(i, layer_list[i-1]['y_out'])
                     newline += '#define N_FILT_{} {}\n'.format(i, layer_list[i-1]['n_filt'])
-                elif layer_list[i-1]['class_name']=='Conv2D':
+                elif layer_list[i-1]['class_name'] in conv2d_layers:
                     newline += '#define IN_HEIGHT_{} {}\n'.format(i, layer_list[i-1]['in_height'])
                     newline += '#define IN_WIDTH_{} {}\n'.format(i, layer_list[i-1]['in_width'])
                     newline += '#define N_CHAN_{} {}\n'.format(i, layer_list[i-1]['n_chan'])
@@ -588,6 +788,19 @@ def hls_writer(layer_list, yamlConfig):
                     newline += '#define OUT_HEIGHT_{} {}\n'.format(i, layer_list[i-1]['in_height'])
                     newline += '#define OUT_WIDTH_{} {}\n'.format(i, layer_list[i-1]['in_width'])
                     newline += '#define N_FILT_{} {}\n'.format(i, layer_list[i-1]['n_filt']) 
+                elif layer_list[i-1]['class_name'] in merge_layers:
+                    if i==len(layer_list):
+                        newline += '#define N_OUTPUTS {}\n'.format(layer_list[i-1]['n_out'])
+                    else:
+                        newline += '#define N_LAYER_{} {}\n'.format(i, layer_list[i-1]['n_out'])
+                    if 'out_height' in layer_list[i-1]:
+                        newline += '#define OUT_HEIGHT_{} {}\n'.format(i, layer_list[i-1]['out_height'])
+                        newline += '#define OUT_WIDTH_{} {}\n'.format(i, layer_list[i-1]['out_width'])
+                        newline += '#define N_FILT_{} {}\n'.format(i, layer_list[i-1]['n_filt'])
+                elif i==len(layer_list) and layer_list[i-1]['class_name'] in global_pooling_layers:
+                    newline += '#define N_OUTPUTS {}\n'.format(layer_list[i-1]['n_out'])
+                elif layer_list[i-1]['class_name'] in global_pooling_layers:
+                    newline += '#define N_LAYER_{} {}\n'.format(i, layer_list[i-1]['n_out'])
                 elif 'Pooling' in layer_list[i-1]['class_name']:
                     info = layer_list[i-1]['class_name'].split('Pooling')
                     d = int(info[1].split('D')[0])
@@ -610,13 +823,47 @@ def hls_writer(layer_list, yamlConfig):
         elif '//hls-fpga-machine-learning insert layer-precision' in line:
             newline = line
             for i in range(1,len(layer_list)):
-            #    if layer_list[i-1]['class_name']=='Dense':
-            #        newline += 'typedef {precision} layer{index}_t;\n'.format(precision=yamlConfig["DefaultPrecision"], index=i)
-                newline += 'typedef {precision} layer{index}_t;\n'.format(precision=yamlConfig["DefaultPrecision"], index=i)
+                precision = get_layer_precision(yamlConfig, layer_list[i-1], 'result') or yamlConfig["DefaultPrecision"]
+                newline += 'typedef {precision} layer{index}_t;\n'.format(precision=precision, index=i)
+            # Layers with their own weight, bias, accum, ... precision
+            for i in range(1,len(layer_list)+1):
+                if layer_list[i-1]['class_name']=='BatchNormalization':
+                    keys = ['scale', 'bias']
+                elif layer_list[i-1].get('quantized'):
+                    keys = ['bias', 'accum']
+                elif layer_list[i-1]['class_name'] in ['Dense', 'Conv1D'] + conv2d_layers:
+                    keys = ['weight', 'bias', 'accum']
+                elif layer_list[i-1]['class_name'] in global_pooling_layers:
+                    keys = ['accum']
+                else:
+                    keys = []
+                for key in keys:
+                    if get_layer_type(yamlConfig, layer_list[i-1], i, key) != '{}_default_t'.format(key):
+                        newline += 'typedef {precision} {key}{index}_t;\n'.format(precision=get_layer_precision(yamlConfig, layer_list[i-1], key), key=key, index=i)
+                if strategy == 'sparse' and layer_list[i-1]['class_name']=='Dense' and not layer_list[i-1].get('quantized') and get_layer_type(yamlConfig, layer_list[i-1], i, 'weight') != 'weight_default_t':
+                    newline += 'typedef nnet::sparse_weight<weight{index}_t, index_default_t> sparse_weight{index}_t;\n'.format(index=i)
+            for i in sorted(alpha_types.keys()):
+                newline += 'typedef {} alpha{}_t;\n'.format(alpha_types[i], i)
+            # Stream words between the layers and AXI-Stream words of the top level ports
+            if io_stream:
+                newline += 'typedef nnet::array<input_t, {}> input_word_t;\n'.format(input_word_size)
+                for i in range(1,len(layer_list)):
+                    newline += 'typedef nnet::array<layer{index}_t, {size}> layer{index}_word_t;\n'.format(index=i, size=word_sizes[i-1])
+                for i in range(1,len(layer_list)+1):
+                    if layer_list[i-1]['class_name'] == 'SeparableConv2D':
+                        newline += 'typedef nnet::array<{}, {}> layer{}_dw_word_t;\n'.format(get_layer_type(yamlConfig, layer_list[i-1], i, 'accum'), layer_list[i-1]['n_chan']*layer_list[i-1]['depth_multiplier'], i)
+                newline += 'typedef nnet::array<result_t, {}> result_word_t;\n'.format(word_sizes[-1])
+                newline += 'typedef nnet::axis<input_word_t> input_axis_t;\n'
+                newline += 'typedef nnet::axis<result_word_t> result_axis_t;\n'
+                newline += '#define N_INPUT_WORDS ({}/{})\n'.format(event_size, input_word_size)
+                newline += '#define N_OUTPUT_WORDS (N_OUTPUTS/{})\n'.format(word_sizes[-1])
 
         elif "//hls-fpga-machine-learning insert layer-config" in line:
             newline = line
             for i in range(1,len(layer_list)+1):
+                layer_types = dict(('{}_t'.format(key), get_layer_type(yamlConfig, layer_list[i-1], i, key)) for key in layer_precision_keys)
+                layer_reuse = get_layer_reuse(yamlConfig, layer_list[i-1])
+                layer_tree_regs = get_layer_tree_regs(yamlConfig, layer_list[i-1])
                 if i==1 and (layer_list[i-1]['class_name']=='Dense' or layer_list[i-1]['class_name']=='BatchNormalization'):
                     layer_in_name = "N_INPUTS"
                     layer_out_name = "N_LAYER_1"                        
@@ -636,13 +883,13 @@ def hls_writer(layer_list, yamlConfig):
                 elif i==len(layer_list) and layer_list[i-1]['class_name']=='Dense' and layer_list[i-2]['class_name']=='Conv1D':
                     layer_in_name = "Y_OUTPUTS_{}*N_FILT_{}".format(i-1, i-1)
                     layer_out_name = "N_OUTPUTS"
-                elif i==len(layer_list) and layer_list[i-1]['class_name']=='Dense' and layer_list[i-2]['class_name']=='Conv2D':
+                elif i==len(layer_list) and layer_list[i-1]['class_name']=='Dense' and layer_list[i-2]['class_name'] in conv2d_layers:
                     layer_in_name = "OUT_HEIGHT_{}*OUT_WIDTH_{}*N_FILT_{}".format(i-1, i-1, i-1)
                     layer_out_name = "N_OUTPUTS"
                 elif layer_list[i-1]['class_name']=='Dense' and layer_list[i-2]['class_name']=='Conv1D':
                     layer_in_name = "Y_OUTPUTS_{}*N_FILT_{}".format(i-1, i-1)
                     layer_out_name = "N_LAYER_{}".format(i)   
-                elif layer_list[i-1]['class_name']=='Dense' and layer_list[i-2]['class_name']=='Conv2D':
+                elif layer_list[i-1]['class_name']=='Dense' and layer_list[i-2]['class_name'] in conv2d_layers:
                     layer_in_name = "OUT_HEIGHT_{}*OUT_WIDTH_{}*N_FILT_{}".format(i-1, i-1, i-1)
                     layer_out_name = "N_LAYER_{}".format(i)   
                 elif i==len(layer_list) and (layer_list[i-1]['class_name']=='Dense' or (is_dense and layer_list[i-1]['class_name'] in activation_layers) or (is_dense and layer_list[i-1]['class_name']=='BatchNormalization')):
@@ -656,7 +903,7 @@ def hls_writer(layer_list, yamlConfig):
                     layer_n_chan_name = "N_CHAN_{}".format(i)
                     layer_y_out_name = "Y_OUTPUTS_{}".format(i)
                     layer_n_filt_name = "N_FILT_{}".format(i)
-                elif layer_list[i-1]['class_name']=='Conv2D': #or (is_conv2d and layer_list[i-1]['class_name']=='BatchNormalization'):
+                elif layer_list[i-1]['class_name'] in conv2d_layers: #or (is_conv2d and layer_list[i-1]['class_name']=='BatchNormalization'):
                     layer_in_height_name = "IN_HEIGHT_{}".format(i)
                     layer_in_width_name = "IN_WIDTH_{}".format(i)
                     layer_n_chan_name = "N_CHAN_{}".format(i)
@@ -668,6 +915,8 @@ def hls_writer(layer_list, yamlConfig):
                     layer_in_name = "OUT_HEIGHT_{}*OUT_WIDTH_{}*N_FILT_{}".format(i-1, i-1, i-1)
                     layer_out_name = "N_LAYER_{}".format(i)
                     layer_n_filt_name = "N_FILT_{}".format(i-1)
+                elif layer_list[i-1]['class_name'] in global_pooling_layers:
+                    layer_out_name = "N_OUTPUTS" if i==len(layer_list) else "N_LAYER_{}".format(i)
                 elif 'Pooling' in layer_list[i-1]['class_name']:
                     info = layer_list[i-1]['class_name'].split('Pooling')
                     d = int(info[1].split('D')[0])
@@ -683,40 +932,74 @@ def hls_writer(layer_list, yamlConfig):
                         layer_out_width_name = "OUT_WIDTH_{}".format(i)
                         layer_n_filt_name = "N_FILT_{}".format(i)
                         layer_in_name = "N_LAYER_{}".format(i-1)
+                #Layers of functional models that read another layer than the previous one
+                if 'inputs' in layer_list[i-1] and layer_list[i-1]['class_name'] in ['Dense', 'BatchNormalization']:
+                    layer_in_name = str(layer_list[i-1]['n_in'])
                 if layer_list[i-1]['class_name']=='Dense':
-                    if layer_list[i-1]['n_part']==1:
+                    if layer_list[i-1].get('quantized'):
+                        newline += binary_dense_config_template.format(index=str(i),
+                                                                       n_in=layer_in_name,
+                                                                       n_out=layer_out_name,
+                                                                       iotype=config_iotype,
+                                                                       reuse=layer_reuse,
+                                                                       tree_regs=layer_tree_regs,
+                                                                       nzeros=layer_list[i-1]['weights_n_zeros'],
+                                                                       binary_input=str(is_binary_input(layer_list, i)).lower(),
+                                                                       **layer_types)
+                    elif strategy == 'sparse':
+                        newline += sparse_config_template.format(index=str(i),
+                                                                 n_in=layer_in_name,
+                                                                 n_out=layer_out_name,
+                                                                 iotype=config_iotype,
+                                                                 reuse=layer_reuse,
+                                                                 tree_regs=layer_tree_regs,
+                                                                 nzeros=layer_list[i-1]['weights_n_zeros'],
+                                                                 n_nonzeros=layer_list[i-1]['n_in']*layer_list[i-1]['n_out']-layer_list[i-1]['weights_n_zeros'],
+                                                                 **layer_types)
+                    elif layer_list[i-1]['n_part']==1:
                         newline += dense_config_template.format(index=str(i), 
                                                                 n_in=layer_in_name, 
                                                                 n_out=layer_out_name,
-                                                                iotype=yamlConfig["IOType"],
-                                                                reuse=yamlConfig["ReuseFactor"],
-                                                                nzeros=layer_list[i-1]['weights_n_zeros'])
+                                                                iotype=config_iotype,
+                                                                reuse=layer_reuse,
+                                                                tree_regs=layer_tree_regs,
+                                                                nzeros=layer_list[i-1]['weights_n_zeros'],
+                                                                bram=str(strategy == 'resource').lower(),
+                                                                strategy=strategy,
+                                                                **layer_types)
                     else:
                         for i_part in range(0, layer_list[i-1]['n_part']):
                             newline += dense_sub_config_template.format(index=str(i),
                                                                         i_part=i_part,
                                                                         n_in=layer_in_name,
                                                                         n_out=layer_list[i-1]['n_subout'][i_part],
-                                                                        iotype=yamlConfig["IOType"],
-                                                                        reuse=yamlConfig["ReuseFactor"],
-                                                                        nzeros=layer_list[i-1]['weights_n_subzeros'][i_part])
+                                                                        iotype=config_iotype,
+                                                                        reuse=layer_reuse,
+                                                                        tree_regs=layer_tree_regs,
+                                                                        nzeros=layer_list[i-1]['weights_n_subzeros'][i_part],
+                                                                        bram=str(strategy == 'resource').lower(),
+                                                                        strategy=strategy,
+                                                                        **layer_types)
 
                     newline += activ_config_template.format(type=layer_list[i-1]['activation'],
                                                                     index=str(i), 
                                                                     n_in=layer_out_name,
-                                                                    iotype=yamlConfig["IOType"]) 
+                                                                    iotype=config_iotype,
+                                                                    softmax_impl=softmax_impl)
                 elif layer_list[i-1]['class_name']=='BatchNormalization':
                     newline += batchnorm_config_template.format(index=str(i), 
                                                             n_in=layer_in_name, 
                                                             n_out=layer_out_name,
                                                             n_filt=layer_n_filt_name,
-                                                            iotype=yamlConfig["IOType"],
-                                                            reuse=yamlConfig["ReuseFactor"])
+                                                            iotype=config_iotype,
+                                                            reuse=layer_reuse,
+                                                            **layer_types)
                 elif layer_list[i-1]['class_name'] in activation_layers:	
                     newline += activ_config_template.format(type=layer_list[i-1]['activation'],
                                                                     index=str(i), 
                                                                     n_in=layer_out_name,
-                                                                    iotype=yamlConfig["IOType"]) 
+                                                                    iotype=config_iotype,
+                                                                    softmax_impl=softmax_impl)
  
                 elif layer_list[i-1]['class_name']=='Conv1D':
                     newline += conv_config_template.format(index=str(i), 
@@ -728,20 +1011,83 @@ def hls_writer(layer_list, yamlConfig):
                                                             n_filt=layer_n_filt_name,
                                                             y_filt=layer_list[i-1]['y_filt'],
                                                             stride=layer_list[i-1]['stride'],
-                                                            iotype=yamlConfig["IOType"],
-                                                            reuse=yamlConfig["ReuseFactor"],
-                                                            nzeros=layer_list[i-1]['weights_n_zeros'])
+                                                            iotype=config_iotype,
+                                                            reuse=layer_reuse,
+                                                            tree_regs=layer_tree_regs,
+                                                            nzeros=layer_list[i-1]['weights_n_zeros'],
+                                                            **layer_types)
 
                     newline += activ_config_template.format(type=layer_list[i-1]['activation'],
                                                                     index=str(i), 
                                                                     n_in='{}*{}'.format(layer_y_out_name,layer_n_filt_name),
-                                                                    iotype=yamlConfig["IOType"]) 
+                                                                    iotype=config_iotype,
+                                                                    softmax_impl=softmax_impl)
+
+                elif layer_list[i-1]['class_name'] in ['DepthwiseConv2D', 'SeparableConv2D']:
+                    # A separable conv is a depthwise conv into the pointwise one, see nnet_sepconv2d.h
+                    separable = layer_list[i-1]['class_name']=='SeparableConv2D'
+                    depthwise_n_filt = '{}*{}'.format(layer_n_chan_name, layer_list[i-1]['depth_multiplier'])
+                    newline += depthwise_conv2d_config_template.format(index='{}_depthwise'.format(i) if separable else str(i),
+                                                            pad_top=layer_list[i-1]['pad_top'],
+                                                            pad_bottom=layer_list[i-1]['pad_bottom'],
+                                                            pad_left=layer_list[i-1]['pad_left'],
+                                                            pad_right=layer_list[i-1]['pad_right'],
+                                                            in_height=layer_in_height_name,
+                                                            in_width=layer_in_width_name,
+                                                            n_chan=layer_n_chan_name,
+                                                            out_height=layer_out_height_name,
+                                                            out_width=layer_out_width_name,
+                                                            depth_multiplier=layer_list[i-1]['depth_multiplier'],
+                                                            n_filt=depthwise_n_filt if separable else layer_n_filt_name,
+                                                            filt_height=layer_list[i-1]['filt_height'],
+                                                            filt_width=layer_list[i-1]['filt_width'],
+                                                            stride_height=layer_list[i-1]['stride_height'],
+                                                            stride_width=layer_list[i-1]['stride_width'],
+                                                            reuse=layer_reuse,
+                                                            tree_regs=layer_tree_regs,
+                                                            nzeros=0 if separable else layer_list[i-1]['weights_n_zeros'],
+                                                            **layer_types)
+                    if separable:
+                        newline += pointwise_conv2d_config_template.format(index='{}_pointwise'.format(i),
+                                                            in_height=layer_out_height_name,
+                                                            in_width=layer_out_width_name,
+                                                            n_chan=depthwise_n_filt,
+                                                            n_filt=layer_n_filt_name,
+                                                            reuse=layer_reuse,
+                                                            tree_regs=layer_tree_regs,
+                                                            nzeros=layer_list[i-1]['weights_n_zeros'],
+                                                            **layer_types)
 
-                elif layer_list[i-1]['class_name']=='Conv2D':
-                    newline += conv2d_config_template.format(index=str(i), 
-                                                            pad_top=layer_list[i-1]['pad_top'], 
+                    newline += activ_config_template.format(type=layer_list[i-1]['activation'],
+                                                                    index=str(i),
+                                                                    n_in='{}*{}*{}'.format(layer_out_height_name,layer_out_width_name,layer_n_filt_name),
+                                                                    iotype=config_iotype,
+                                                                    softmax_impl=softmax_impl)
+                elif layer_list[i-1]['class_name'] in conv2d_layers:
+                    pool = layer_list[i-1].get('pool')
+                    if pool:
+                        # The conv output before the fused max pooling, see nnet::conv_2d_pool
+                        newline += pooling2d_config_template.format(index='{}_pool'.format(i),
+                                                                    in_height=layer_list[i-1]['conv_out_height'],
+                                                                    in_width=layer_list[i-1]['conv_out_width'],
+                                                                    out_height=layer_out_height_name,
+                                                                    out_width=layer_out_width_name,
+                                                                    n_filt=layer_n_filt_name,
+                                                                    stride_height=pool['stride_height'],
+                                                                    stride_width=pool['stride_width'],
+                                                                    pool_height=pool['pool_height'],
+                                                                    pool_width=pool['pool_width'],
+                                                                    pad_left=pool['pad_left'],
+                                                                    pad_right=pool['pad_right'],
+                                                                    pad_top=pool['pad_top'],
+                                                                    pad_bottom=pool['pad_bottom'],
+                                                                    Op='Max',
+                                                                    reuse=layer_reuse)
+                    if layer_list[i-1].get('quantized'):
+                        newline += binary_conv2d_config_template.format(index=str(i),
+                                                            pad_top=layer_list[i-1]['pad_top'],
                                                             pad_bottom=layer_list[i-1]['pad_bottom'],
-                                                            pad_left=layer_list[i-1]['pad_left'], 
+                                                            pad_left=layer_list[i-1]['pad_left'],
                                                             pad_right=layer_list[i-1]['pad_right'],
                                                             in_height=layer_in_height_name,
                                                             in_width=layer_in_width_name,
@@ -753,14 +1099,70 @@ def hls_writer(layer_list, yamlConfig):
                                                             filt_width=layer_list[i-1]['filt_width'],
                                                             stride_height=layer_list[i-1]['stride_height'],
                                                             stride_width=layer_list[i-1]['stride_width'],
-                                                            iotype=yamlConfig["IOType"],
-                                                            reuse=yamlConfig["ReuseFactor"],
-                                                            nzeros=layer_list[i-1]['weights_n_zeros'])
+                                                            reuse=layer_reuse,
+                                                            tree_regs=layer_tree_regs,
+                                                            nzeros=layer_list[i-1]['weights_n_zeros'],
+                                                            binary_input=str(is_binary_input(layer_list, i)).lower(),
+                                                            **layer_types)
+                    else:
+                        newline += conv2d_config_template.format(index=str(i), 
+                                                                pad_top=layer_list[i-1]['pad_top'], 
+                                                                pad_bottom=layer_list[i-1]['pad_bottom'],
+                                                                pad_left=layer_list[i-1]['pad_left'], 
+                                                                pad_right=layer_list[i-1]['pad_right'],
+                                                                in_height=layer_in_height_name,
+                                                                in_width=layer_in_width_name,
+                                                                n_chan=layer_n_chan_name,
+                                                                out_height=layer_list[i-1]['conv_out_height'] if pool else layer_out_height_name,
+                                                                out_width=layer_list[i-1]['conv_out_width'] if pool else layer_out_width_name,
+                                                                n_filt=layer_n_filt_name,
+                                                                filt_height=layer_list[i-1]['filt_height'],
+                                                                filt_width=layer_list[i-1]['filt_width'],
+                                                                stride_height=layer_list[i-1]['stride_height'],
+                                                                stride_width=layer_list[i-1]['stride_width'],
+                                                                iotype=config_iotype,
+                                                                reuse=layer_reuse,
+                                                                tree_regs=layer_tree_regs,
+                                                                nzeros=layer_list[i-1]['weights_n_zeros'],
+                                                                **layer_types)
 
                     newline += activ_config_template.format(type=layer_list[i-1]['activation'],
                                                                     index=str(i), 
                                                                     n_in='{}*{}*{}'.format(layer_out_height_name,layer_out_width_name,layer_n_filt_name),
-                                                                    iotype=yamlConfig["IOType"]) 
+                                                                    iotype=config_iotype,
+                                                                    softmax_impl=softmax_impl)
+                elif layer_list[i-1]['class_name'] in merge_layers:
+                    if layer_list[i-1]['class_name']=='Concatenate':
+                        n_outer, n_elem1, n_elem2 = get_concat_sizes(layer_list[i-1], io_stream)
+                        newline += concat_config_template.format(index=str(i),
+                                                                 n_outer=n_outer,
+                                                                 n_elem1=n_elem1,
+                                                                 n_elem2=n_elem2)
+                    else:
+                        newline += merge_config_template.format(index=str(i),
+                                                                n_elem=layer_list[i-1]['n_out'])
+                    if 'activation' in layer_list[i-1].keys():
+                        newline += activ_config_template.format(type=layer_list[i-1]['activation'],
+                                                                index=str(i),
+                                                                n_in=layer_list[i-1]['n_out'],
+                                                                iotype=config_iotype,
+                                                                softmax_impl=softmax_impl)
+                elif layer_list[i-1]['class_name'] in global_pooling_layers:
+                    # nnet::flatten stores the outputs of the 2D layers filter by filter, streams carry pixels
+                    filt_major = layer_list[i-1]['class_name'].endswith('2D') and not io_stream
+                    newline += global_pooling_config_template.format(index=str(i),
+                                                                     n_in=layer_list[i-1]['n_in'],
+                                                                     n_filt=layer_list[i-1]['n_filt'],
+                                                                     filt_major='true' if filt_major else 'false',
+                                                                     Op=layer_list[i-1]['pool_op'],
+                                                                     accum_t=layer_types['accum_t'],
+                                                                     scale_t=get_reciprocal_precision(layer_list[i-1]['n_in'], get_layer_precision(yamlConfig, layer_list[i-1], 'accum') or yamlConfig['DefaultPrecision']))
+                    if 'activation' in layer_list[i-1].keys():
+                        newline += activ_config_template.format(type=layer_list[i-1]['activation'],
+                                                                index=str(i),
+                                                                n_in=layer_out_name,
+                                                                iotype=config_iotype,
+                                                                softmax_impl=softmax_impl)
                 elif 'Pooling' in layer_list[i-1]['class_name']:
                     info = layer_list[i-1]['class_name'].split('Pooling')
                     d = int(info[1].split('D')[0])
@@ -790,7 +1192,13 @@ def hls_writer(layer_list, yamlConfig):
                                                                     pad_top=layer_list[i-1]['pad_top'],
                                                                     pad_bottom=layer_list[i-1]['pad_bottom'],
                                                                     Op=op,
-                                                                    reuse=yamlConfig["ReuseFactor"])
+                                                                    reuse=layer_reuse)
+                        if 'activation' in layer_list[i-1].keys():
+                            newline += activ_config_template.format(type=layer_list[i-1]['activation'],
+                                                                    index=str(i),
+                                                                    n_in='{}*{}*{}'.format(layer_out_height_name,layer_out_width_name,layer_n_filt_name),
+                                                                    iotype=config_iotype,
+                                                                    softmax_impl=softmax_impl)
 
         else:
             newline = line
@@ -808,7 +1216,13 @@ def hls_writer(layer_list, yamlConfig):
     for line in f.readlines():
 
         #Insert numbers
-        if 'myproject' in line:
+        if 'myproject(data_str, res_str' in line and io_stream:
+            newline = '  hls::stream<input_axis_t> data_stream("data_stream");\n'
+            newline += '  hls::stream<result_axis_t> res_stream("res_stream");\n'
+            newline += '  nnet::array_to_axis<input_word_t, N_INPUT_WORDS>((input_t *) data_str, data_stream);\n'
+            newline += '  {}(data_stream, res_stream, size_in, size_out);\n'.format(yamlConfig['ProjectName'])
+            newline += '  nnet::axis_to_array<result_word_t, N_OUTPUT_WORDS>(res_stream, res_str);\n'
+        elif 'myproject' in line:
             newline = line.replace('myproject',yamlConfig['ProjectName'])
         elif '//hls-fpga-machine-learning insert data' in line and (layer_list[0]['class_name']=='Dense' or (is_dense and layer_list[0]['class_name']=='BatchNormalization')):
             newline = line
@@ -822,7 +1236,7 @@ def hls_writer(layer_list, yamlConfig):
             for i in range(0,layer_list[0]['y_in']*layer_list[0]['n_chan']-1):
                 newline += '0,'
             newline += '0};\n'
-        elif '//hls-fpga-machine-learning insert data' in line and layer_list[0]['class_name']=='Conv2D':
+        elif '//hls-fpga-machine-learning insert data' in line and layer_list[0]['class_name'] in conv2d_layers:
             newline = line
             newline += '  input_t  data_str[IN_HEIGHT_1][IN_WIDTH_1][N_CHAN_1] = {'
             for i in range(0,layer_list[0]['in_height']*layer_list[0]['in_width']*layer_list[0]['n_chan']-1):
@@ -841,6 +1255,44 @@ def hls_writer(layer_list, yamlConfig):
     fout.close()
 
 
+    ###################
+    ## batch runner and
+    ## C interface of the
+    ## shared library
+    ###################
+
+    for template in ['batch', 'bridge']:
+        f = open(os.path.join(filedir,'../hls-template/myproject_{}.cpp'.format(template)),'r')
+        fout = open('{}/{}_{}.cpp'.format(yamlConfig['OutputDir'], yamlConfig['ProjectName'], template),'w')
+
+        for line in f.readlines():
+
+            if 'myproject' in line:
+                newline = line.replace('myproject',yamlConfig['ProjectName'])
+            elif '//hls-fpga-machine-learning insert event size' in line:
+                newline = line
+                newline += '#define N_EVENT_INPUTS ({})\n'.format(event_size)
+                if template == 'bridge':
+                    # Raw bits of the values for myproject_predict_fixed, see quantize_array
+                    newline += '#define INPUT_FRAC_BITS ({})\n'.format(get_frac_bits(yamlConfig["DefaultPrecision"]))
+                    newline += '#define RESULT_FRAC_BITS ({})\n'.format(get_frac_bits(get_layer_precision(yamlConfig, layer_list[-1], 'result') or yamlConfig["DefaultPrecision"]))
+            elif '//hls-fpga-machine-learning insert top call' in line and io_stream:
+                newline = line
+                newline += '  hls::stream<input_axis_t> data_stream("data_stream");\n'
+                newline += '  hls::stream<result_axis_t> res_stream("res_stream");\n'
+                newline += '  nnet::array_to_axis<input_word_t, N_INPUT_WORDS>(data, data_stream);\n'
+                newline += '  {}(data_stream, res_stream, size_in, size_out);\n'.format(yamlConfig['ProjectName'])
+                newline += '  nnet::axis_to_array<result_word_t, N_OUTPUT_WORDS>(res_stream, res);\n'
+            elif '//hls-fpga-machine-learning insert top call' in line:
+                newline = line
+                newline += '  {}({}, res, size_in, size_out);\n'.format(yamlConfig['ProjectName'], event_data)
+            else:
+                newline = line
+            fout.write(newline)
+        f.close()
+        fout.close()
+
+
     #######################
     ## myproject.h
     #######################
@@ -854,9 +1306,13 @@ def hls_writer(layer_list, yamlConfig):
             newline = line.replace('MYPROJECT',format(yamlConfig['ProjectName'].upper()))
         elif 'void myproject(' in line:
             newline = 'void {}(\n'.format(yamlConfig['ProjectName'])
+        elif 'input_t data[N_INPUTS]' in line and io_stream:
+            newline = line.replace('input_t data[N_INPUTS]','hls::stream<input_axis_t> &data')
+        elif 'result_t res[N_OUTPUTS]' in line and io_stream:
+            newline = line.replace('result_t res[N_OUTPUTS]','hls::stream<result_axis_t> &res')
         elif 'input_t data[N_INPUTS]' in line and layer_list[0]['class_name']=='Conv1D':
             newline = line.replace('input_t data[N_INPUTS]','input_t data[Y_INPUTS_1][N_CHAN_1]')
-        elif 'input_t data[N_INPUTS]' in line and layer_list[0]['class_name']=='Conv2D':
+        elif 'input_t data[N_INPUTS]' in line and layer_list[0]['class_name'] in conv2d_layers:
             newline = line.replace('input_t data[N_INPUTS]','input_t data[IN_HEIGHT_1][IN_WIDTH_1][N_CHAN_1]')
         elif 'input_t data[N_INPUTS]' in line and layer_list[0]['class_name']=='BatchNormalization' and is_conv2d:
             newline = line.replace('input_t data[N_INPUTS]','input_t data[IN_HEIGHT_1][IN_WIDTH_1][N_FILT_1]')
@@ -897,6 +1353,16 @@ def hls_writer(layer_list, yamlConfig):
     f.close()
     fout.close()
 
+    f = open(os.path.join(filedir,'../hls-template/build_lib.sh'),'r')
+    fout = open('{}/build_lib.sh'.format(yamlConfig['OutputDir']),'w')
+    for line in f.readlines():
+        line = line.replace('myproject',yamlConfig['ProjectName'])
+        line = line.replace('-Innet_utils', '-I{}'.format(relpath))
+        fout.write(line)
+    f.close()
+    fout.close()
+    os.chmod('{}/build_lib.sh'.format(yamlConfig['OutputDir']), 0o755)
+
 
     ###################
     # Tarball output
@@ -906,6 +1372,252 @@ def hls_writer(layer_list, yamlConfig):
 
 
 
+#######################################
+## io_stream: values per stream word of
+## the input and of the output of every
+## layer, one pixel for conv layers
+#######################################
+def get_stream_word_sizes(layer_list):
+
+    conv2d_layers = ['Conv2D', 'DepthwiseConv2D', 'SeparableConv2D']
+
+    first = layer_list[0]
+    if first['class_name'] in ['Conv1D'] + conv2d_layers:
+        input_word_size = first['n_chan']
+    elif first['class_name'] == 'BatchNormalization':
+        input_word_size = first['n_filt']
+    else:
+        input_word_size = first['n_in']
+
+    word_sizes = []
+    for i, layer in enumerate(layer_list, 1):
+        i_in = get_input_index(layer_list, i)
+        word_size = word_sizes[i_in-1] if i_in > 0 else input_word_size
+        if layer['class_name'].startswith('Global'):
+            if word_size != layer['n_filt']:
+                raise Exception('ERROR: {} layer {} needs its inputs one pixel per stream word, got words of {} values'.format(layer['class_name'], layer['name'], word_size))
+        elif 'Pooling1D' in layer['class_name']:
+            raise Exception('ERROR: {} layer {} is not supported with io_stream'.format(layer['class_name'], layer['name']))
+        elif 'Pooling2D' in layer['class_name'] and word_size != layer['n_filt']:
+            raise Exception('ERROR: {} layer {} needs its inputs one pixel per stream word, got words of {} values'.format(layer['class_name'], layer['name'], word_size))
+        elif layer['class_name'] in ['Conv1D'] + conv2d_layers and word_size != layer['n_chan']:
+            raise Exception('ERROR: {} layer {} needs its inputs one pixel per stream word, got words of {} values'.format(layer['class_name'], layer['name'], word_size))
+        elif layer['class_name'] == 'BatchNormalization' and word_size != layer['n_filt']:
+            raise Exception('ERROR: BatchNormalization layer {} needs its inputs one pixel per stream word, got words of {} values'.format(layer['name'], word_size))
+        if layer['class_name'] == 'Dense':
+            word_size = layer['n_out']
+        elif layer['class_name'] in ['Conv1D'] + conv2d_layers:
+            word_size = layer['n_filt']
+        elif 'inputs' in layer and len(layer['inputs']) == 2:
+            # Merge layers, along the last axis a word of the result holds a word of each input
+            sizes = [word_sizes[i_in-1] if i_in > 0 else input_word_size for i_in in layer['inputs']]
+            if get_merge_kernel(layer, True) == 'concat':
+                if sizes != [shape[-1] for shape in layer['input_shapes']]:
+                    raise Exception('ERROR: Concatenate layer {} needs its inputs one pixel per stream word, got words of {} and {} values'.format(layer['name'], sizes[0], sizes[1]))
+                word_size = sizes[0] + sizes[1]
+            elif sizes[0] != sizes[1]:
+                raise Exception('ERROR: {} layer {} needs stream words of the same size on both inputs, got words of {} and {} values'.format(layer['class_name'], layer['name'], sizes[0], sizes[1]))
+        word_sizes.append(word_size)
+    return input_word_size, word_sizes
+
+#######################################
+## io_stream: layers connected by FIFOs
+## under DATAFLOW, from the AXI-Stream
+## input data to the output res
+#######################################
+def get_stream_layers(layer_list, yamlConfig, activation_tables, alpha_types):
+
+    activation_layers = ['Activation', 'LeakyReLU', 'ThresholdedReLU', 'ELU', 'PReLU']
+    conv2d_layers = ['Conv2D', 'DepthwiseConv2D', 'SeparableConv2D']
+    strategy = yamlConfig.get('Strategy', 'Latency').lower()
+
+    # FIFO depths given by the user, e.g. from C/RTL cosimulation
+    fifo_depths = read_fifo_depths(yamlConfig['FIFODepths']) if yamlConfig.get('FIFODepths') else {}
+    fifo_names = []
+
+    def declare_stream(word_type, name, depth=1):
+        fifo_names.append(name)
+        line = '    hls::stream<{}> {}("{}");\n'.format(word_type, name, name)
+        line += '    #pragma HLS STREAM variable={} depth={}\n'.format(name, fifo_depths.get(name, depth))
+        return line
+
+    # Functional models: the FIFO each layer reads, a copy of the output of a layer that
+    # several layers read (see nnet::clone_stream), so that the branches run concurrently
+    input_word_size, word_sizes = get_stream_word_sizes(layer_list)
+    readers = dict((i_in, []) for i_in in range(len(layer_list)))
+    for i in range(1,len(layer_list)+1):
+        for i_in in layer_list[i-1].get('inputs', [i-1]):
+            readers[i_in].append(i)
+    input_objects = {}
+    n_copies = dict((i_in, 0) for i_in in readers)
+    for i in range(1,len(layer_list)+1):
+        for i_in in layer_list[i-1].get('inputs', [i-1]):
+            n_copies[i_in] += 1
+            input_objects.setdefault(i, []).append('layer{}_cpy{}'.format(i_in, n_copies[i_in]) if len(readers[i_in]) > 1 else 'layer{}_out'.format(i_in))
+
+    def clone_stream(i_in):
+        if len(readers[i_in]) < 2:
+            return ''
+        # A copy holds all the words of an event by default, the other branch may need them
+        # all before the merge reads this one. FIFODepths can set smaller depths
+        word_type = 'input_word_t' if i_in == 0 else 'layer{}_word_t'.format(i_in)
+        n_words = get_output_size(layer_list, i_in) // (word_sizes[i_in-1] if i_in > 0 else input_word_size)
+        copies = ['layer{}_cpy{}'.format(i_in, n+1) for n in range(len(readers[i_in]))]
+        line = ''.join([declare_stream(word_type, name, n_words) for name in copies])
+        line += '    nnet::clone_stream<{}, {}>(layer{}_out, {});\n'.format(word_type, n_words, i_in, ', '.join(copies))
+        return line
+
+    lines = declare_stream('input_word_t', 'layer0_out')
+    lines += '    nnet::axis_to_stream<input_word_t, N_INPUT_WORDS>(data, layer0_out);\n'
+    lines += clone_stream(0) + '\n'
+
+    for i in range(1,len(layer_list)+1):
+        layer = layer_list[i-1]
+        i_in = get_input_index(layer_list, i)
+        input_type = 'input_word_t' if i_in == 0 else 'layer{}_word_t'.format(i_in)
+        input_object = input_objects[i][0]
+        output_type = 'result_word_t' if i == len(layer_list) else 'layer{}_word_t'.format(i)
+        output_object = 'layer{}_out'.format(i)
+
+        if layer['class_name'] == 'SeparableConv2D':
+            # Depthwise conv into its own FIFO, then the pointwise conv
+            lines += declare_stream('layer{}_dw_word_t'.format(i), 'layer{}_dw'.format(i))
+            lines += '    nnet::depthwise_conv_2d_stream<{}, layer{}_dw_word_t, config{}_depthwise>({}, layer{}_dw, dw{}, db{});\n'.format(input_type, i, i, input_object, i, i, i)
+            input_type = 'layer{}_dw_word_t'.format(i)
+            input_object = 'layer{}_dw'.format(i)
+
+        if layer['class_name'] in ['Dense', 'Conv1D'] + conv2d_layers:
+            lines += declare_stream(output_type, 'logits{}'.format(i))
+            if layer.get('quantized'):
+                kernel = 'conv_2d_binary_stream' if layer['class_name'] == 'Conv2D' else 'compute_layer_binary'
+            elif layer['class_name'] == 'Conv1D':
+                kernel = 'conv_1d_stream'
+            elif layer['class_name'] == 'Conv2D':
+                kernel = 'conv_2d_stream'
+            elif layer['class_name'] == 'DepthwiseConv2D':
+                kernel = 'depthwise_conv_2d_stream'
+            elif layer['class_name'] == 'SeparableConv2D':
+                kernel = 'pointwise_conv_2d_stream'
+            elif strategy == 'sparse':
+                kernel = 'compute_layer_sparse'
+            else:
+                kernel = 'compute_layer'
+            config = 'config{}_pointwise'.format(i) if layer['class_name'] == 'SeparableConv2D' else 'config{}'.format(i)
+            lines += '    nnet::{}<{}, {}, {}>({}, logits{}, w{}, b{});\n'.format(kernel, input_type, output_type, config, input_object, i, i, i)
+            act_input_object = 'logits{}'.format(i)
+            act_input_type = output_type
+            lines += declare_stream(output_type, output_object)
+        elif 'Pooling' in layer['class_name']:
+            # An activation after the pooling has its own FIFO
+            kernel = 'global_pooling_stream' if layer['class_name'].startswith('Global') else 'pooling2d_stream'
+            pool_object = 'logits{}'.format(i) if 'activation' in layer.keys() else output_object
+            lines += declare_stream(output_type, pool_object)
+            lines += '    nnet::{}<{}, {}, config{}>({}, {});\n'.format(kernel, input_type, output_type, i, input_object, pool_object)
+            act_input_object = pool_object
+            act_input_type = output_type
+            if 'activation' in layer.keys():
+                lines += declare_stream(output_type, output_object)
+        elif layer['class_name'] == 'BatchNormalization':
+            lines += declare_stream(output_type, output_object)
+            lines += '    nnet::normalize<{}, {}, config{}>({}, {}, scale{}, b{});\n'.format(input_type, output_type, i, input_object, output_object, i, i)
+        elif 'inputs' in layer and len(layer['inputs']) == 2:
+            # Merge layers, an activation after the merge has its own FIFO
+            merge_object = 'logits{}'.format(i) if 'activation' in layer.keys() else output_object
+            input_types = ['input_word_t' if i_in == 0 else 'layer{}_word_t'.format(i_in) for i_in in layer['inputs']]
+            lines += declare_stream(output_type, merge_object)
+            lines += '    nnet::{}<{}, {}, {}, config{}>({}, {}, {});\n'.format(get_merge_kernel(layer, True), input_types[0], input_types[1], output_type, i, input_objects[i][0], input_objects[i][1], merge_object)
+            act_input_object = merge_object
+            act_input_type = output_type
+            if 'activation' in layer.keys():
+                lines += declare_stream(output_type, output_object)
+        else:
+            act_input_object = input_object
+            act_input_type = input_type
+            lines += declare_stream(output_type, output_object)
+
+        if layer['class_name'] in activation_layers or 'activation' in layer.keys():
+            table_args = ''.join([', ' + name for name, values in dict(activation_tables)[i]])
+            if layer['activation'] == 'PReLU':
+                # The alpha array holds plain values, not words
+                alpha_types[i] = act_input_type.replace('_word_t', '_t')
+            lines += get_activation_call(layer, i, act_input_type, output_type, act_input_object, output_object, table_args)
+        lines += '    NNET_TRACE_STREAM("{}", "{}", {});\n'.format(get_trace_name(layer), get_layer_precision(yamlConfig, layer, 'result') or yamlConfig["DefaultPrecision"], output_object)
+        if i < len(layer_list):
+            lines += clone_stream(i)
+        lines += '\n'
+
+    lines += '    nnet::stream_to_axis<result_word_t, N_OUTPUT_WORDS>(layer{}_out, res);\n'.format(len(layer_list))
+
+    for name in fifo_depths.keys():
+        if name not in fifo_names:
+            print('WARNING: No FIFO {} for the FIFODepths file, ignoring its depth'.format(name))
+    if fifo_depths:
+        for name in fifo_names:
+            if name not in fifo_depths:
+                print('WARNING: No depth for FIFO {} in the FIFODepths file, using the default depth'.format(name))
+    return lines
+
+#######################################
+## io_stream: FIFO depths given by the
+## user, "name depth" per line
+#######################################
+def read_fifo_depths(filename):
+
+    fifo_depths = {}
+    with open(filename) as f:
+        for n, line in enumerate(f.readlines()):
+            fields = line.split()
+            if not fields:
+                continue
+            if len(fields) != 2 or not fields[1].isdigit():
+                raise Exception('ERROR: Invalid FIFO depth on line {} of {}: {}'.format(n+1, filename, line.strip()))
+            # A FIFO that never held a word still needs one slot
+            fifo_depths[fields[0]] = max(int(fields[1]), 1)
+    return fifo_depths
+
+#######################################
+## Call of the activation of layer i,
+## on arrays or on streams alike
+#######################################
+def get_activation_call(layer, i, act_input_type, output_type, act_input_object, output_object, table_args):
+
+    activation_name = layer['activation']+'_config'+str(i)
+    activation_param = layer.get('activ_param')
+    if layer['activation'] == "relu":
+        return '    nnet::relu<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
+    elif layer['activation'] == "LeakyReLU":
+        return '    nnet::leaky_relu<{}, {}, {}>({}, {}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, activation_param, output_object)
+    elif layer['activation'] == "ThresholdedReLU":
+        return '    nnet::thresholded_relu<{}, {}, {}>({}, {}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, activation_param, output_object)
+    elif layer['activation'].lower() == "elu":
+        if not activation_param: activation_param = 1.0
+        return '    nnet::elu<{}, {}, {}>({}, {}, {}{});\n'.format(act_input_type, output_type, activation_name, act_input_object, activation_param, output_object, table_args)
+    elif layer['activation'] == "selu":
+        return '    nnet::selu<{}, {}, {}>({}, {}{});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object, table_args)
+    elif layer['activation'] == "PReLU":
+        return '    nnet::prelu<{}, {}, {}>({}, a{}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, i, output_object)
+    elif layer['activation'] == "softmax":
+        return '    nnet::softmax<{}, {}, {}>({}, {}{});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object, table_args)
+    elif layer['activation'] == "sigmoid":
+        return '    nnet::sigmoid<{}, {}, {}>({}, {}{});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object, table_args)
+    elif layer['activation'] == "hard_sigmoid":
+        return '    nnet::hard_sigmoid<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
+    elif layer['activation'] == "tanh":
+        return '    nnet::tanh<{}, {}, {}>({}, {}{});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object, table_args)
+    elif layer['activation'] == "linear": 
+        #github Issue 53
+        return '    nnet::linear<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
+    elif layer['activation'] == "softsign":
+        return '    nnet::softsign<{}, {}, {}>({}, {}{});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object, table_args)
+    elif layer['activation'] == "softplus":
+        return '    nnet::softplus<{}, {}, {}>({}, {}{});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object, table_args)
+    elif layer['activation'] == "binary_tanh":
+        return '    nnet::binary_tanh<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
+    elif layer['activation'] == "ternary_tanh":
+        return '    nnet::ternary_tanh<{}, {}, {}>({}, {});\n'.format(act_input_type, output_type, activation_name, act_input_object, output_object)
+    else:
+        raise Exception('ERROR: MISSING ACTIVATION')
+
 #######################################
 ## Config module
 #######################################
@@ -915,21 +1627,379 @@ def parse_config(config_file) :
     config = open(config_file, 'r')
     return yaml.load(config, Loader=yaml.Loader)
 
+#######################################
+## Per layer precision and reuse factor,
+## from the LayerName section of the
+## config, by Keras layer name
+#######################################
+layer_precision_keys = ['weight', 'bias', 'accum', 'result', 'scale']
+
+def get_layer_config(yamlConfig, layer):
+
+    # Keys as strings, YAML reads the PyTorch module names as numbers
+    layer_configs = dict((str(name), config) for name, config in (yamlConfig.get('LayerName') or {}).items())
+    return layer_configs.get(str(layer.get('name'))) or {}
+
+def get_layer_precision(yamlConfig, layer, key):
+
+    # A single precision applies to all the types of the layer
+    precision = get_layer_config(yamlConfig, layer).get('Precision') or {}
+    if not isinstance(precision, dict):
+        return precision
+    for k in precision.keys():
+        if k not in layer_precision_keys:
+            raise Exception('ERROR: Unknown precision {} of layer {}, valid values are: {}'.format(k, layer.get('name'), layer_precision_keys))
+    return precision.get(key)
+
+def get_layer_type(yamlConfig, layer, i, key):
+
+    # Name of the weight, bias, accum, ... type of layer i, the default one unless overridden.
+    # Binary and ternary weights have their own types, see nnet_binary.h
+    if key == 'weight' and layer.get('quantized'):
+        return 'nnet::{}_weight_t'.format(layer['quantized'])
+    if get_layer_precision(yamlConfig, layer, key) is None:
+        return '{}_default_t'.format(key)
+    return '{}{}_t'.format(key, i)
+
+def get_type_precision(yamlConfig, layer, key):
+
+    # C++ type behind get_layer_type, None for the binary and ternary weights
+    if key == 'weight' and layer.get('quantized'):
+        return None
+    return get_layer_precision(yamlConfig, layer, key) or yamlConfig['DefaultPrecision']
+
+def get_layer_reuse(yamlConfig, layer):
+
+    return get_layer_config(yamlConfig, layer).get('ReuseFactor', yamlConfig['ReuseFactor'])
+
+def is_binary_input(layer_list, i):
+
+    # The inputs of layer i are the +1/-1 outputs of a binary_tanh activation, possibly
+    # through max pooling, so that nnet_binary.h takes the XNOR of the sign bits. The layers
+    # are followed through their inputs, which for functional models need not be the previous ones
+    i_in = get_input_index(layer_list, i)
+    while i_in > 0:
+        layer = layer_list[i_in-1]
+        if layer.get('activation') == 'binary_tanh':
+            return True
+        if not (layer['class_name'] in ['MaxPooling1D', 'MaxPooling2D', 'GlobalMaxPooling1D', 'GlobalMaxPooling2D'] and 'activation' not in layer):
+            return False
+        i_in = get_input_index(layer_list, i_in)
+    return False
+
+def get_input_index(layer_list, i):
+
+    # Layer whose output layer i reads, 0 for the input of the model. The layers of
+    # functional models can read another one than the previous layer, see keras-to-hls.py
+    return layer_list[i-1]['inputs'][0] if 'inputs' in layer_list[i-1] else i-1
+
+def get_array_input(layer_list, i_in):
+
+    # (type, array) of the output of layer i_in, not the last layer, as read by another layer
+    if i_in == 0:
+        return 'input_t', 'data'
+    return 'layer{}_t'.format(i_in), 'layer{}_out'.format(i_in)
+
+def get_merge_kernel(layer, io_stream):
+
+    # Along the last axis a stream word of the result holds a word of each input, see nnet_merge.h
+    if layer['class_name'] == 'Concatenate':
+        last_axis = layer['axis'] == len(layer['input_shapes'][0]) - 1
+        return 'concat_words' if io_stream and not last_axis else 'concat'
+    return layer['class_name'].lower()
+
+def get_concat_sizes(layer, io_stream):
+
+    # (n_outer, n_elem1, n_elem2) of nnet::concat, see concat_config. Without io_stream the
+    # outputs of the 2D layers are flattened channel major, see nnet::flatten
+    shapes = layer['input_shapes']
+    axis = layer['axis']
+    if len(shapes[0]) == 3 and not io_stream:
+        shapes = [[shape[2], shape[0], shape[1]] for shape in shapes]
+        axis = (axis + 1) % 3
+    return int(np.prod(shapes[0][:axis])), int(np.prod(shapes[0][axis:])), int(np.prod(shapes[1][axis:]))
+
+def get_trace_name(layer):
+
+    # Keras layer whose output the layer computes, the last one merged into it (activation,
+    # folded batch normalization or fused pooling), see nnet_utils/nnet_trace.h
+    return str(layer.get('output_name', layer['name']))
+
+def get_trace_layout(layer_list, i, io_stream):
+
+    # Without io_stream the outputs of the 2D layers are flattened channel major, see
+    # nnet::flatten, and the activation layers keep the order of their input
+    activation_layers = ['Activation', 'LeakyReLU', 'ThresholdedReLU', 'ELU', 'PReLU']
+    while layer_list[i-1]['class_name'] in activation_layers and get_input_index(layer_list, i) > 0:
+        i = get_input_index(layer_list, i)
+    layer = layer_list[i-1]
+    is_2d = layer['class_name'] in ['Conv2D', 'DepthwiseConv2D', 'SeparableConv2D', 'MaxPooling2D', 'AveragePooling2D']
+    is_2d |= layer['class_name'] in ['BatchNormalization', 'Add', 'Subtract', 'Multiply', 'Average', 'Maximum', 'Minimum', 'Concatenate'] and ('in_height' in layer or 'out_height' in layer)
+    return 'chw' if is_2d and not io_stream else 'flat'
+
+def get_layer_tree_regs(yamlConfig, layer):
+
+    # Pipeline registers per level of the adder trees of the layer, see nnet::adder_tree
+    return get_layer_config(yamlConfig, layer).get('AdderTreeRegs', yamlConfig.get('AdderTreeRegs', 0))
+
+#######################################
+## Quantize weights to their C++ type
+#######################################
+def parse_fixed_type(precision):
+
+    # (width, integer bits, signed, quantization, overflow) of an ap_fixed, ap_ufixed,
+    # ap_int or ap_uint type, None for other types (float, double, ...)
+    m = re.match(r'^\s*(ap_u?fixed)\s*<\s*(\d+)\s*,\s*(-?\d+)\s*(?:,\s*(AP_\w+)\s*)?(?:,\s*(AP_\w+)\s*)?(?:,\s*\d+\s*)?>\s*$', str(precision))
+    if m:
+        return int(m.group(2)), int(m.group(3)), m.group(1) == 'ap_fixed', m.group(4) or 'AP_TRN', m.group(5) or 'AP_WRAP'
+    m = re.match(r'^\s*(ap_u?int)\s*<\s*(\d+)\s*>\s*$', str(precision))
+    if m:
+        # Conversions from floating point to integers truncate towards zero
+        return int(m.group(2)), int(m.group(2)), m.group(1) == 'ap_int', 'AP_TRN_ZERO', 'AP_WRAP'
+    return None
+
+def get_reciprocal_precision(n, precision):
+
+    # Type of the constant 1/n: unsigned, rounded, with the integer bits that 1/n needs (negative
+    # for n > 2) so that all the bits are significant, as many as precision has and at least 18.
+    # Floating point precisions are kept
+    fixed_type = parse_fixed_type(precision)
+    if fixed_type is None:
+        return precision
+    width = max(18, fixed_type[0])
+    return 'ap_ufixed<{},{},AP_RND>'.format(width, 1 - (int(n).bit_length() - 1))
+
+def quantize_array(a, precision):
+
+    # The values of a as the integers k of k * 2^-frac_bits in the given type, rounded and
+    # wrapped or saturated as the C++ conversion from double does (AP_WRAP_SM as AP_WRAP,
+    # like nnet_fixed.h). Returns (k, frac_bits, n_overflows), or None for the types that
+    # are not fixed point and those too wide for exact doubles
+    fixed_type = parse_fixed_type(precision)
+    if fixed_type is None or fixed_type[0] > 53:
+        return None
+    width, int_bits, signed, q_mode, o_mode = fixed_type
+    frac_bits = width - int_bits
+    n = np.ldexp(np.asarray(a, dtype=np.float64), frac_bits)
+    if q_mode == 'AP_TRN':
+        k = np.floor(n)
+    elif q_mode == 'AP_TRN_ZERO':
+        k = np.trunc(n)
+    elif q_mode == 'AP_RND':
+        k = np.floor(n + 0.5)
+    elif q_mode == 'AP_RND_ZERO':
+        k = np.sign(n) * np.ceil(np.abs(n) - 0.5)
+    elif q_mode == 'AP_RND_MIN_INF':
+        k = np.ceil(n - 0.5)
+    elif q_mode == 'AP_RND_INF':
+        k = np.sign(n) * np.floor(np.abs(n) + 0.5)
+    elif q_mode == 'AP_RND_CONV':
+        k = np.rint(n)
+    else:
+        raise Exception('ERROR: Unknown quantization mode {} of {}'.format(q_mode, precision))
+    lo = -2.0**(width-1) if signed else 0.0
+    hi = 2.0**(width-1) - 1 if signed else 2.0**width - 1
+    out = (k < lo) | (k > hi)
+    if o_mode == 'AP_SAT':
+        k = np.clip(k, lo, hi)
+    elif o_mode == 'AP_SAT_ZERO':
+        k = np.where(out, 0.0, k)
+    elif o_mode == 'AP_SAT_SYM':
+        k = np.clip(k, -hi if signed else 0.0, hi)
+    else:
+        k = np.mod(k - lo, 2.0**width) + lo
+    return k.astype(np.int64), frac_bits, int(np.count_nonzero(out))
+
+def get_frac_bits(precision):
+
+    # Fractional bits of a fixed point type, -1 for the types quantize_array leaves as is
+    fixed_type = parse_fixed_type(precision)
+    if fixed_type is None or fixed_type[0] > 53:
+        return -1
+    return fixed_type[0] - fixed_type[1]
+
+def format_values(name, a, precision, warn = True):
+
+    # C++ literals of the values of a, quantized to precision so that the conversion of the
+    # literals is exact: the C++ types keep what was validated in Python, and the shortest
+    # literal of each quantized value is shorter than the full float
+    quantized = quantize_array(a, precision)
+    if quantized is None:
+        return ["%.12f" % x for x in np.nditer(a, order='C')]
+    k, frac_bits, n_overflows = quantized
+    if n_overflows > 0 and warn:
+        print('WARNING: {} values of {} are out of the range of {}'.format(n_overflows, name, precision))
+    return [repr(float(np.ldexp(float(x), -frac_bits))) if x != 0 else '0' for x in np.nditer(k, order='C')]
+
+def print_mem_file(name, a, odir, precision):
+
+    # The bits of each value, two's complement, as hex words that $readmemh and
+    # nnet::load_weights_mem read
+    k, frac_bits, n_overflows = quantize_array(a, precision)
+    width = parse_fixed_type(precision)[0]
+    f=open("{}/firmware/weights/{}.mem".format(odir,name),"w")
+    f.write("// {} values of {}\n".format(k.size, precision))
+    digits = (width + 3) // 4
+    for x in np.nditer(k, order='C'):
+        f.write("{:0{}x}\n".format(int(x) & ((1 << width) - 1), digits))
+    f.close()
+
+#######################################
+## Print the nonzero weights of a dense
+## layer to C++ in COO format
+#######################################
+def print_sparse_array_to_cpp(name, a, odir, type_name = 'sparse_weight_default_t', precision = None):
+
+    f=open("{}/firmware/weights/{}.h".format(odir,name),"w")
+
+    #(row, col) of the nonzero weights, in the same order as the dense array
+    rows, cols = np.nonzero(a)
+    zero_ctr = a.size - len(rows)
+    if len(rows) == 0:
+        raise Exception('ERROR: No nonzero weights in {}'.format(name))
+
+    #meta data
+    f.write("//Numpy array shape {}\n".format(a.shape))
+    f.write("//Min {:.12f}\n".format(np.min(a)))
+    f.write("//Max {:.12f}\n".format(np.max(a)))
+    f.write("//Number of zeros {}\n".format(zero_ctr))
+    f.write("//Sparse (row, col, weight) format\n")
+    f.write("\n")
+
+    #c++ variable
+    f.write("{} {}[{}] = {{".format(type_name, name, len(rows)))
+    values = format_values(name, a[rows, cols], precision)
+    for i, (r, c) in enumerate(zip(rows, cols)):
+        if i==0:
+            f.write("{%d, %d, %s}" % (r, c, values[i]))
+        else:
+            f.write(", {%d, %d, %s}" % (r, c, values[i]))
+    f.write("};\n")
+    f.close()
+
+    return zero_ctr
+
+#######################################
+## Lookup tables of an activation, same
+## as the init_*_table functions in
+## nnet_activation.h
+#######################################
+def get_activation_tables(activation, n_in, softmax_impl = 'stable', table_size = 1024):
+
+    ii = np.arange(table_size, dtype=np.float32)
+    x_sym = 2*8.0*(ii-table_size/2.0)/table_size # range -8 to +8
+    x_neg = -8.0*ii/table_size                   # range -8 to 0
+
+    activation = activation.lower()
+    if activation == 'sigmoid':
+        tables = [('sigmoid_table', 1.0/(1+np.exp(-x_sym)))]
+    elif activation == 'tanh':
+        tables = [('tanh_table', np.tanh(2*4.0*(ii-table_size/2.0)/table_size))]
+    elif activation == 'softplus':
+        tables = [('softplus_table', np.log(np.exp(x_sym) + 1.))]
+    elif activation == 'softsign':
+        tables = [('softsign_table', x_sym / (np.abs(x_sym) + 1.))]
+    elif activation == 'elu':
+        tables = [('elu_table', np.exp(x_neg) - 1.)]
+    elif activation == 'selu':
+        tables = [('selu_table', 1.0507009873554804934193349852946 * (1.6732632423543772848170429916717 * (np.exp(x_neg) - 1.)))]
+    elif activation == 'softmax' and softmax_impl == 'legacy':
+        # nnet::softmax_legacy, exponentials of the differences between -8 and +8 and
+        # reciprocal of the sums between 0 and 64
+        x_inv = 64.0*ii/table_size
+        tables = [('exp_legacy_table', np.exp(x_sym)),
+                  ('invert_legacy_table', np.where(x_inv > 0, 1.0/np.maximum(x_inv, 1e-30), 0.0))]
+    elif activation == 'softmax':
+        # nnet::softmax_stable, the reciprocal covers the next power of two above n_in.
+        # The sum is at least 1, the entries below it are never read and hold 1
+        inv_range = 2**ceillog2(n_in)
+        x_inv = inv_range*ii/table_size
+        tables = [('exp_table', np.exp(x_neg)),
+                  ('invert{}_table'.format(inv_range), 1.0/np.maximum(x_inv, 1.0))]
+    else:
+        tables = []
+
+    return [('{}{}'.format(name, table_size), values) for name, values in tables]
+
+def get_activation_n_in(layer_list, i):
+
+    # Output size of the last layer up to layer i that defines one
+    for layer in reversed(layer_list[:i]):
+        if 'n_out' in layer.keys():
+            return layer['n_out']
+        elif 'out_height' in layer.keys():
+            return layer['out_height']*layer['out_width']*layer['n_filt']
+        elif 'y_out' in layer.keys():
+            return layer['y_out']*layer['n_filt']
+    raise Exception('ERROR: Cannot determine the input size of layer {}'.format(i))
+
+def get_output_size(layer_list, i):
+
+    # Number of values of the output of layer i, of the input of the model for i = 0
+    if i > 0:
+        return get_activation_n_in(layer_list, i)
+    first = layer_list[0]
+    if first['class_name'] == 'Conv1D':
+        return first['y_in']*first['n_chan']
+    elif 'in_height' in first:
+        return first['in_height']*first['in_width']*first.get('n_chan', first.get('n_filt'))
+    return first['n_in']
+
+def ceillog2(x):
+
+    # Same as nnet::ceillog2
+    return 1 if x <= 2 else 1 + ceillog2((x+1) // 2)
+
+#######################################
+## Print an activation lookup table to C++
+#######################################
+def get_table_precision(yamlConfig):
+
+    # One type for all the tables, which layers share by name
+    return yamlConfig.get('TablePrecision') or 'ap_fixed<18,8>'
+
+def print_table_to_cpp(name, values, odir, precision):
+
+    f=open("{}/firmware/weights/{}.h".format(odir,name),"w")
+
+    #meta data
+    f.write("//Lookup table size {}\n".format(len(values)))
+    f.write("//Min {:.12f}\n".format(np.min(values)))
+    f.write("//Max {:.12f}\n".format(np.max(values)))
+    f.write("\n")
+
+    #c++ variable, const so that it is synthesized as a ROM
+    f.write("const table_default_t {}[{}] = {{".format(name, len(values)))
+    f.write(", ".join(format_values(name, values, precision)))
+    f.write("};\n")
+    f.close()
+
+#######################################
+## Check reuse factor of resource layers
+#######################################
+def check_resource_reuse(n_in, reuse_factor):
+
+    # nnet::compute_layer_resource folds the inputs of each output neuron
+    # into reuse_factor BRAM words, so reuse_factor has to divide n_in
+    if reuse_factor > n_in or n_in % reuse_factor != 0:
+        valid = [rf for rf in range(1, n_in+1) if n_in % rf == 0]
+        raise Exception('ERROR: Invalid ReuseFactor {} for Resource strategy with {} inputs, valid values are: {}'.format(reuse_factor, n_in, valid))
+
 #######################################
 ## Print a bias or weight array to C++
 #######################################
-def print_array_to_cpp(name, a, odir, i_part = 0, n_part = 1, i_subout = 0, n_subout = 1):
+def print_array_to_cpp(name, a, odir, i_part = 0, n_part = 1, i_subout = 0, n_subout = 1, type_name = None, precision = None, mem = False):
 
     #put output in subdir for tarballing later
     #check if we're doing sublayer
+    array_name = name
     if n_part > 1:
-        f=open("{}/firmware/weights/{}_{}.h".format(odir,name,i_part),"w")
+        array_name = "{}_{}".format(name,i_part)
         if len(a.shape)==2: # dense weight
             a = a[:,i_subout:i_subout+n_subout]
         elif len(a.shape)==1: # bias
             a = a[i_subout:i_subout+n_subout]
-    else:
-        f=open("{}/firmware/weights/{}.h".format(odir,name),"w")
+    f=open("{}/firmware/weights/{}.h".format(odir,array_name),"w")
 
     #count zeros
     zero_ctr = 0
@@ -942,27 +2012,32 @@ def print_array_to_cpp(name, a, odir, i_part = 0, n_part = 1, i_subout = 0, n_su
     f.write("//Min {:.12f}\n".format(np.min(a)))
     f.write("//Max {:.12f}\n".format(np.max(a)))
     f.write("//Number of zeros {}\n".format(zero_ctr))
+    if parse_fixed_type(precision) is not None:
+        f.write("//Values quantized to {}\n".format(precision))
     f.write("\n")
     
-    #c++ variable
-    if re.match(r"^w\d*$", name) or re.match(r"^a\d*$", name):
-        if n_part > 1:
-            f.write("weight_default_t {}_{}".format(name,i_part))
-        else:
-            f.write("weight_default_t {}".format(name))
-    elif re.match(r"^b\d*$", name):
-        if n_part > 1:
-            f.write("bias_default_t {}_{}".format(name,i_part))
+    #c++ variable, of the layer type if given (see get_layer_type)
+    if type_name is None:
+        if re.match(r"^w\d*$", name) or re.match(r"^a\d*$", name):
+            type_name = "weight_default_t"
+        elif re.match(r"^b\d*$", name):
+            type_name = "bias_default_t"
+        elif re.match(r"^scale\d*$", name):
+            type_name = "scale_default_t"
         else:
-            f.write("bias_default_t {}".format(name))
-    elif re.match(r"^beta\d*$", name):
-        f.write("beta_default_t {}".format(name))	
-    elif re.match(r"^mean\d*$", name):
-        f.write("mean_default_t {}".format(name))
-    elif re.match(r"^scale\d*$", name):
-        f.write("scale_default_t {}".format(name))
-    else:
-        raise Exception('ERROR: Unkown weights type')
+            raise Exception('ERROR: Unkown weights type')
+
+    #optionally, the C model reads the values from a $readmemh file at startup instead
+    #of compiling the initializer, which is only kept for synthesis (see nnet_weights.h)
+    mem = mem and quantize_array(a, precision) is not None
+    if mem:
+        print_mem_file(array_name, a, odir, precision)
+        width, int_bits, signed = parse_fixed_type(precision)[:3]
+        f.write("#if defined(NNET_WEIGHTS_MEM) && !defined(__SYNTHESIS__)\n")
+        f.write("{} {}[{}];\n".format(type_name, array_name, np.prod(a.shape)))
+        f.write("static const bool {}_loaded = nnet::load_weights_mem({}, {}, {}, {}, {}, \"{}.mem\");\n".format(array_name, array_name, np.prod(a.shape), width, width - int_bits, 'true' if signed else 'false', array_name))
+        f.write("#else\n")
+    f.write("{} {}".format(type_name,array_name))
 
     #hls doesn't like 3d arrays... unrolling to 1d
     #also doing for all (including 2d) arrays now
@@ -971,14 +2046,14 @@ def print_array_to_cpp(name, a, odir, i_part = 0, n_part = 1, i_subout = 0, n_su
     
     #fill c++ array.  
     #not including internal brackets for multidimensional case
-    i=0
-    for x in np.nditer(a, order='C'):
-        if i==0:
-            f.write("%.12f" % x)
-        else:
-            f.write(", %.12f" % x)
-        i=i+1
+    #(integer arrays, e.g. the bits of binary weights, as integers)
+    if np.issubdtype(a.dtype, np.integer):
+        f.write(", ".join(["%d" % x for x in np.nditer(a, order='C')]))
+    else:
+        f.write(", ".join(format_values(array_name, a, precision)))
     f.write("};\n")
+    if mem:
+        f.write("#endif\n")
     f.close()
 
     return zero_ctr
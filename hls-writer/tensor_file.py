@@ -0,0 +1,80 @@
+from __future__ import print_function
+import numpy as np
+import argparse
+import struct
+import sys
+
+#######################################
+## Binary tensor files, same format as
+## nnet_utils/nnet_tensor.h
+#######################################
+
+MAGIC = b'NNETTNSR'
+VERSION = 1
+ALIGNMENT = 64
+MAX_DIM = 8
+
+DTYPES = {1: np.float32, 2: np.float64, 3: np.int8, 4: np.int16, 5: np.int32, 6: np.int64}
+
+def header_size(ndim):
+    size = 8 + 4*4 + 8*ndim
+    return (size + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+
+def write_tensor_file(filename, a):
+
+    a = np.ascontiguousarray(a)
+    if a.ndim < 1 or a.ndim > MAX_DIM:
+        raise Exception('ERROR: Tensors need 1 to {} dimensions, got {}'.format(MAX_DIM, a.ndim))
+    codes = [code for code, dtype in DTYPES.items() if np.dtype(dtype) == a.dtype]
+    if not codes:
+        raise Exception('ERROR: Unsupported tensor type {}, use one of {}'.format(a.dtype, [np.dtype(t).name for t in DTYPES.values()]))
+
+    header = MAGIC + struct.pack('<4I', VERSION, codes[0], a.ndim, 0) + struct.pack('<{}Q'.format(a.ndim), *a.shape)
+    header += b'\0' * (header_size(a.ndim) - len(header))
+    with open(filename, 'wb') as f:
+        f.write(header)
+        f.write(a.astype(a.dtype.newbyteorder('<'), copy=False).tobytes())
+
+def read_tensor_file(filename):
+
+    # Memory mapped, like the C++ loader
+    with open(filename, 'rb') as f:
+        fixed = f.read(8 + 4*4)
+    if len(fixed) < 8 + 4*4 or fixed[:8] != MAGIC:
+        raise Exception('ERROR: {} is not a tensor file'.format(filename))
+    version, code, ndim, _ = struct.unpack('<4I', fixed[8:])
+    if version != VERSION or code not in DTYPES or ndim < 1 or ndim > MAX_DIM:
+        raise Exception('ERROR: Unsupported tensor file {} (version {}, type {}, {} dimensions)'.format(filename, version, code, ndim))
+    with open(filename, 'rb') as f:
+        f.seek(8 + 4*4)
+        shape = struct.unpack('<{}Q'.format(ndim), f.read(8*ndim))
+    return np.memmap(filename, dtype=np.dtype(DTYPES[code]).newbyteorder('<'), mode='r', offset=header_size(ndim), shape=shape)
+
+#######################################
+## Converter from text and numpy files
+#######################################
+def main():
+
+    parser = argparse.ArgumentParser(description='Convert test vectors to binary tensor files for nnet_utils/nnet_tensor.h')
+    parser.add_argument('input', help='Text file with one event per line, or .npy/.npz file with the events along the first axis')
+    parser.add_argument('output', help='Output tensor file')
+    parser.add_argument('-k', '--key', dest='key', default=None, help='Array to convert from a .npz file, defaults to the first one')
+    parser.add_argument('-s', '--shape', dest='shape', type=int, nargs='+', default=None, help='Shape of one event, e.g. 28 28 1. Defaults to the input shape')
+    parser.add_argument('-t', '--dtype', dest='dtype', default='float32', choices=[np.dtype(t).name for t in DTYPES.values()], help='Type of the stored values')
+    args = parser.parse_args()
+
+    if args.input.endswith('.npy'):
+        a = np.load(args.input)
+    elif args.input.endswith('.npz'):
+        npz = np.load(args.input)
+        a = npz[args.key if args.key else npz.files[0]]
+    else:
+        a = np.loadtxt(args.input, ndmin=2)
+
+    if args.shape:
+        a = a.reshape([a.shape[0]] + args.shape)
+    write_tensor_file(args.output, a.astype(args.dtype))
+    print('Wrote {} events of shape {} ({}) to {}'.format(a.shape[0], a.shape[1:], args.dtype, args.output))
+
+if __name__ == "__main__":
+    main()
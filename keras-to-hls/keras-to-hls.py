@@ -14,12 +14,20 @@ MAXMULT = 4096
 
 filedir = os.path.dirname(os.path.abspath(__file__))
 sys.path.insert(0,os.path.join(filedir, "..", "hls-writer"))
-from hls_writer import parse_config, print_array_to_cpp, hls_writer
+from hls_writer import parse_config, print_array_to_cpp, print_sparse_array_to_cpp, check_resource_reuse, get_layer_type, get_type_precision, get_layer_reuse, hls_writer
 
 def find_kernel_in_h5(name):
     if 'kernel' in name:
         return name
 
+def find_depthwise_kernel_in_h5(name):
+    if 'depthwise_kernel' in name:
+        return name
+
+def find_pointwise_kernel_in_h5(name):
+    if 'pointwise_kernel' in name:
+        return name
+
 def find_bias_in_h5(name):
     if 'bias' in name:
         return name
@@ -40,6 +48,130 @@ def find_gamma_in_h5(name):
     if 'gamma' in name:
         return name
 
+# Layers that join the outputs of two branches of a functional model, see nnet_merge.h
+merge_layers = ['Add', 'Subtract', 'Multiply', 'Average', 'Maximum', 'Minimum', 'Concatenate']
+
+def get_inbound_layers(keras_layer):
+
+    # Names of the layers whose outputs a layer of a functional model reads, None in a
+    # Sequential model, where each layer reads the previous one
+    if 'inbound_nodes' not in keras_layer:
+        return None
+    if len(keras_layer['inbound_nodes']) > 1:
+        raise Exception('ERROR: Layer {} is called {} times, shared layers are not supported'.format(keras_layer['config']['name'], len(keras_layer['inbound_nodes'])))
+    return [node[0] for node in keras_layer['inbound_nodes'][0]] if keras_layer['inbound_nodes'] else []
+
+def get_readers(layer_config):
+
+    # Names of the layers that read the output of each layer of a functional model
+    readers = {}
+    for keras_layer in layer_config:
+        for name in get_inbound_layers(keras_layer) or []:
+            readers.setdefault(name, []).append(keras_layer['config']['name'])
+    return readers
+
+def get_next_layers(layer_config, il):
+
+    # The layers after layer il, as long as each one is the only reader of the previous one,
+    # i.e. those that can be merged into it. All the following ones in a Sequential model
+    readers = get_readers(layer_config)
+    name = layer_config[il]['config']['name']
+    for keras_layer in layer_config[il+1:]:
+        inbound = get_inbound_layers(keras_layer)
+        if inbound is not None and (inbound != [name] or readers.get(name) != [keras_layer['config']['name']]):
+            return
+        yield keras_layer
+        name = keras_layer['config']['name']
+
+def set_output(outputs, name, index, shape, merged):
+
+    # The output of Keras layer name is computed by layer_list[index-1]. A layer merged into
+    # it replaces its output, which no other layer can read anymore
+    if merged:
+        for key, output in outputs.items():
+            if output and output[0] == index:
+                outputs[key] = None
+    outputs[name] = (index, shape)
+
+def next_batchnorm(layer_config, il, rank):
+
+    # BatchNormalization right after layer il over the last axis, the only one
+    # that can be folded. Dropout does nothing at inference and is skipped
+    for keras_layer in get_next_layers(layer_config, il):
+        if keras_layer['class_name'] == 'Dropout':
+            continue
+        if keras_layer['class_name'] != 'BatchNormalization':
+            return None
+        axis = keras_layer['config'].get('axis', -1)
+        if isinstance(axis, list) and len(axis) == 1:
+            axis = axis[0]
+        return keras_layer if axis in [-1, rank-1] else None
+    return None
+
+def get_batchnorm_scale_bias(h5File, keras_layer):
+
+    # (x - mean)*gamma/sqrt(var + epsilon) + beta as x*scale + bias, per channel
+    name = keras_layer['config']['name']
+    mean = h5File['/{}/{}'.format(name, h5File[name].visit(find_moving_mean_in_h5))][()]
+    var = h5File['/{}/{}'.format(name, h5File[name].visit(find_moving_variance_in_h5))][()]
+    found_gamma = h5File[name].visit(find_gamma_in_h5)
+    found_beta = h5File[name].visit(find_beta_in_h5)
+    gamma = h5File['/{}/{}'.format(name, found_gamma)][()] if found_gamma else np.ones_like(mean)
+    beta = h5File['/{}/{}'.format(name, found_beta)][()] if found_beta else np.zeros_like(mean)
+    scale = gamma/np.sqrt(var + keras_layer['config']['epsilon'])
+    return scale, beta - mean*scale
+
+def fold_batchnorm(h5File, keras_layer, weights, biases):
+
+    # (x*w + b)*scale + bias, per output channel, which is the last axis of the
+    # Dense, Conv1D and Conv2D weights
+    scale, bias = get_batchnorm_scale_bias(h5File, keras_layer)
+    return weights*scale, biases*scale + bias
+
+# Layers with binary or ternary weights, as (layer type they run as, weight quantization)
+quantized_layers = {'BinaryDense': ('Dense', 'binary'), 'TernaryDense': ('Dense', 'ternary'),
+                    'BinaryConv2D': ('Conv2D', 'binary'), 'TernaryConv2D': ('Conv2D', 'ternary')}
+
+def quantize_weights(weights, quantized, threshold):
+
+    # The latent float weights of training to the bits of nnet::binary_weight_t (1 for +1,
+    # 0 for -1), or to the -1, 0, +1 of nnet::ternary_weight_t beyond the threshold
+    if quantized == 'binary':
+        return np.where(weights >= 0, 1, 0)
+    return np.where(weights > threshold, 1, np.where(weights < -threshold, -1, 0))
+
+# Activations that never decrease, so that max pooling can be taken before them
+monotonic_activations = ['linear', 'relu', 'sigmoid', 'hard_sigmoid', 'tanh', 'softsign', 'softplus', 'elu', 'selu', 'binary_tanh', 'ternary_tanh', 'LeakyReLU', 'ThresholdedReLU', 'ELU']
+
+def get_keras_activation(keras_layer):
+
+    # Activation of a Keras activation layer as stored in layer['activation'], and its parameter
+    if keras_layer['class_name'] == 'Activation':
+        return keras_layer['config']['activation'], 0
+    elif keras_layer['class_name'] == 'ThresholdedReLU':
+        return keras_layer['class_name'], keras_layer['config'].get('theta', 1.)
+    elif keras_layer['class_name'] == 'LeakyReLU':
+        return keras_layer['class_name'], keras_layer['config'].get('alpha', 0.3)
+    return keras_layer['class_name'], keras_layer['config'].get('alpha', 1.)
+
+def can_fuse_conv_pool(layer_config, il, conv, pool, yamlConfig):
+
+    # nnet::conv_2d_pool takes the maximum of the conv outputs and the activation of the
+    # conv layer runs on the pooled outputs, which needs a non-decreasing activation
+    if yamlConfig['IOType'] == 'io_stream' or conv['class_name'] != 'Conv2D' or conv.get('quantized') or pool['class_name'] != 'MaxPooling2D':
+        return False
+    activations = [(conv.get('activation', 'linear'), conv.get('activ_param', 0))]
+    # An activation after the pooling is merged into the conv layer as well
+    for keras_layer in get_next_layers(layer_config, il):
+        if keras_layer['class_name'] == 'Dropout':
+            continue
+        if keras_layer['class_name'] in ['Activation', 'LeakyReLU', 'ThresholdedReLU', 'ELU', 'PReLU']:
+            if activations[0][0] != 'linear' or keras_layer['class_name'] == 'PReLU':
+                return False
+            activations.append(get_keras_activation(keras_layer))
+        break
+    return all(activation in monotonic_activations and param >= 0 for activation, param in activations)
+
 ############################################################################################
 ## M A I N
 ############################################################################################
@@ -60,10 +192,23 @@ def main():
         yamlConfig['KerasH5'] = os.path.join(configDir, yamlConfig['KerasH5'])
     if not os.path.isabs(yamlConfig['KerasJson']):
         yamlConfig['KerasJson'] = os.path.join(configDir, yamlConfig['KerasJson'])
+    if yamlConfig.get('FIFODepths') and not os.path.isabs(yamlConfig['FIFODepths']):
+        yamlConfig['FIFODepths'] = os.path.join(configDir, yamlConfig['FIFODepths'])
 
-    if not (yamlConfig["IOType"] == "io_parallel" or yamlConfig["IOType"] == "io_serial"): 
+    if not yamlConfig["IOType"] in ["io_parallel", "io_serial", "io_stream"]: 
         raise Exception('ERROR: Invalid IO type')
 
+    yamlConfig.setdefault('Strategy', 'Latency')
+    if not yamlConfig["Strategy"] in ["Latency", "Resource", "Sparse"]:
+        raise Exception('ERROR: Invalid strategy')
+    if yamlConfig["Strategy"] == "Sparse" and yamlConfig["IOType"] == "io_serial":
+        # nnet::compute_layer_sparse reads its inputs in the order of the nonzero weights
+        raise Exception('ERROR: The Sparse strategy is not supported with io_serial')
+
+    yamlConfig.setdefault('SoftmaxImplementation', 'stable')
+    if not yamlConfig["SoftmaxImplementation"].lower() in ["stable", "legacy"]:
+        raise Exception('ERROR: Invalid softmax implementation, options: stable/legacy')
+
     ######################
     ##  Do translation
     ######################
@@ -81,8 +226,10 @@ def main():
     #print(model_arch)
 
     #Define supported laers
-    supported_layers = ['InputLayer','Dropout', 'Flatten', 'Dense', 'Conv1D', 'Conv2D', 'BatchNormalization', 'MaxPooling1D', 'MaxPooling2D', 'AveragePooling1D', 'AveragePooling2D']
+    supported_layers = ['InputLayer','Dropout', 'Flatten', 'Dense', 'Conv1D', 'Conv2D', 'DepthwiseConv2D', 'SeparableConv2D', 'BatchNormalization', 'MaxPooling1D', 'MaxPooling2D', 'AveragePooling1D', 'AveragePooling2D', 'GlobalMaxPooling1D', 'GlobalMaxPooling2D', 'GlobalAveragePooling1D', 'GlobalAveragePooling2D'] + list(quantized_layers.keys()) + merge_layers
     activation_layers = ['Activation', 'LeakyReLU', 'ThresholdedReLU', 'ELU', 'PReLU']
+    conv2d_layers = ['Conv2D', 'DepthwiseConv2D', 'SeparableConv2D']
+    global_pooling_layers = ['GlobalMaxPooling1D', 'GlobalMaxPooling2D', 'GlobalAveragePooling1D', 'GlobalAveragePooling2D']
 
     #Define layers to skip for conversion to HLS
     skip_layers = ['InputLayer','Dropout', 'Flatten'] 
@@ -91,6 +238,13 @@ def main():
     layer_counter = 0
     input_layer = {}
 
+    #BatchNormalization layers folded into the previous layer
+    folded_batchnorms = []
+
+    #Functional models: (index in layer_list of the layer that computes it, 0 for the model
+    #input, shape) of the output of each Keras layer, None once a layer is merged into it
+    outputs = {}
+
     layer_config = None
     if model_arch['class_name'] == 'Sequential':
         print('Interpreting Sequential')
@@ -112,22 +266,45 @@ def main():
     is_conv2d = False
     is_dense = False
     for keras_layer in layer_config:
-     if keras_layer["class_name"]=='Conv2D':
+     class_name = quantized_layers.get(keras_layer["class_name"], (keras_layer["class_name"],))[0]
+     if class_name in conv2d_layers:
       is_conv2d = True
       break
-     if keras_layer["class_name"]=='Dense':
+     if class_name=='Dense':
       is_dense = True
       break
 	        
+    # Layers of functional models that read another layer than the previous one, see hls_writer
+    branch_layers = ['Dense', 'BatchNormalization', 'GlobalMaxPooling1D', 'GlobalMaxPooling2D', 'GlobalAveragePooling1D', 'GlobalAveragePooling2D'] + conv2d_layers + activation_layers + merge_layers
+    readers = get_readers(layer_config)
+    classes = dict((keras_layer['config']['name'], keras_layer['class_name']) for keras_layer in layer_config)
+    if model_arch['class_name'] == 'Model' and len(model_arch['config']['input_layers']) != 1:
+        raise Exception('ERROR: Models with {} inputs are not supported'.format(len(model_arch['config']['input_layers'])))
+
     print('Topology:')
     for il,keras_layer in enumerate(layer_config):
+        # Functional models: the input is the output of the inbound layer, not of the previous one
+        inbound = get_inbound_layers(keras_layer)
+        for name in inbound or []:
+            if outputs.get(name) is None:
+                raise Exception('ERROR: Layer {} reads the output of layer {}, which is merged into another layer'.format(keras_layer['config']['name'], name))
+        source = outputs[inbound[0]][0] if inbound else len(layer_list)
+        if inbound:
+            current_shape = outputs[inbound[0]][1]
         if 'batch_input_shape' in keras_layer['config']:
             current_shape = keras_layer['config']['batch_input_shape']
-        if keras_layer["class_name"] is 'Flatten':
-            current_shape = [current_shape[0], np.prod(current_shape[1:])]
+        if keras_layer["class_name"] == 'Flatten':
+            current_shape = [current_shape[0], int(np.prod(current_shape[1:]))]
         if keras_layer["class_name"] in skip_layers:
+            outputs[keras_layer['config']['name']] = (source, current_shape)
             continue 
 
+        # A layer can be merged into the previous one (activation, folded batch normalization,
+        # fused pooling) if it is the only reader of its output
+        folds = inbound is None or (len(inbound) == 1 and source == len(layer_list) and
+                                    [reader for name, output in outputs.items() if output and output[0] == source > 0
+                                     for reader in readers.get(name, []) if classes[reader] not in skip_layers] == [keras_layer['config']['name']])
+
         if keras_layer["class_name"] in supported_layers + activation_layers:
             layer_counter = layer_counter + 1
 
@@ -137,6 +314,16 @@ def main():
         #Extract name for finding weights and biases
         layer['name']=keras_layer['config']['name']
         layer['class_name']=keras_layer['class_name']
+        if keras_layer['class_name'] in quantized_layers:
+            # Binary and ternary layers run as Dense and Conv2D with the kernels of nnet_binary.h
+            layer['class_name'], layer['quantized'] = quantized_layers[keras_layer['class_name']]
+
+        if layer['name'] in folded_batchnorms:
+            print('Layer name: {}, layer type: {}, folded into {}'.format(layer['name'], layer['class_name'], layer_list[-1]['name']))
+            layer_list[-1]['output_name'] = layer['name']
+            layer_counter = layer_counter - 1
+            set_output(outputs, layer['name'], len(layer_list), current_shape, True)
+            continue
 
         #Extract type of activation and number of nodes
         for config,config_value in keras_layer["config"].items():
@@ -149,30 +336,60 @@ def main():
 
         
         #Translate weights and biases from h5 file
-        if layer['class_name'] != 'BatchNormalization' and layer['class_name'] not in activation_layers and 'Pooling' not in layer['class_name']:
-            found_weights = h5File[layer['name']].visit(find_kernel_in_h5)
+        if layer['class_name'] != 'BatchNormalization' and layer['class_name'] not in activation_layers and layer['class_name'] not in merge_layers and 'Pooling' not in layer['class_name']:
+            if layer['class_name'] == 'SeparableConv2D':
+                # The pointwise kernel gives the outputs, the depthwise kernel is printed below
+                found_depthwise = h5File[layer['name']].visit(find_depthwise_kernel_in_h5)
+                depthwise = h5File['/{}/{}'.format(layer['name'],found_depthwise)][()]
+                found_weights = h5File[layer['name']].visit(find_pointwise_kernel_in_h5)
+            else:
+                found_weights = h5File[layer['name']].visit(find_kernel_in_h5)
             weights = h5File['/{}/{}'.format(layer['name'],found_weights)][()]
+            if layer['class_name'] == 'DepthwiseConv2D':
+                depthwise = weights
+            if layer['class_name'] in ['DepthwiseConv2D', 'SeparableConv2D']:
+                # (filt_height, filt_width, n_chan, depth_multiplier) to the n_chan*depth_multiplier
+                # filters of nnet::depthwise_conv_2d, filter c*depth_multiplier+m of channel c
+                layer['n_chan'] = depthwise.shape[2]
+                layer['depth_multiplier'] = depthwise.shape[3]
+                depthwise = depthwise.reshape(depthwise.shape[0], depthwise.shape[1], -1)
+            if layer['class_name'] == 'DepthwiseConv2D':
+                weights = depthwise
             found_bias = h5File[layer['name']].visit(find_bias_in_h5)
-            biases = h5File['/{}/{}'.format(layer['name'],found_bias)][()]
-            cur_n_zeros = print_array_to_cpp("w{}".format(layer_counter), weights, yamlConfig['OutputDir'])
-            print_array_to_cpp("b{}".format(layer_counter), biases, yamlConfig['OutputDir'])
+            if found_bias:
+                biases = h5File['/{}/{}'.format(layer['name'],found_bias)][()]
+            else:
+                biases = np.zeros(weights.shape[-1]) # use_bias=False, usual before BatchNormalization
+            #Absorb a BatchNormalization that follows without activation in between
+            batchnorm = next_batchnorm(layer_config, il, 4 if layer['class_name'] in conv2d_layers else weights.ndim)
+            if batchnorm and yamlConfig.get('FoldBatchNorm', True) and layer.get('activation', 'linear') == 'linear' and not layer.get('quantized'):
+                weights, biases = fold_batchnorm(h5File, batchnorm, weights, biases)
+                folded_batchnorms.append(batchnorm['config']['name'])
+            if layer.get('quantized'):
+                # Same layout as the Latency strategy whatever the strategy, see nnet::compute_layer_binary
+                weights = quantize_weights(weights, layer['quantized'], keras_layer['config'].get('threshold', 0.5))
+                cur_n_zeros = print_array_to_cpp("w{}".format(layer_counter), weights, yamlConfig['OutputDir'], type_name=get_layer_type(yamlConfig, layer, layer_counter, 'weight'), precision=get_type_precision(yamlConfig, layer, 'weight'), mem=yamlConfig.get('WeightsMem', False))
+            elif layer['class_name'] == 'Dense' and yamlConfig['Strategy'] == 'Resource':
+                # Resource strategy reads the weights output-major, see nnet::compute_layer_resource
+                check_resource_reuse(weights.shape[0], get_layer_reuse(yamlConfig, layer))
+                cur_n_zeros = print_array_to_cpp("w{}".format(layer_counter), np.transpose(weights), yamlConfig['OutputDir'], type_name=get_layer_type(yamlConfig, layer, layer_counter, 'weight'), precision=get_type_precision(yamlConfig, layer, 'weight'), mem=yamlConfig.get('WeightsMem', False))
+            elif layer['class_name'] == 'Dense' and yamlConfig['Strategy'] == 'Sparse':
+                cur_n_zeros = print_sparse_array_to_cpp("w{}".format(layer_counter), weights, yamlConfig['OutputDir'], type_name='sparse_'+get_layer_type(yamlConfig, layer, layer_counter, 'weight'), precision=get_type_precision(yamlConfig, layer, 'weight'))
+            else:
+                cur_n_zeros = print_array_to_cpp("w{}".format(layer_counter), weights, yamlConfig['OutputDir'], type_name=get_layer_type(yamlConfig, layer, layer_counter, 'weight'), precision=get_type_precision(yamlConfig, layer, 'weight'), mem=yamlConfig.get('WeightsMem', False))
+            print_array_to_cpp("b{}".format(layer_counter), biases, yamlConfig['OutputDir'], type_name=get_layer_type(yamlConfig, layer, layer_counter, 'bias'), precision=get_type_precision(yamlConfig, layer, 'bias'), mem=yamlConfig.get('WeightsMem', False))
+            if layer['class_name'] == 'SeparableConv2D':
+                # Keras has no bias between the depthwise and the pointwise conv
+                print_array_to_cpp("dw{}".format(layer_counter), depthwise, yamlConfig['OutputDir'], type_name=get_layer_type(yamlConfig, layer, layer_counter, 'weight'), precision=get_type_precision(yamlConfig, layer, 'weight'), mem=yamlConfig.get('WeightsMem', False))
+                print_array_to_cpp("db{}".format(layer_counter), np.zeros(depthwise.shape[-1]), yamlConfig['OutputDir'], type_name=get_layer_type(yamlConfig, layer, layer_counter, 'bias'), precision=get_type_precision(yamlConfig, layer, 'bias'), mem=yamlConfig.get('WeightsMem', False))
             layer['weights_n_zeros'] = cur_n_zeros
         elif layer['class_name'] == 'BatchNormalization':
             cur_n_zeros = []
             layer['weights_n_zeros'] = cur_n_zeros 
-            found_beta = h5File[layer['name']].visit(find_beta_in_h5)
-            beta = h5File['/{}/{}'.format(layer['name'],found_beta)][()]
-            print_array_to_cpp("beta{}".format(layer_counter), beta, yamlConfig['OutputDir'])
-            found_mean = h5File[layer['name']].visit(find_moving_mean_in_h5)
-            mean = h5File['/{}/{}'.format(layer['name'],found_mean)][()]
-            print_array_to_cpp("mean{}".format(layer_counter), mean, yamlConfig['OutputDir'])
-            found_gamma = h5File[layer['name']].visit(find_gamma_in_h5)
-            gamma = h5File['/{}/{}'.format(layer['name'],found_gamma)][()]
-            found_var = h5File[layer['name']].visit(find_moving_variance_in_h5)
-            var = h5File['/{}/{}'.format(layer['name'],found_var)][()]
-            var = var + layer['epsilon']
-            scale = gamma/np.sqrt(var)
-            print_array_to_cpp("scale{}".format(layer_counter), scale, yamlConfig['OutputDir'])
+            # One multiply-add per input, see nnet_batchnorm.h
+            scale, biases = get_batchnorm_scale_bias(h5File, keras_layer)
+            print_array_to_cpp("scale{}".format(layer_counter), scale, yamlConfig['OutputDir'], type_name=get_layer_type(yamlConfig, layer, layer_counter, 'scale'), precision=get_type_precision(yamlConfig, layer, 'scale'), mem=yamlConfig.get('WeightsMem', False))
+            print_array_to_cpp("b{}".format(layer_counter), biases, yamlConfig['OutputDir'], type_name=get_layer_type(yamlConfig, layer, layer_counter, 'bias'), precision=get_type_precision(yamlConfig, layer, 'bias'), mem=yamlConfig.get('WeightsMem', False))
         
         # Skip activation layers if possible
         skip_layer = False
@@ -186,7 +403,10 @@ def main():
             # if this layer is too big (more than MAXMULT multiplications); 
             # break it out into chunks!
             layer['n_subout']=[weights.shape[1]]
-            if layer['n_in']*layer['n_out']>MAXMULT and yamlConfig["IOType"] != "io_serial":
+            # (not needed with the resource strategy, which keeps the weights in BRAM,
+            # nor with the sparse strategy, which only keeps the nonzero weights, nor for
+            # binary and ternary layers, which have no multiplications)
+            if layer['n_in']*layer['n_out']>MAXMULT and yamlConfig["IOType"] == "io_parallel" and yamlConfig["Strategy"] == "Latency" and not layer.get('quantized'):
                 n_subout = int(MAXMULT/layer['n_in'])
                 n_totout = 0
                 layer['n_subout'] = []
@@ -204,8 +424,8 @@ def main():
                     i_subout = 0
                     if i_part>0:
                         i_subout = sum(layer['n_subout'][0:i_part])
-                    cur_n_zeros = print_array_to_cpp("w{}".format(layer_counter), weights, yamlConfig['OutputDir'], i_part, layer['n_part'], i_subout, layer['n_subout'][i_part])
-                    print_array_to_cpp("b{}".format(layer_counter), biases, yamlConfig['OutputDir'], i_part, layer['n_part'], i_subout, layer['n_subout'][i_part])
+                    cur_n_zeros = print_array_to_cpp("w{}".format(layer_counter), weights, yamlConfig['OutputDir'], i_part, layer['n_part'], i_subout, layer['n_subout'][i_part], type_name=get_layer_type(yamlConfig, layer, layer_counter, 'weight'), precision=get_type_precision(yamlConfig, layer, 'weight'), mem=yamlConfig.get('WeightsMem', False))
+                    print_array_to_cpp("b{}".format(layer_counter), biases, yamlConfig['OutputDir'], i_part, layer['n_part'], i_subout, layer['n_subout'][i_part], type_name=get_layer_type(yamlConfig, layer, layer_counter, 'bias'), precision=get_type_precision(yamlConfig, layer, 'bias'), mem=yamlConfig.get('WeightsMem', False))
                     layer['weights_n_subzeros'].append(cur_n_zeros)
             
             current_shape = [current_shape[0], layer['n_out']]
@@ -232,13 +452,17 @@ def main():
                 layer['pad_left'] = 0
                 layer['pad_right'] = 0
             current_shape=[current_shape[0], layer['y_out'], layer['n_filt']]
-        elif layer['class_name']=='Conv2D':
+        elif layer['class_name'] in conv2d_layers:
+            # weights.shape = (filter_height, filter_width, n_channels, n_filters), the
+            # separable conv filters with the depthwise kernel and mixes with a 1x1 one
+            kernel = depthwise if layer['class_name'] == 'SeparableConv2D' else weights
             layer['in_height']=current_shape[1]
             layer['in_width']=current_shape[2]
-            layer['filt_height']=weights.shape[0]
-            layer['filt_width']=weights.shape[1]
-            layer['n_chan']=weights.shape[2]
-            layer['n_filt']=weights.shape[3]
+            layer['filt_height']=kernel.shape[0]
+            layer['filt_width']=kernel.shape[1]
+            if layer['class_name'] == 'Conv2D':
+                layer['n_chan']=weights.shape[2]
+            layer['n_filt']=weights.shape[-1]
             layer['stride_height']=keras_layer['config']['strides'][0]
             layer['stride_width']=keras_layer['config']['strides'][1]
             layer['padding']=keras_layer['config']['padding']
@@ -273,9 +497,9 @@ def main():
             current_shape=[current_shape[0], layer['out_height'], layer['out_width'], layer['n_filt']]
         elif layer['class_name']=='BatchNormalization':
             if is_dense:
-                layer['n_in']=mean.shape[0]
-                layer['n_out']=mean.shape[0]
-                layer['n_filt'] = -1
+                layer['n_in']=scale.shape[0]
+                layer['n_out']=scale.shape[0]
+                layer['n_filt']=scale.shape[0]
                 current_shape = [current_shape[0], layer['n_out']]
             elif is_conv2d:
                 layer['n_in']=current_shape[1]*current_shape[2]*current_shape[3] 
@@ -284,6 +508,15 @@ def main():
                 layer['in_width']=current_shape[2]
                 layer['n_filt']=current_shape[3]
                 current_shape=[current_shape[0], layer['in_height'], layer['in_width'], layer['n_filt']]
+        elif layer['class_name'] in global_pooling_layers:
+            if not layer_list:
+                raise Exception('ERROR: {} layer {} as the first layer is not supported'.format(layer['class_name'], layer['name']))
+            # One value per filter, pooled over all the pixels
+            layer['pool_op'] = 'Max' if 'Max' in layer['class_name'] else 'Average'
+            layer['n_in'] = int(np.prod(current_shape[1:-1]))
+            layer['n_filt'] = current_shape[-1]
+            layer['n_out'] = layer['n_filt']
+            current_shape = [current_shape[0], layer['n_out']]
         elif 'Pooling' in layer['class_name']:
             info = layer['class_name'].split('Pooling')
             d = int(info[1].split('D')[0])
@@ -331,14 +564,25 @@ def main():
                 layer['pad_right'] = 0
                 layer['n_out'] = layer['out_height'] * layer['out_height'] * layer['n_filt'] 
             current_shape=[current_shape[0], layer['out_height'], layer['out_width'], layer['n_filt']]
+            # Max pooling after a Conv2D runs inside the conv, the conv output is never stored
+            if d == 2 and folds and can_fuse_conv_pool(layer_config, il, layer_list[-1], layer, yamlConfig):
+                conv = layer_list[-1]
+                conv['pool'] = layer
+                conv['conv_out_height'] = conv['out_height']
+                conv['conv_out_width'] = conv['out_width']
+                conv['out_height'] = layer['out_height']
+                conv['out_width'] = layer['out_width']
+                print('Layer name: {}, layer type: {}, fused into {}'.format(layer['name'], layer['class_name'], conv['name']))
+                skip_layer = True
+                layer_counter = layer_counter - 1
 
         elif layer['class_name']=='Activation':
-            if layer_list[-1]['class_name'] != 'BatchNormalization':
+            if folds and layer_list[-1]['class_name'] != 'BatchNormalization':
                 layer_list[-1]['activation'] = layer['activation']
                 skip_layer = True
                 layer_counter = layer_counter - 1
         elif layer['class_name']=='LeakyReLU':
-            if layer_list[-1]['class_name'] != 'BatchNormalization':
+            if folds and layer_list[-1]['class_name'] != 'BatchNormalization':
                 layer_list[-1]['activation'] = layer['class_name']
                 layer_list[-1]['activ_param'] = keras_layer["config"].get('alpha', 0.3)
                 skip_layer = True
@@ -347,7 +591,7 @@ def main():
                 layer['activation'] = layer['class_name']
                 layer['activ_param'] = keras_layer["config"].get('alpha', 0.3)
         elif layer['class_name']=='ThresholdedReLU':
-            if layer_list[-1]['class_name'] != 'BatchNormalization':
+            if folds and layer_list[-1]['class_name'] != 'BatchNormalization':
                 layer_list[-1]['activation'] = layer['class_name']
                 layer_list[-1]['activ_param'] = keras_layer["config"].get('theta', 1.)
                 skip_layer = True
@@ -356,7 +600,7 @@ def main():
                 layer['activation'] = layer['class_name']
                 layer['activ_param'] = keras_layer["config"].get('theta', 1.)
         elif layer['class_name']=='ELU':
-            if layer_list[-1]['class_name'] != 'BatchNormalization':
+            if folds and layer_list[-1]['class_name'] != 'BatchNormalization':
                 layer_list[-1]['activation'] = layer['class_name']
                 layer_list[-1]['activ_param'] = keras_layer["config"].get('alpha', 1.)
                 skip_layer = True
@@ -365,7 +609,7 @@ def main():
                 layer['activation'] = layer['class_name']
                 layer['activ_param'] = keras_layer["config"].get('alpha', 1.)
         elif layer['class_name']=='PReLU':
-            if layer_list[-1]['class_name'] != 'BatchNormalization':
+            if folds and layer_list[-1]['class_name'] != 'BatchNormalization':
                 layer_list[-1]['activation'] = layer['class_name']
                 skip_layer = True
                 layer_counter = layer_counter - 1
@@ -374,13 +618,55 @@ def main():
             
             #Translate learned alpha array from h5 file
             weights = h5File['/{}/{}/alpha:0'.format(layer['name'],layer['name'])][()]
-            print_array_to_cpp("a{}".format(layer_counter), weights, yamlConfig['OutputDir'])
+            # Same type as the input of the activation, see alpha_types in hls_writer
+            print_array_to_cpp("a{}".format(layer_counter), weights, yamlConfig['OutputDir'], type_name="alpha{}_t".format(layer_counter))
+        elif layer['class_name'] in merge_layers:
+            if len(inbound) != 2:
+                raise Exception('ERROR: {} layer {} has {} inputs, only two are supported'.format(layer['class_name'], layer['name'], len(inbound)))
+            shapes = [[int(n) for n in outputs[name][1][1:]] for name in inbound]
+            out_shape = list(shapes[0])
+            if layer['class_name'] == 'Concatenate':
+                # Axis of the shape without the batch axis
+                axis = keras_layer['config'].get('axis', -1)
+                axis = axis - 1 if axis > 0 else axis + len(out_shape)
+                if axis < 0 or len(shapes[0]) != len(shapes[1]) or any(shapes[0][d] != shapes[1][d] for d in range(len(out_shape)) if d != axis):
+                    raise Exception('ERROR: Concatenate layer {} cannot join inputs of shapes {} and {} along axis {}'.format(layer['name'], shapes[0], shapes[1], keras_layer['config'].get('axis', -1)))
+                layer['axis'] = axis
+                out_shape[axis] += shapes[1][axis]
+            elif shapes[0] != shapes[1]:
+                raise Exception('ERROR: {} layer {} needs inputs of the same shape, got {} and {}'.format(layer['class_name'], layer['name'], shapes[0], shapes[1]))
+            layer['input_shapes'] = shapes
+            layer['n_out'] = int(np.prod(out_shape))
+            if len(out_shape) == 3:
+                layer['out_height'], layer['out_width'], layer['n_filt'] = out_shape
+            current_shape = [current_shape[0]] + out_shape
+
+        # Functional models: layers that read another layer than the previous one, and the merges
+        if inbound and not skip_layer and (layer['class_name'] in merge_layers or source != len(layer_list)):
+            if layer['class_name'] not in branch_layers or (layer['class_name'] == 'BatchNormalization' and not is_dense):
+                raise Exception('ERROR: {} layer {} reads the output of layer {}, which is not the previous layer: this is only supported for the {} layers'.format(layer['class_name'], layer['name'], inbound[0], ', '.join(branch_layers)))
+            if yamlConfig['IOType'] == 'io_serial':
+                raise Exception('ERROR: Layer {} starts or joins a branch of the model, which is not supported with io_serial'.format(layer['name']))
+            layer['inputs'] = [outputs[name][0] for name in inbound]
+            if layer['class_name'] in activation_layers:
+                layer['n_out'] = int(np.prod(current_shape[1:]))
 
         if not skip_layer:
             print('Layer name: {}, layer type: {}, current shape: {}, number of zeros: {}'.format(layer['name'], layer['class_name'], current_shape, cur_n_zeros))
             if layer['n_part'] > 1: 
                 print(' -> layer will be divided into {} sublayer calls; output neurons: {} '.format(layer['n_part'], layer['n_subout']))
             layer_list.append( layer )
+        else:
+            # The merged layer now computes the output of this one, see get_trace_name in hls_writer
+            layer_list[-1]['output_name'] = layer['name']
+        set_output(outputs, layer['name'], len(layer_list), current_shape, skip_layer)
+
+    if model_arch['class_name'] == 'Model':
+        output_layers = model_arch['config']['output_layers']
+        if len(output_layers) != 1:
+            raise Exception('ERROR: Models with {} outputs are not supported'.format(len(output_layers)))
+        if outputs[output_layers[0][0]] is None or outputs[output_layers[0][0]][0] != len(layer_list):
+            raise Exception('ERROR: The output layer {} needs to be the last layer of the model'.format(output_layers[0][0]))
 
 
     #################
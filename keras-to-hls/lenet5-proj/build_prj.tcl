@@ -2,10 +2,11 @@
 #    HLS4ML
 #################
 array set opt {
-  csim   1
-  synth  1
-  cosim  1
-  export 1
+  csim     1
+  synth    1
+  cosim    1
+  export   1
+  fastsim  0
 }
 
 foreach arg $::argv {
@@ -16,8 +17,14 @@ foreach arg $::argv {
 
 open_project -reset lenet5_prj
 set_top lenet5
-add_files firmware/lenet5.cpp -cflags "-I[file normalize ..\\..\\nnet_utils] -std=c++0x"
-add_files -tb lenet5_test.cpp -cflags "-I[file normalize ..\\..\\nnet_utils] -std=c++0x"
+# Native integer fixed point types for C simulation only, see nnet_utils/nnet_fixed.h
+set cflags "-I[file normalize ..\\..\\nnet_utils] -std=c++0x"
+if {$opt(fastsim)} {
+  append cflags " -DNNET_FAST_CSIM"
+  set opt(cosim) 0
+}
+add_files firmware/lenet5.cpp -cflags $cflags
+add_files -tb lenet5_test.cpp -cflags $cflags
 add_files -tb firmware/weights
 #add_files -tb tb_data
 open_solution -reset "solution1"
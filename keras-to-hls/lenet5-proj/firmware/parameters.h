@@ -10,6 +10,7 @@
 #include "nnet_common.h"
 #include "nnet_batchnorm.h"
 #include "nnet_pooling.h"
+#include "nnet_fixed.h"
 
 //hls-fpga-machine-learning insert numbers
 typedef ap_fixed<7,3> accum_default_t;
@@ -23,11 +23,23 @@
 #include <cmath>
 #include "ap_fixed.h"
 #include "nnet_common.h"
+#include "nnet_csim.h"
+#include "hls_stream.h"
 
 
 
 namespace nnet {
 
+// The lookup table activations (sigmoid, softmax, tanh, softplus, softsign, elu, selu)
+// come in two flavours: one taking its tables as const arrays, which are synthesized
+// as ROMs and can be shared between layers with the same table_t/table_size (hls_writer
+// emits them to firmware/weights/), and a standalone one that builds its own tables.
+
+// Softmax implementations:
+//   stable: max subtraction, n_in exponentials and a single reciprocal
+//   legacy: exponentials of all n_in^2 pairwise differences
+enum softmax_implementation {stable = 0, legacy};
+
 struct activ_config
 {
     // IO size
@@ -35,6 +47,7 @@ struct activ_config
 
     // Internal info
     static const unsigned table_size = 1024;
+    static const unsigned softmax_impl = stable;
 
     // Resource reuse info
     static const unsigned io_type = io_parallel;
@@ -134,21 +147,8 @@ void init_sigmoid_table(typename CONFIG_T::table_t table_out[N_TABLE])
 }
 
 template<class data_T, class res_T, typename CONFIG_T>
-void  sigmoid(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+void  sigmoid(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in], const typename CONFIG_T::table_t sigmoid_table[CONFIG_T::table_size])
 {
-    // Initialize the lookup table
-#ifdef __HLS_SYN__
-    bool initialized = false;
-    typename CONFIG_T::table_t sigmoid_table[CONFIG_T::table_size];
-#else
-    static bool initialized = false;
-    static typename CONFIG_T::table_t sigmoid_table[CONFIG_T::table_size];
-#endif
-    if (!initialized) {
-        init_sigmoid_table<CONFIG_T, CONFIG_T::table_size>(sigmoid_table);
-        initialized = true;
-    }
-
     if (CONFIG_T::io_type == io_parallel){
         #pragma HLS PIPELINE
     }
@@ -162,12 +162,33 @@ void  sigmoid(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
         }
         data_round = data[ii]*CONFIG_T::table_size/16;
         index = data_round + 8*CONFIG_T::table_size/16;
+        NNET_CHECK_CLIP(CONFIG_T, "table_index", index < 0 || index > CONFIG_T::table_size-1);
         if (index < 0)   index = 0;
         if (index > CONFIG_T::table_size-1) index = CONFIG_T::table_size-1;
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, sigmoid_table[index]);
         res[ii] = (res_T) sigmoid_table[index];
     }
 }
 
+template<class data_T, class res_T, typename CONFIG_T>
+void  sigmoid(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+{
+    // Initialize the lookup table
+#ifdef __HLS_SYN__
+    bool initialized = false;
+    typename CONFIG_T::table_t sigmoid_table[CONFIG_T::table_size];
+#else
+    static bool initialized = false;
+    static typename CONFIG_T::table_t sigmoid_table[CONFIG_T::table_size];
+#endif
+    if (!initialized) {
+        init_sigmoid_table<CONFIG_T, CONFIG_T::table_size>(sigmoid_table);
+        initialized = true;
+    }
+
+    sigmoid<data_T, res_T, CONFIG_T>(data, res, sigmoid_table);
+}
+
 // *************************************************
 //       Softmax Activation
 // *************************************************
@@ -204,24 +225,8 @@ void init_invert_table(typename CONFIG_T::table_t table_out[N_TABLE])
 }
 
 template<class data_T, class res_T, typename CONFIG_T>
-void  softmax(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+void  softmax_legacy(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in], const typename CONFIG_T::table_t exp_table[CONFIG_T::table_size], const typename CONFIG_T::table_t invert_table[CONFIG_T::table_size])
 {
-    // Initialize the lookup table
-#ifdef __HLS_SYN__
-    bool initialized = false;
-    typename CONFIG_T::table_t exp_table[CONFIG_T::table_size];
-    typename CONFIG_T::table_t invert_table[CONFIG_T::table_size];
-#else
-    static bool initialized = false;
-    static typename CONFIG_T::table_t exp_table[CONFIG_T::table_size];
-    static typename CONFIG_T::table_t invert_table[CONFIG_T::table_size];
-#endif
-    if (!initialized) {
-        init_exp_table<CONFIG_T, CONFIG_T::table_size>(exp_table);
-        init_invert_table<CONFIG_T, CONFIG_T::table_size>(invert_table);
-        initialized = true;
-    }
-
     if (CONFIG_T::io_type == io_parallel){
         // Note: This is going to be a resource hog to run with pipeline, but hey, whatever
         #pragma HLS PIPELINE
@@ -246,6 +251,7 @@ void  softmax(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
 	else {
 	  data_round = (data_cache[jj]-data_cache[ii])*CONFIG_T::table_size/16;
 	  index = data_round + 8*CONFIG_T::table_size/16;
+	  NNET_CHECK_CLIP(CONFIG_T, "table_index", index < 0 || index > CONFIG_T::table_size-1);
 	  if (index < 0)   index = 0;
 	  if (index > CONFIG_T::table_size-1) index = CONFIG_T::table_size-1;
 	  exp_diff_res = exp_table[index];
@@ -257,48 +263,188 @@ void  softmax(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
     //Second loop to invert
     for (int ii=0; ii<CONFIG_T::n_in; ii++) {
       int exp_res_index = exp_res[ii]*CONFIG_T::table_size/64;
+      NNET_CHECK_CLIP(CONFIG_T, "invert_index", exp_res_index < 0 || exp_res_index > CONFIG_T::table_size-1);
       if (exp_res_index < 0)   exp_res_index = 0;
       if (exp_res_index > CONFIG_T::table_size-1) exp_res_index = CONFIG_T::table_size-1;
       //typename CONFIG_T::table_t exp_res_invert = invert_table[exp_res_index];
+      NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, invert_table[exp_res_index]);
       res[ii] = (res_T) invert_table[exp_res_index];
     }
 
 }
 
-// *************************************************
-//       TanH Activation
-// *************************************************
+template<class data_T, class res_T, typename CONFIG_T>
+void  softmax_legacy(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+{
+    // Initialize the lookup table
+#ifdef __HLS_SYN__
+    bool initialized = false;
+    typename CONFIG_T::table_t exp_table[CONFIG_T::table_size];
+    typename CONFIG_T::table_t invert_table[CONFIG_T::table_size];
+#else
+    static bool initialized = false;
+    static typename CONFIG_T::table_t exp_table[CONFIG_T::table_size];
+    static typename CONFIG_T::table_t invert_table[CONFIG_T::table_size];
+#endif
+    if (!initialized) {
+        init_exp_table<CONFIG_T, CONFIG_T::table_size>(exp_table);
+        init_invert_table<CONFIG_T, CONFIG_T::table_size>(invert_table);
+        initialized = true;
+    }
+
+    softmax_legacy<data_T, res_T, CONFIG_T>(data, res, exp_table, invert_table);
+}
+
 template<typename CONFIG_T, int N_TABLE>
-void init_tanh_table(typename CONFIG_T::table_t table_out[N_TABLE])
+void init_exp_neg_table(typename CONFIG_T::table_t table_out[N_TABLE])
 {
-    // Implement tanh lookup
     for (int ii = 0; ii < N_TABLE; ii++) {
-        // First, convert from table index to X-value (signed 8-bit, range -4 to +4)
-        float in_val = 2*4.0*(ii-float(N_TABLE)/2.0)/float(N_TABLE);
+        // First, convert from table index to X-value (range -8 to 0)
+        float in_val = -8.0*ii/float(N_TABLE);
         // Next, compute lookup table function
-        typename CONFIG_T::table_t real_val = tanh(in_val);
-        //std::cout << "Tanh:  Lookup table Index: " <<  ii<< " In Value: " << in_val << " Result: " << real_val << std::endl;
+        typename CONFIG_T::table_t real_val = exp_fcn_float(in_val);
         table_out[ii] = real_val;
     }
 }
 
+template<typename CONFIG_T, int N_TABLE, int RANGE>
+void init_invert_sum_table(typename CONFIG_T::table_t table_out[N_TABLE])
+{
+    // Inversion function:
+    //   result = 1/x
+    // The sum of exponentials is at least 1, the entries below 1 are never read
+    // and hold 1 so that the table fits table_t like the others
+    for (int ii = 0; ii < N_TABLE; ii++) {
+        // First, convert from table index to X-value (range 0 to +RANGE)
+        float in_val = float(RANGE)*ii/float(N_TABLE);
+        // Next, compute lookup table function
+        if (in_val > 1.0) table_out[ii] = 1.0/in_val;
+        else table_out[ii] = 1.0;
+    }
+}
 
 template<class data_T, class res_T, typename CONFIG_T>
-void  tanh(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+void  softmax_stable(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in], const typename CONFIG_T::table_t exp_table[CONFIG_T::table_size], const typename CONFIG_T::table_t invert_table[CONFIG_T::table_size])
 {
+    // The sum of exponentials lies in [1, n_in], so the reciprocal table only
+    // needs to cover the next power of two above n_in
+    const int inv_range = pow2(ceillog2(CONFIG_T::n_in));
+
+    if (CONFIG_T::io_type == io_parallel){
+        #pragma HLS PIPELINE
+    }
+
+    typename CONFIG_T::table_t exp_res[CONFIG_T::n_in];
+    int data_round[CONFIG_T::n_in];
+
+    // Find the maximum, in table units to avoid overflowing data_T in the subtraction
+    int max_round = 0;
+    for (int ii=0; ii<CONFIG_T::n_in; ii++) {
+        if (CONFIG_T::io_type == io_serial){
+            #pragma HLS PIPELINE
+        }
+        data_round[ii] = data[ii]*CONFIG_T::table_size/8;
+        if (ii == 0 || data_round[ii] > max_round) max_round = data_round[ii];
+    }
+
+    // One lookup of exp(x - max) per input, all in (0, 1]
+    typename CONFIG_T::table_t exp_sum = 0;
+    for (int ii=0; ii<CONFIG_T::n_in; ii++) {
+        if (CONFIG_T::io_type == io_serial){
+            #pragma HLS PIPELINE
+        }
+        int index = max_round - data_round[ii];
+        NNET_CHECK_CLIP(CONFIG_T, "table_index", index > CONFIG_T::table_size-1);
+        if (index > CONFIG_T::table_size-1) index = CONFIG_T::table_size-1;
+        exp_res[ii] = exp_table[index];
+        exp_sum += exp_res[ii];
+    }
+
+    // Single reciprocal of the sum
+    int exp_sum_index = exp_sum*CONFIG_T::table_size/inv_range;
+    NNET_CHECK_CLIP(CONFIG_T, "invert_index", exp_sum_index > CONFIG_T::table_size-1);
+    if (exp_sum_index > CONFIG_T::table_size-1) exp_sum_index = CONFIG_T::table_size-1;
+    typename CONFIG_T::table_t inv_exp_sum = invert_table[exp_sum_index];
+
+    for (int ii=0; ii<CONFIG_T::n_in; ii++) {
+        if (CONFIG_T::io_type == io_serial){
+            #pragma HLS PIPELINE
+        }
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, (exp_res[ii] * inv_exp_sum));
+        res[ii] = (res_T) (exp_res[ii] * inv_exp_sum);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  softmax_stable(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+{
+    const int inv_range = pow2(ceillog2(CONFIG_T::n_in));
+
     // Initialize the lookup table
 #ifdef __HLS_SYN__
     bool initialized = false;
-    typename CONFIG_T::table_t tanh_table[CONFIG_T::table_size];
+    typename CONFIG_T::table_t exp_table[CONFIG_T::table_size];
+    typename CONFIG_T::table_t invert_table[CONFIG_T::table_size];
 #else
     static bool initialized = false;
-    static typename CONFIG_T::table_t tanh_table[CONFIG_T::table_size];
+    static typename CONFIG_T::table_t exp_table[CONFIG_T::table_size];
+    static typename CONFIG_T::table_t invert_table[CONFIG_T::table_size];
 #endif
     if (!initialized) {
-        init_tanh_table<CONFIG_T, CONFIG_T::table_size>(tanh_table);
+        init_exp_neg_table<CONFIG_T, CONFIG_T::table_size>(exp_table);
+        init_invert_sum_table<CONFIG_T, CONFIG_T::table_size, inv_range>(invert_table);
         initialized = true;
     }
 
+    softmax_stable<data_T, res_T, CONFIG_T>(data, res, exp_table, invert_table);
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  softmax(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in], const typename CONFIG_T::table_t exp_table[CONFIG_T::table_size], const typename CONFIG_T::table_t invert_table[CONFIG_T::table_size])
+{
+    #pragma HLS INLINE
+    // The tables have to match the implementation, see init_exp_neg_table/init_invert_sum_table
+    // for stable and init_exp_table/init_invert_table for legacy. hls_writer writes the tables
+    // of the SoftmaxImplementation it also sets softmax_impl to
+    if (CONFIG_T::softmax_impl == legacy) {
+        softmax_legacy<data_T, res_T, CONFIG_T>(data, res, exp_table, invert_table);
+    } else {
+        softmax_stable<data_T, res_T, CONFIG_T>(data, res, exp_table, invert_table);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  softmax(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+{
+    #pragma HLS INLINE
+    if (CONFIG_T::softmax_impl == legacy) {
+        softmax_legacy<data_T, res_T, CONFIG_T>(data, res);
+    } else {
+        softmax_stable<data_T, res_T, CONFIG_T>(data, res);
+    }
+}
+
+// *************************************************
+//       TanH Activation
+// *************************************************
+template<typename CONFIG_T, int N_TABLE>
+void init_tanh_table(typename CONFIG_T::table_t table_out[N_TABLE])
+{
+    // Implement tanh lookup
+    for (int ii = 0; ii < N_TABLE; ii++) {
+        // First, convert from table index to X-value (signed 8-bit, range -4 to +4)
+        float in_val = 2*4.0*(ii-float(N_TABLE)/2.0)/float(N_TABLE);
+        // Next, compute lookup table function
+        typename CONFIG_T::table_t real_val = tanh(in_val);
+        //std::cout << "Tanh:  Lookup table Index: " <<  ii<< " In Value: " << in_val << " Result: " << real_val << std::endl;
+        table_out[ii] = real_val;
+    }
+}
+
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  tanh(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in], const typename CONFIG_T::table_t tanh_table[CONFIG_T::table_size])
+{
     if (CONFIG_T::io_type == io_parallel){
         #pragma HLS PIPELINE
     }
@@ -313,12 +459,33 @@ void  tanh(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
         data_round = data[ii]*CONFIG_T::table_size/8;
         index = data_round + 4*CONFIG_T::table_size/8;
         //std::cout << "Input: "  << data[ii] << " Round: " << data_round << " Index: " << index << std::endl;
+        NNET_CHECK_CLIP(CONFIG_T, "table_index", index < 0 || index > CONFIG_T::table_size-1);
         if (index < 0)   index = 0;
         if (index > CONFIG_T::table_size-1) index = CONFIG_T::table_size-1;
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, tanh_table[index]);
         res[ii] = (res_T) tanh_table[index];
     }
 }
 
+template<class data_T, class res_T, typename CONFIG_T>
+void  tanh(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+{
+    // Initialize the lookup table
+#ifdef __HLS_SYN__
+    bool initialized = false;
+    typename CONFIG_T::table_t tanh_table[CONFIG_T::table_size];
+#else
+    static bool initialized = false;
+    static typename CONFIG_T::table_t tanh_table[CONFIG_T::table_size];
+#endif
+    if (!initialized) {
+        init_tanh_table<CONFIG_T, CONFIG_T::table_size>(tanh_table);
+        initialized = true;
+    }
+
+    tanh<data_T, res_T, CONFIG_T>(data, res, tanh_table);
+}
+
 // *************************************************
 //       Hard sigmoid Activation
 // *************************************************
@@ -408,21 +575,8 @@ void init_softplus_table(typename CONFIG_T::table_t table_out[N_TABLE])
 }
 
 template<class data_T, class res_T, typename CONFIG_T>
-void  softplus(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+void  softplus(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in], const typename CONFIG_T::table_t softplus_table[CONFIG_T::table_size])
 {
-    // Initialize the lookup table
-#ifdef __HLS_SYN__
-    bool initialized = false;
-    typename CONFIG_T::table_t softplus_table[CONFIG_T::table_size];
-#else
-    static bool initialized = false;
-    static typename CONFIG_T::table_t softplus_table[CONFIG_T::table_size];
-#endif
-    if (!initialized) {
-        init_softplus_table<CONFIG_T, CONFIG_T::table_size>(softplus_table);
-        initialized = true;
-    }
-
     if (CONFIG_T::io_type == io_parallel){
         #pragma HLS PIPELINE
     }
@@ -436,12 +590,33 @@ void  softplus(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
         }
         data_round = data[ii]*CONFIG_T::table_size/16;
         index = data_round + 8*CONFIG_T::table_size/16;
+        NNET_CHECK_CLIP(CONFIG_T, "table_index", index < 0 || index > CONFIG_T::table_size-1);
         if (index < 0)   index = 0;
         if (index > CONFIG_T::table_size-1) index = CONFIG_T::table_size-1;
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, softplus_table[index]);
         res[ii] = (res_T) softplus_table[index];
     }
 }
 
+template<class data_T, class res_T, typename CONFIG_T>
+void  softplus(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+{
+    // Initialize the lookup table
+#ifdef __HLS_SYN__
+    bool initialized = false;
+    typename CONFIG_T::table_t softplus_table[CONFIG_T::table_size];
+#else
+    static bool initialized = false;
+    static typename CONFIG_T::table_t softplus_table[CONFIG_T::table_size];
+#endif
+    if (!initialized) {
+        init_softplus_table<CONFIG_T, CONFIG_T::table_size>(softplus_table);
+        initialized = true;
+    }
+
+    softplus<data_T, res_T, CONFIG_T>(data, res, softplus_table);
+}
+
 // *************************************************
 //       Softsign Activation
 // *************************************************
@@ -465,21 +640,8 @@ void init_softsign_table(typename CONFIG_T::table_t table_out[N_TABLE])
 }
 
 template<class data_T, class res_T, typename CONFIG_T>
-void  softsign(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+void  softsign(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in], const typename CONFIG_T::table_t softsign_table[CONFIG_T::table_size])
 {
-    // Initialize the lookup table
-#ifdef __HLS_SYN__
-    bool initialized = false;
-    typename CONFIG_T::table_t softsign_table[CONFIG_T::table_size];
-#else
-    static bool initialized = false;
-    static typename CONFIG_T::table_t softsign_table[CONFIG_T::table_size];
-#endif
-    if (!initialized) {
-        init_softsign_table<CONFIG_T, CONFIG_T::table_size>(softsign_table);
-        initialized = true;
-    }
-
     if (CONFIG_T::io_type == io_parallel){
         #pragma HLS PIPELINE
     }
@@ -493,12 +655,33 @@ void  softsign(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
         }
         data_round = data[ii]*CONFIG_T::table_size/16;
         index = data_round + 8*CONFIG_T::table_size/16;
+        NNET_CHECK_CLIP(CONFIG_T, "table_index", index < 0 || index > CONFIG_T::table_size-1);
         if (index < 0)   index = 0;
         if (index > CONFIG_T::table_size-1) index = CONFIG_T::table_size-1;
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, softsign_table[index]);
         res[ii] = (res_T) softsign_table[index];
     }
 }
 
+template<class data_T, class res_T, typename CONFIG_T>
+void  softsign(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+{
+    // Initialize the lookup table
+#ifdef __HLS_SYN__
+    bool initialized = false;
+    typename CONFIG_T::table_t softsign_table[CONFIG_T::table_size];
+#else
+    static bool initialized = false;
+    static typename CONFIG_T::table_t softsign_table[CONFIG_T::table_size];
+#endif
+    if (!initialized) {
+        init_softsign_table<CONFIG_T, CONFIG_T::table_size>(softsign_table);
+        initialized = true;
+    }
+
+    softsign<data_T, res_T, CONFIG_T>(data, res, softsign_table);
+}
+
 // *************************************************
 //       ELU Activation
 // *************************************************
@@ -522,21 +705,8 @@ void init_elu_table(typename CONFIG_T::table_t table_out[N_TABLE])
 }
 
 template<class data_T, class res_T, typename CONFIG_T>
-void  elu(data_T data[CONFIG_T::n_in], const res_T alpha, res_T res[CONFIG_T::n_in])
+void  elu(data_T data[CONFIG_T::n_in], const res_T alpha, res_T res[CONFIG_T::n_in], const typename CONFIG_T::table_t elu_table[CONFIG_T::table_size])
 {
-    // Initialize the lookup table
-#ifdef __HLS_SYN__
-    bool initialized = false;
-    typename CONFIG_T::table_t elu_table[CONFIG_T::table_size];
-#else
-    static bool initialized = false;
-    static typename CONFIG_T::table_t elu_table[CONFIG_T::table_size];
-#endif
-    if (!initialized) {
-        init_elu_table<CONFIG_T, CONFIG_T::table_size>(elu_table);
-        initialized = true;
-    }
-
     if (CONFIG_T::io_type == io_parallel){
         #pragma HLS PIPELINE
     }
@@ -553,12 +723,32 @@ void  elu(data_T data[CONFIG_T::n_in], const res_T alpha, res_T res[CONFIG_T::n_
             res[ii] = datareg;
         } else {
             index = datareg*CONFIG_T::table_size/-8;
+            NNET_CHECK_CLIP(CONFIG_T, "table_index", index > CONFIG_T::table_size-1);
             if (index > CONFIG_T::table_size-1) index = CONFIG_T::table_size-1;
             res[ii] = alpha * elu_table[index];
         }
     }
 }
 
+template<class data_T, class res_T, typename CONFIG_T>
+void  elu(data_T data[CONFIG_T::n_in], const res_T alpha, res_T res[CONFIG_T::n_in])
+{
+    // Initialize the lookup table
+#ifdef __HLS_SYN__
+    bool initialized = false;
+    typename CONFIG_T::table_t elu_table[CONFIG_T::table_size];
+#else
+    static bool initialized = false;
+    static typename CONFIG_T::table_t elu_table[CONFIG_T::table_size];
+#endif
+    if (!initialized) {
+        init_elu_table<CONFIG_T, CONFIG_T::table_size>(elu_table);
+        initialized = true;
+    }
+
+    elu<data_T, res_T, CONFIG_T>(data, alpha, res, elu_table);
+}
+
 template<class data_T, class res_T, typename CONFIG_T>
 void  elu(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
 {
@@ -587,6 +777,32 @@ void init_selu_table(typename CONFIG_T::table_t table_out[N_TABLE])
     }
 }
 
+template<class data_T, class res_T, typename CONFIG_T>
+void  selu(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in], const typename CONFIG_T::table_t selu_table[CONFIG_T::table_size])
+{
+    if (CONFIG_T::io_type == io_parallel){
+        #pragma HLS PIPELINE
+    }
+
+    data_T datareg;
+    // Index into the lookup table based on data
+    int index;
+    for (int ii=0; ii<CONFIG_T::n_in; ii++) {
+        if (CONFIG_T::io_type == io_serial){
+            #pragma HLS PIPELINE
+        }
+        datareg = data[ii];
+        if (datareg >= 0) {
+            res[ii] = res_T(1.0507009873554804934193349852946) * datareg;
+        } else {
+            index = datareg*CONFIG_T::table_size/-8;
+            NNET_CHECK_CLIP(CONFIG_T, "table_index", index > CONFIG_T::table_size-1);
+            if (index > CONFIG_T::table_size-1) index = CONFIG_T::table_size-1;
+            res[ii] = selu_table[index];
+        }
+    }
+}
+
 template<class data_T, class res_T, typename CONFIG_T>
 void  selu(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
 {
@@ -603,46 +819,263 @@ void  selu(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
         initialized = true;
     }
 
+    selu<data_T, res_T, CONFIG_T>(data, res, selu_table);
+}
+
+// *************************************************
+//       PReLU Activation
+// *************************************************
+template<class data_T, class res_T, typename CONFIG_T>
+void  prelu(data_T data[CONFIG_T::n_in], data_T alpha[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+{
     if (CONFIG_T::io_type == io_parallel){
         #pragma HLS PIPELINE
     }
 
     data_T datareg;
-    // Index into the lookup table based on data
-    int index;
     for (int ii=0; ii<CONFIG_T::n_in; ii++) {
         if (CONFIG_T::io_type == io_serial){
             #pragma HLS PIPELINE
         }
         datareg = data[ii];
-        if (datareg >= 0) {
-            res[ii] = res_T(1.0507009873554804934193349852946) * datareg;
-        } else {
-            index = datareg*CONFIG_T::table_size/-8;
-            if (index > CONFIG_T::table_size-1) index = CONFIG_T::table_size-1;
-            res[ii] = selu_table[index];
-        }
+        if (datareg > 0) res[ii] = datareg;
+        else res[ii] = alpha[ii] * datareg;
     }
 }
 
 // *************************************************
-//       PReLU Activation
+//       Binary and ternary tanh Activations
 // *************************************************
+// Sign of the input, +1 for zero: the +1/-1 inputs of the XNOR products in nnet_binary.h
 template<class data_T, class res_T, typename CONFIG_T>
-void  prelu(data_T data[CONFIG_T::n_in], data_T alpha[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+void  binary_tanh(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
+{
+    if (CONFIG_T::io_type == io_parallel){
+        #pragma HLS PIPELINE
+    }
+
+    for (int ii=0; ii<CONFIG_T::n_in; ii++) {
+        if (CONFIG_T::io_type == io_serial){
+            #pragma HLS PIPELINE
+        }
+        if (data[ii] >= 0) res[ii] = 1;
+        else res[ii] = -1;
+    }
+}
+
+// -1, 0 or +1, with the thresholds at -0.5 and +0.5
+template<class data_T, class res_T, typename CONFIG_T>
+void  ternary_tanh(data_T data[CONFIG_T::n_in], res_T res[CONFIG_T::n_in])
 {
     if (CONFIG_T::io_type == io_parallel){
         #pragma HLS PIPELINE
     }
 
     data_T datareg;
+    // Rounds to 0 for integer inputs, where x > 0.5 is x > 0
+    data_T half = 0.5;
     for (int ii=0; ii<CONFIG_T::n_in; ii++) {
         if (CONFIG_T::io_type == io_serial){
             #pragma HLS PIPELINE
         }
         datareg = data[ii];
-        if (datareg > 0) res[ii] = datareg;
-        else res[ii] = alpha[ii] * datareg;
+        if (datareg > half) res[ii] = 1;
+        else if (-datareg > half) res[ii] = -1;
+        else res[ii] = 0;
+    }
+}
+
+// *************************************************
+//       io_stream versions
+// *************************************************
+// Each stream word (all the values of a dense layer, or all the channels of one
+// pixel) goes through the array version, so the activations of a conv layer are
+// computed per pixel. In particular softmax normalizes over the channels of each
+// pixel, like Keras does, rather than over the whole image.
+template<typename CONFIG_T, unsigned N>
+struct activ_word_config : CONFIG_T
+{
+    static const unsigned n_in = N;
+};
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  linear(hls::stream<data_T> &data, hls::stream<res_T> &res)
+{
+    LinearWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        linear<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, out_word.data);
+        res.write(out_word);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  relu(hls::stream<data_T> &data, hls::stream<res_T> &res)
+{
+    ReLUWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        relu<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, out_word.data);
+        res.write(out_word);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  sigmoid(hls::stream<data_T> &data, hls::stream<res_T> &res, const typename CONFIG_T::table_t sigmoid_table[CONFIG_T::table_size])
+{
+    SigmoidWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        sigmoid<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, out_word.data, sigmoid_table);
+        res.write(out_word);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  softmax(hls::stream<data_T> &data, hls::stream<res_T> &res, const typename CONFIG_T::table_t exp_table[CONFIG_T::table_size], const typename CONFIG_T::table_t invert_table[CONFIG_T::table_size])
+{
+    SoftmaxWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        softmax<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, out_word.data, exp_table, invert_table);
+        res.write(out_word);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  tanh(hls::stream<data_T> &data, hls::stream<res_T> &res, const typename CONFIG_T::table_t tanh_table[CONFIG_T::table_size])
+{
+    TanHWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        tanh<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, out_word.data, tanh_table);
+        res.write(out_word);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  hard_sigmoid(hls::stream<data_T> &data, hls::stream<res_T> &res)
+{
+    HardSigmoidWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        hard_sigmoid<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, out_word.data);
+        res.write(out_word);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  leaky_relu(hls::stream<data_T> &data, typename data_T::value_type alpha, hls::stream<res_T> &res)
+{
+    LeakyReLUWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        leaky_relu<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, alpha, out_word.data);
+        res.write(out_word);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  thresholded_relu(hls::stream<data_T> &data, typename data_T::value_type theta, hls::stream<res_T> &res)
+{
+    ThresholdedReLUWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        thresholded_relu<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, theta, out_word.data);
+        res.write(out_word);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  softplus(hls::stream<data_T> &data, hls::stream<res_T> &res, const typename CONFIG_T::table_t softplus_table[CONFIG_T::table_size])
+{
+    SoftplusWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        softplus<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, out_word.data, softplus_table);
+        res.write(out_word);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  softsign(hls::stream<data_T> &data, hls::stream<res_T> &res, const typename CONFIG_T::table_t softsign_table[CONFIG_T::table_size])
+{
+    SoftsignWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        softsign<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, out_word.data, softsign_table);
+        res.write(out_word);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  elu(hls::stream<data_T> &data, const typename res_T::value_type alpha, hls::stream<res_T> &res, const typename CONFIG_T::table_t elu_table[CONFIG_T::table_size])
+{
+    ELUWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        elu<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, alpha, out_word.data, elu_table);
+        res.write(out_word);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  selu(hls::stream<data_T> &data, hls::stream<res_T> &res, const typename CONFIG_T::table_t selu_table[CONFIG_T::table_size])
+{
+    SELUWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        selu<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, out_word.data, selu_table);
+        res.write(out_word);
+    }
+}
+
+// alpha holds all n_in values, each word uses its own slice
+template<class data_T, class res_T, typename CONFIG_T>
+void  prelu(hls::stream<data_T> &data, typename data_T::value_type alpha[CONFIG_T::n_in], hls::stream<res_T> &res)
+{
+    PReLUWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        prelu<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, alpha + i * data_T::size, out_word.data);
+        res.write(out_word);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  binary_tanh(hls::stream<data_T> &data, hls::stream<res_T> &res)
+{
+    BinaryTanhWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        binary_tanh<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, out_word.data);
+        res.write(out_word);
+    }
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void  ternary_tanh(hls::stream<data_T> &data, hls::stream<res_T> &res)
+{
+    TernaryTanhWord: for (unsigned i = 0; i < CONFIG_T::n_in / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T in_word = data.read();
+        res_T out_word;
+        ternary_tanh<typename data_T::value_type, typename res_T::value_type, activ_word_config<CONFIG_T, data_T::size> >(in_word.data, out_word.data);
+        res.write(out_word);
     }
 }
 
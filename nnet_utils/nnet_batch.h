@@ -0,0 +1,95 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef NNET_BATCH_H_
+#define NNET_BATCH_H_
+
+// Host side only: runs the C model of a network over many events in parallel
+
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include "nnet_helpers.h"
+
+namespace nnet {
+
+struct batch_stats
+{
+    unsigned n_events;
+    unsigned n_threads;
+    double seconds;
+    double events_per_second;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const batch_stats &stats)
+{
+    return os << stats.n_events << " events on " << stats.n_threads << " threads in "
+              << stats.seconds << " s (" << stats.events_per_second << " events/s)";
+}
+
+// Calls top(data + i*n_in, res + i*n_out) for each of the n_events events, with the
+// events split into contiguous shards over n_threads worker threads (0 uses one per
+// hardware thread). The top function must not keep state between calls. That is the
+// case for the generated projects. The first event runs on its own beforehand, so that
+// the static lookup tables of the standalone activations are initialized only once.
+// With -DNNET_TRACE the layer outputs are recorded by event index, see nnet_trace.h.
+template<class data_T, class res_T, unsigned n_in, unsigned n_out, class top_T>
+batch_stats run_batch(top_T top, data_T *data, res_T *res, unsigned n_events, unsigned n_threads = 0)
+{
+    if (n_threads == 0) n_threads = std::thread::hardware_concurrency();
+    if (n_threads == 0) n_threads = 1;
+    if (n_events > 1 && n_threads > n_events - 1) n_threads = n_events - 1;
+    if (n_events <= 1) n_threads = 1;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if (n_events > 0) {
+        NNET_TRACE_EVENT(0);
+        top(data, res);
+    }
+
+    std::vector<std::thread> workers;
+    unsigned shard = (n_events - 1 + n_threads - 1) / n_threads;
+    for (unsigned first = 1; first < n_events; first += shard) {
+        unsigned last = first + shard < n_events ? first + shard : n_events;
+        workers.push_back(std::thread([=]() {
+            for (unsigned i = first; i < last; i++) {
+                NNET_TRACE_EVENT(i);
+                top(data + i * n_in, res + i * n_out);
+            }
+        }));
+    }
+    for (unsigned i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    batch_stats stats;
+    stats.n_events = n_events;
+    stats.n_threads = n_threads;
+    stats.seconds = elapsed.count();
+    stats.events_per_second = stats.seconds > 0 ? n_events / stats.seconds : 0;
+    return stats;
+}
+
+}
+
+#endif
@@ -21,6 +21,8 @@
 #define NNET_BATCHNORM_H_
 
 #include "nnet_common.h"
+#include "nnet_csim.h"
+#include "nnet_stream.h"
 #include "hls_stream.h"
 #include <math.h>
 
@@ -29,13 +31,13 @@ namespace nnet {
 struct batchnorm_config
 {
     // Internal data type definitions
-    typedef float beta_t;
+    typedef float bias_t;
     typedef float scale_t;
-    typedef float mean_t;
 
     // Layer Sizes
     static const unsigned n_in = 10;
-    static const unsigned n_filt = -1;
+    // Channels, with one scale and bias each: n_in for the inputs of dense layers
+    static const unsigned n_filt = 10;
     
     // Resource reuse info
     static const unsigned io_type = io_parallel;
@@ -45,18 +47,21 @@ struct batchnorm_config
     // partitioning arrays cyclically to go with roll factors?
 };
 
+// res = data * scale + bias with the scale and bias of the channel of each input. The
+// converter folds the mean and variance in: scale = gamma / sqrt(var + epsilon) and
+// bias = beta - mean * scale. Conv outputs of io_parallel designs are channel major,
+// so each channel is n_in / n_filt consecutive inputs.
 template<class data_T, class res_T, typename CONFIG_T>
 void normalize(
     data_T    data[CONFIG_T::n_in],
     res_T     res[CONFIG_T::n_in],
-    typename CONFIG_T::scale_t  scale[CONFIG_T::n_in],
-    typename CONFIG_T::beta_t   beta[CONFIG_T::n_in],
-    typename CONFIG_T::mean_t   mean[CONFIG_T::n_in])
+    typename CONFIG_T::scale_t  scale[CONFIG_T::n_filt],
+    typename CONFIG_T::bias_t   bias[CONFIG_T::n_filt])
 {
-    data_T cache;
-   
+    const unsigned n_pixels = CONFIG_T::n_in / CONFIG_T::n_filt;
+
     // Use a function_instantiate in case it helps to explicitly optimize unchanging weights/biases
-    #pragma HLS function_instantiate variable=scale,beta,mean
+    #pragma HLS function_instantiate variable=scale,bias
 
     if (CONFIG_T::io_type == io_parallel){
         // For parallel inputs:
@@ -64,34 +69,60 @@ void normalize(
         //   - if we have an unroll factor, limit number of multipliers
         #pragma HLS PIPELINE II=CONFIG_T::reuse_factor
 
-        // #pragma HLS ARRAY_PARTITION variable=weights complete // remove this line for now, it breaks compression sometimes
-	#pragma HLS ARRAY_PARTITION variable=scale complete
-        #pragma HLS ARRAY_PARTITION variable=beta complete
-	#pragma HLS ARRAY_PARTITION variable=mean complete
+        #pragma HLS ARRAY_PARTITION variable=scale complete
+        #pragma HLS ARRAY_PARTITION variable=bias complete
 
-        int multiplier_limit  = ceil(float(CONFIG_T::n_in*CONFIG_T::n_in) / float(CONFIG_T::reuse_factor));
+        // One multiply-add per input
+        const int multiplier_limit = (CONFIG_T::n_in + CONFIG_T::reuse_factor - 1) / CONFIG_T::reuse_factor;
         #pragma HLS ALLOCATION instances=mul limit=multiplier_limit operation
 
     } else if (CONFIG_T::io_type == io_serial){
         #pragma HLS ARRAY_RESHAPE variable=scale complete dim=1
-        #pragma HLS ARRAY_RESHAPE variable=beta complete dim=1
-        #pragma HLS ARRAY_RESHAPE variable=mean complete dim=1
+        #pragma HLS ARRAY_RESHAPE variable=bias complete dim=1
         #pragma HLS DATAFLOW
-    }            
+    }
 
     // Calcuate result
-    Result: for(int ires = 0; ires < CONFIG_T::n_in; ires++){
-        if (CONFIG_T::io_type == io_serial){
+    NormFilt: for(unsigned ff = 0; ff < CONFIG_T::n_filt; ff++){
+        NormPixel: for(unsigned ii = 0; ii < n_pixels; ii++){
+            if (CONFIG_T::io_type == io_serial){
+                #pragma HLS PIPELINE
+            }
+            unsigned index = ff * n_pixels + ii;
+            NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, (double) data[index] * (double) scale[ff] + (double) bias[ff]);
+            res[index] = (res_T) (data[index] * scale[ff] + bias[ff]);
+        }
+    }
+}
+
+// io_stream version, one stream word at a time. Conv inputs come as one pixel per
+// word and dense inputs as a single word, so the channel of a value is its position
+// in the word.
+template<class data_T, class res_T, typename CONFIG_T>
+void normalize(
+    hls::stream<data_T> &data,
+    hls::stream<res_T>  &res,
+    typename CONFIG_T::scale_t  scale[CONFIG_T::n_filt],
+    typename CONFIG_T::bias_t   bias[CONFIG_T::n_filt])
+{
+    #pragma HLS ARRAY_PARTITION variable=scale complete
+    #pragma HLS ARRAY_PARTITION variable=bias complete
+
+    // One multiply-add per value of a word
+    const int multiplier_limit = (CONFIG_T::n_filt + CONFIG_T::reuse_factor - 1) / CONFIG_T::reuse_factor;
+    #pragma HLS ALLOCATION instances=mul limit=multiplier_limit operation
+
+    NormWord: for (unsigned i = 0; i < CONFIG_T::n_in / CONFIG_T::n_filt; i++) {
+        #pragma HLS PIPELINE II=CONFIG_T::reuse_factor
+        data_T in_word = data.read();
+        res_T out_word;
+        NormFilt: for (unsigned ff = 0; ff < CONFIG_T::n_filt; ff++) {
             #pragma HLS UNROLL
-            #pragma HLS PIPELINE
+            NNET_CHECK_OVERFLOW(CONFIG_T, "result", typename res_T::value_type, (double) in_word[ff] * (double) scale[ff] + (double) bias[ff]);
+            out_word[ff] = (typename res_T::value_type) (in_word[ff] * scale[ff] + bias[ff]);
         }
-        if(CONFIG_T::n_filt==-1) res[ires] = (res_T) (data[ires]-mean[ires])*scale[ires]+beta[ires];
-	else{
-	 int norm_index = ires%CONFIG_T::n_filt;
-	 res[ires] = (res_T) (data[ires]-mean[norm_index])*scale[norm_index]+beta[norm_index];
-	}
-    }   
-       
+        res.write(out_word);
+    }
 }
 
 }
@@ -0,0 +1,307 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef NNET_BINARY_H_
+#define NNET_BINARY_H_
+
+// Dense and conv2d layers with binary (+1/-1) or ternary (-1/0/+1) weights, which
+// need no multiplier: a product is the input or its negation. When the inputs are
+// +1/-1 too (the outputs of a binary_tanh activation), a product is the XNOR of the
+// sign bits of the input and the weight, and the dot product is the number of
+// matching bits minus the number of different ones, summed as a popcount on
+// ceillog2(n)+2 bits instead of in the accumulator type.
+
+#include "ap_int.h"
+#include "hls_stream.h"
+#include "nnet_common.h"
+#include "nnet_csim.h"
+#include "nnet_layer.h"
+#include "nnet_conv2d.h"
+#include "nnet_stream.h"
+
+namespace nnet {
+
+// One bit per binary weight, 1 for +1 and 0 for -1
+typedef ap_uint<1> binary_weight_t;
+// Two bits per ternary weight
+typedef ap_int<2> ternary_weight_t;
+
+struct binary_layer_config : layer_config
+{
+    typedef binary_weight_t weight_t;
+    // Inputs are +1/-1, the products become XNORs
+    static const bool binary_input = false;
+};
+
+struct binary_conv2d_config : conv2d_config
+{
+    typedef binary_weight_t weight_t;
+    // Inputs are +1/-1, the products become XNORs
+    static const bool binary_input = false;
+};
+
+// Type of the products and of their sum: a popcount for +1/-1 inputs
+template<class accum_T, unsigned N, bool binary_input>
+struct binary_sum
+{
+    typedef accum_T type;
+};
+
+template<class accum_T, unsigned N>
+struct binary_sum<accum_T, N, true>
+{
+    typedef ap_int<ceillog2(N) + 2> type;
+};
+
+// Sign bit of a +1/-1 input, 1 for +1 like the weights
+template<class data_T>
+inline ap_uint<1> binary_sign(data_T x)
+{
+    return x >= 0 ? 1 : 0;
+}
+
+inline ap_int<2> binary_xnor(ap_uint<1> x, binary_weight_t w)
+{
+    return x == w ? 1 : -1;
+}
+
+inline ap_int<2> binary_xnor(ap_uint<1> x, ternary_weight_t w)
+{
+    if (w == 0) return 0;
+    return x == (w > 0 ? 1 : 0) ? 1 : -1;
+}
+
+template<class sum_T, class data_T>
+inline sum_T binary_negate(data_T x, binary_weight_t w)
+{
+    return w == 1 ? (sum_T) x : (sum_T) -x;
+}
+
+template<class sum_T, class data_T>
+inline sum_T binary_negate(data_T x, ternary_weight_t w)
+{
+    if (w == 0) return 0;
+    return w > 0 ? (sum_T) x : (sum_T) -x;
+}
+
+// Product of one input and one binary or ternary weight
+template<class sum_T, bool binary_input, class data_T, class weight_T>
+inline sum_T binary_product(data_T x, weight_T w)
+{
+    #pragma HLS INLINE
+    if (binary_input) return (sum_T) binary_xnor(binary_sign(x), w);
+    else return binary_negate<sum_T>(x, w);
+}
+
+// Weights in the same layout as compute_layer_latency, ii*n_out+jj
+template<class data_T, class res_T, typename CONFIG_T>
+void compute_layer_binary(
+    data_T    data[CONFIG_T::n_in],
+    res_T     res[CONFIG_T::n_out],
+    typename CONFIG_T::weight_t  weights[CONFIG_T::n_in*CONFIG_T::n_out],
+    typename CONFIG_T::bias_t    biases[CONFIG_T::n_out])
+{
+    typedef typename binary_sum<typename CONFIG_T::accum_t, CONFIG_T::n_in, CONFIG_T::binary_input>::type sum_t;
+
+    // Use a function_instantiate in case it helps to explicitly optimize unchanging weights/biases
+    #pragma HLS function_instantiate variable=weights,biases
+
+    // No multipliers to limit, the reuse factor only sets the initiation interval
+    #pragma HLS PIPELINE II=CONFIG_T::reuse_factor
+    #pragma HLS ARRAY_PARTITION variable=weights complete
+    #pragma HLS ARRAY_PARTITION variable=biases complete
+
+    // Read every input once, which keeps io_serial in order
+    data_T cache[CONFIG_T::n_in];
+    #pragma HLS ARRAY_PARTITION variable=cache complete
+    BinaryCache: for(int ii = 0; ii < CONFIG_T::n_in; ii++) {
+        cache[ii] = data[ii];
+    }
+
+    BinaryOut: for(int jj = 0; jj < CONFIG_T::n_out; jj++) {
+        sum_t mult[CONFIG_T::n_in];
+        #pragma HLS ARRAY_PARTITION variable=mult complete
+        BinaryProduct: for(int ii = 0; ii < CONFIG_T::n_in; ii++) {
+            mult[ii] = binary_product<sum_t, CONFIG_T::binary_input>(cache[ii], weights[ii*CONFIG_T::n_out+jj]);
+        }
+        typename CONFIG_T::accum_t acc = biases[jj];
+        NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc, mult, CONFIG_T::n_in);
+        acc += adder_tree<sum_t, CONFIG_T::n_in, CONFIG_T::adder_tree_regs>(mult);
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, acc);
+        res[jj] = (res_T) acc;
+    }
+}
+
+// Weights in the same layout as conv_2d. Zero padding adds nothing, with +1/-1
+// inputs as well.
+template<class data_T, class res_T, typename CONFIG_T>
+void conv_2d_binary(
+             data_T   data[CONFIG_T::in_height][CONFIG_T::in_width][CONFIG_T::n_chan],
+             res_T    res[CONFIG_T::out_height][CONFIG_T::out_width][CONFIG_T::n_filt],
+             typename CONFIG_T::weight_t  weights[CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan * CONFIG_T::n_filt],
+             typename CONFIG_T::bias_t    biases[CONFIG_T::n_filt])
+{
+    const unsigned n_prod = CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan;
+    typedef typename binary_sum<typename CONFIG_T::accum_t, n_prod, CONFIG_T::binary_input>::type sum_t;
+
+    // Use a function_instantiate in case it helps to explicitly optimize unchanging weights/biases
+    #pragma HLS function_instantiate variable=weights,biases
+
+    BinaryOutHeight: for(int oh = 0; oh < CONFIG_T::out_height; oh++) {
+      BinaryOutWidth: for(int ow = 0; ow < CONFIG_T::out_width; ow++) {
+        #pragma HLS PIPELINE II=CONFIG_T::reuse_factor
+        BinaryFilt: for(int ff = 0; ff < CONFIG_T::n_filt; ff++) {
+          sum_t mult[n_prod];
+          BinaryFiltHeight: for(int fh = 0; fh < CONFIG_T::filt_height; fh++) {
+            BinaryFiltWidth: for(int fw = 0; fw < CONFIG_T::filt_width; fw++) {
+              int ih = oh*CONFIG_T::stride_height + fh - CONFIG_T::pad_top;
+              int iw = ow*CONFIG_T::stride_width + fw - CONFIG_T::pad_left;
+              bool inside = ih >= 0 && ih < CONFIG_T::in_height && iw >= 0 && iw < CONFIG_T::in_width;
+              BinaryChan: for(int cc = 0; cc < CONFIG_T::n_chan; cc++) {
+                int index_prod = (fh*CONFIG_T::filt_width + fw)*CONFIG_T::n_chan + cc;
+                if (inside) {
+                  mult[index_prod] = binary_product<sum_t, CONFIG_T::binary_input>(data[ih][iw][cc], weights[index_prod*CONFIG_T::n_filt + ff]);
+                } else {
+                  mult[index_prod] = 0;
+                }
+              }
+            }
+          }
+          typename CONFIG_T::accum_t acc = biases[ff];
+          NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc, mult, n_prod);
+          acc += adder_tree<sum_t, n_prod, CONFIG_T::adder_tree_regs>(mult);
+          NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, acc);
+          res[oh][ow][ff] = (res_T) acc;
+        }
+      }
+    }
+}//end conv_2d_binary
+
+// io_stream versions, see compute_layer and conv_2d_stream
+template<class data_T, class res_T, typename CONFIG_T>
+void compute_layer_binary(
+    hls::stream<data_T> &data,
+    hls::stream<res_T>  &res,
+    typename CONFIG_T::weight_t  weights[CONFIG_T::n_in*CONFIG_T::n_out],
+    typename CONFIG_T::bias_t    biases[CONFIG_T::n_out])
+{
+    typename data_T::value_type data_array[CONFIG_T::n_in];
+    typename res_T::value_type res_array[CONFIG_T::n_out];
+    #pragma HLS ARRAY_PARTITION variable=data_array complete
+    #pragma HLS ARRAY_PARTITION variable=res_array complete
+
+    read_stream_array<data_T, CONFIG_T::n_in>(data, data_array);
+    compute_layer_binary<typename data_T::value_type, typename res_T::value_type, CONFIG_T>(data_array, res_array, weights, biases);
+    write_stream_array<res_T, CONFIG_T::n_out>(res_array, res);
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void conv_2d_binary_stream(
+             hls::stream<data_T> &data,
+             hls::stream<res_T>  &res,
+             typename CONFIG_T::weight_t  weights[CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan * CONFIG_T::n_filt],
+             typename CONFIG_T::bias_t    biases[CONFIG_T::n_filt])
+{
+    const unsigned padded_height = CONFIG_T::in_height + CONFIG_T::pad_top + CONFIG_T::pad_bottom;
+    const unsigned padded_width = CONFIG_T::in_width + CONFIG_T::pad_left + CONFIG_T::pad_right;
+    // Keep at least one row so filt_height == 1 still gives a valid declaration
+    const unsigned buffer_rows = CONFIG_T::filt_height > 1 ? CONFIG_T::filt_height - 1 : 1;
+    const unsigned n_prod = CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan;
+    typedef typename binary_sum<typename CONFIG_T::accum_t, n_prod, CONFIG_T::binary_input>::type sum_t;
+
+    typedef typename data_T::value_type pixel_t;
+
+    pixel_t line_buffer[buffer_rows][padded_width][CONFIG_T::n_chan];
+    pixel_t window[CONFIG_T::filt_height][CONFIG_T::filt_width][CONFIG_T::n_chan];
+
+    #pragma HLS ARRAY_PARTITION variable=line_buffer complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=line_buffer complete dim=3
+    #pragma HLS ARRAY_PARTITION variable=window complete dim=0
+
+    // Use a function_instantiate in case it helps to explicitly optimize unchanging weights/biases
+    #pragma HLS function_instantiate variable=weights,biases
+    #pragma HLS ARRAY_PARTITION variable=weights complete dim=0
+    #pragma HLS ARRAY_PARTITION variable=biases complete dim=0
+
+    // Position of the window relative to the stride grid
+    unsigned stride_row = 0;
+
+    ConvRow: for(unsigned ih = 0; ih < padded_height; ih++) {
+      unsigned stride_col = 0;
+      ConvCol: for(unsigned iw = 0; iw < padded_width; iw++) {
+        #pragma HLS PIPELINE II=CONFIG_T::reuse_factor
+
+        // Read the next pixel, or insert padding
+        data_T pixel;
+        if (ih < CONFIG_T::pad_top || ih >= CONFIG_T::pad_top + CONFIG_T::in_height
+         || iw < CONFIG_T::pad_left || iw >= CONFIG_T::pad_left + CONFIG_T::in_width) {
+          PadChan: for(unsigned cc = 0; cc < CONFIG_T::n_chan; cc++) {
+            pixel[cc] = 0;
+          }
+        } else {
+          pixel = data.read();
+        }
+
+        shift_line_buffer_2d<data_T, CONFIG_T::filt_height, CONFIG_T::filt_width, padded_width>(pixel, iw, line_buffer, window);
+
+        // Once the window covers a full filter on the stride grid, compute all filters
+        if (ih + 1 >= CONFIG_T::filt_height && iw + 1 >= CONFIG_T::filt_width && stride_row == 0 && stride_col == 0) {
+          res_T out_pixel;
+          ConvFilt: for(unsigned ff = 0; ff < CONFIG_T::n_filt; ff++) {
+            sum_t mult[n_prod];
+            ConvFiltHeight: for(unsigned fh = 0; fh < CONFIG_T::filt_height; fh++) {
+              ConvFiltWidth: for(unsigned fw = 0; fw < CONFIG_T::filt_width; fw++) {
+                // Padded row and column of the window position, the sign of a padding zero is not -1
+                unsigned ph = ih + 1 + fh - CONFIG_T::filt_height;
+                unsigned pw = iw + 1 + fw - CONFIG_T::filt_width;
+                bool inside = ph >= CONFIG_T::pad_top && ph < CONFIG_T::pad_top + CONFIG_T::in_height
+                           && pw >= CONFIG_T::pad_left && pw < CONFIG_T::pad_left + CONFIG_T::in_width;
+                ConvChan: for(unsigned cc = 0; cc < CONFIG_T::n_chan; cc++) {
+                  unsigned index_prod = (fh*CONFIG_T::filt_width + fw)*CONFIG_T::n_chan + cc;
+                  if (inside) {
+                    mult[index_prod] = binary_product<sum_t, CONFIG_T::binary_input>(window[fh][fw][cc], weights[index_prod*CONFIG_T::n_filt + ff]);
+                  } else {
+                    mult[index_prod] = 0;
+                  }
+                }
+              }
+            }
+            typename CONFIG_T::accum_t acc = biases[ff];
+            NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc, mult, n_prod);
+            acc += adder_tree<sum_t, n_prod, CONFIG_T::adder_tree_regs>(mult);
+            NNET_CHECK_OVERFLOW(CONFIG_T, "result", typename res_T::value_type, acc);
+            out_pixel[ff] = (typename res_T::value_type) acc;
+          }
+          res.write(out_pixel);
+        }
+
+        // Advance the stride position, only once the first full window is reached
+        if (iw + 1 >= CONFIG_T::filt_width) {
+          stride_col = (stride_col + 1 == CONFIG_T::stride_width) ? 0 : stride_col + 1;
+        }
+      }
+      if (ih + 1 >= CONFIG_T::filt_height) {
+        stride_row = (stride_row + 1 == CONFIG_T::stride_height) ? 0 : stride_row + 1;
+      }
+    }
+}//end conv_2d_binary_stream
+
+}
+
+#endif
@@ -26,12 +26,122 @@ namespace nnet {
 
 // Common type definitions
 enum io_type {io_parallel = 0, io_serial};
+enum strategy {latency = 0, resource, sparse};
+
+constexpr int ceillog2(int x){
+  return (x <= 2) ? 1 : 1 + ceillog2((x+1) / 2);
+}
+
+constexpr int pow2(int x){
+  return x == 0 ? 1 : 2 * pow2(x - 1);
+}
 
 // Default data types (??) TODO: Deprecate
 typedef ap_fixed<16,4>  weight_t_def;
 typedef ap_fixed<16,4>  bias_t_def;
 typedef ap_fixed<32,10> accum_t_def;
 
+// Fixed-size group of values transferred through an hls::stream as a single
+// word, e.g. all the channels of one pixel
+template<class T, unsigned N>
+struct array
+{
+    typedef T value_type;
+    static const unsigned size = N;
+
+    T data[N];
+
+    T& operator[](unsigned pos) { return data[pos]; }
+    const T& operator[](unsigned pos) const { return data[pos]; }
+};
+
+// Binary operations for reduce
+template<class T>
+struct Op_add
+{
+    T operator()(T a, T b) { return a + b; }
+};
+
+template<class T>
+struct Op_max
+{
+    T operator()(T a, T b) { return a >= b ? a : b; }
+};
+
+// One pipeline register: HLS keeps the function as a block of exactly one cycle
+template<class T>
+T reg(T x)
+{
+    #pragma HLS PIPELINE
+    #pragma HLS INLINE off
+    #pragma HLS LATENCY min=1 max=1
+    return x;
+}
+
+// n_regs pipeline registers in a row
+template<class T, unsigned n_regs>
+struct pipeline_regs
+{
+    static T delay(T x)
+    {
+        #pragma HLS INLINE
+        return pipeline_regs<T, n_regs - 1>::delay(reg<T>(x));
+    }
+};
+
+template<class T>
+struct pipeline_regs<T, 0>
+{
+    static T delay(T x)
+    {
+        #pragma HLS INLINE
+        return x;
+    }
+};
+
+// Balanced binary tree reduction of N values with the operation Op_T, e.g. an
+// adder or comparator tree of depth ceillog2(N) rather than a chain of N-1 operations.
+// n_regs pipeline registers follow every level of the tree, so the depth in cycles is
+// fixed by the tree instead of being left to the scheduler (0 leaves it combinational).
+template<class T, int N, class Op_T, unsigned n_regs>
+struct reduce_tree
+{
+    static T reduce(const T *x, Op_T op)
+    {
+        #pragma HLS INLINE
+        static const int left = N / 2;
+        T sum = op(reduce_tree<T, left, Op_T, n_regs>::reduce(x, op), reduce_tree<T, N - left, Op_T, n_regs>::reduce(x + left, op));
+        return pipeline_regs<T, n_regs>::delay(sum);
+    }
+};
+
+template<class T, class Op_T, unsigned n_regs>
+struct reduce_tree<T, 1, Op_T, n_regs>
+{
+    static T reduce(const T *x, Op_T op)
+    {
+        #pragma HLS INLINE
+        return x[0];
+    }
+};
+
+template<class T, int N, class Op_T, unsigned n_regs = 0>
+T reduce(const T *x, Op_T op)
+{
+    #pragma HLS INLINE
+    return reduce_tree<T, N, Op_T, n_regs>::reduce(x, op);
+}
+
+// Sum of N values of the accumulator type through a balanced adder tree, see reduce.
+// The multiply-accumulate kernels sum their products with it, CONFIG_T::adder_tree_regs
+// sets the pipeline registers per level
+template<class T, int N, unsigned n_regs>
+T adder_tree(const T *x)
+{
+    #pragma HLS INLINE
+    return reduce<T, N, Op_add<T>, n_regs>(x, Op_add<T>());
+}
+
  template<class data_T, int NIN1, int NIN2>
    void merge(
 	      data_T data1[NIN1], 
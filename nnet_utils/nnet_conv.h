@@ -21,6 +21,8 @@
 #define NNET_CONV_H_
 
 #include "nnet_common.h"
+#include "nnet_csim.h"
+#include "hls_stream.h"
 #include <cstdlib>
 
 namespace nnet {
@@ -45,6 +47,8 @@ struct conv_config
     static const unsigned reuse_factor = 1;
     static const bool store_weights_in_bram = false;
     static const unsigned n_zeros = 0; // not used yet
+    // Pipeline registers after each level of the adder trees, see nnet::adder_tree
+    static const unsigned adder_tree_regs = 0;
 };
 
 
@@ -122,6 +126,7 @@ void conv_1d(
                     }
                     else {
                         mult[index_mult] = data[ii*CONFIG_T::stride+jj-CONFIG_T::pad_left][cc] * weights[index_weight];
+                        NNET_CHECK_OVERFLOW(CONFIG_T, "mult", typename CONFIG_T::accum_t, (double) data[ii*CONFIG_T::stride+jj-CONFIG_T::pad_left][cc] * (double) weights[index_weight]);
                     }
                 }
 	    	}//end channel loop
@@ -140,13 +145,16 @@ void conv_1d(
     // Accumulate multiplication result
     AccumOut: for(int ii = 0; ii < CONFIG_T::y_out; ii++) {
         AccumFilt: for(int ff = 0; ff < CONFIG_T::n_filt; ff++) {
-			//Do "dot product" sum within filter and sum over channels
+			//Do "dot product" sum within filter and sum over channels, through an adder tree
+            typename CONFIG_T::accum_t prod[CONFIG_T::n_chan * CONFIG_T::y_filt];
             AccumChan: for(int cc = 0; cc < CONFIG_T::n_chan; cc++){
 			    AccumDot: for(int jj = 0; jj < CONFIG_T::y_filt; jj++){
                     int index_mult = ii*CONFIG_T::n_filt*CONFIG_T::n_chan*CONFIG_T::y_filt + ff*CONFIG_T::n_chan*CONFIG_T::y_filt + cc*CONFIG_T::y_filt + jj;
-		    		acc[ii][ff] += mult[index_mult];
+		    		prod[cc*CONFIG_T::y_filt + jj] = mult[index_mult];
                 }//end dot product loop
 	    	}//end channel loop
+            NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc[ii][ff], prod, CONFIG_T::n_chan * CONFIG_T::y_filt);
+            acc[ii][ff] += adder_tree<typename CONFIG_T::accum_t, CONFIG_T::n_chan * CONFIG_T::y_filt, CONFIG_T::adder_tree_regs>(prod);
 		}//end filter loop
     }//end output loop
 
@@ -154,6 +162,7 @@ void conv_1d(
      // Cast to "res_t" type 
     for(int ii = 0; ii < CONFIG_T::y_out; ii++) {
 		for(int ff = 0; ff < CONFIG_T::n_filt; ff++) {
+	    	NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, acc[ii][ff]);
 	    	res[ii][ff] = (res_T)(acc[ii][ff]);
 		}
     }
@@ -194,6 +203,88 @@ template<class data_T, int NROWS, int NCOLS>
 
 
 
+
+// Streaming conv1d, the 1D counterpart of conv_2d_stream: one nnet::array of n_chan
+// values per input position, one nnet::array of n_filt results per output position.
+// Only the y_filt positions under the filter are kept, padding is inserted on the fly.
+template<class data_T, class res_T, typename CONFIG_T>
+void conv_1d_stream(
+             hls::stream<data_T> &data,
+             hls::stream<res_T>  &res,
+             typename CONFIG_T::weight_t  weights[CONFIG_T::y_filt * CONFIG_T::n_chan * CONFIG_T::n_filt],
+             typename CONFIG_T::bias_t    biases[CONFIG_T::n_filt])
+{
+    const unsigned padded_width = CONFIG_T::y_in + CONFIG_T::pad_left + CONFIG_T::pad_right;
+
+    typedef typename data_T::value_type pixel_t;
+
+    pixel_t window[CONFIG_T::y_filt][CONFIG_T::n_chan];
+    #pragma HLS ARRAY_PARTITION variable=window complete dim=0
+
+    // Use a function_instantiate in case it helps to explicitly optimize unchanging weights/biases
+    #pragma HLS function_instantiate variable=weights,biases
+    #pragma HLS ARRAY_PARTITION variable=weights complete dim=0
+    #pragma HLS ARRAY_PARTITION variable=biases complete dim=0
+
+    // Limit multipliers to the products of one output position, folded by the reuse factor
+    const int multiplier_limit = (CONFIG_T::y_filt * CONFIG_T::n_chan * CONFIG_T::n_filt + CONFIG_T::reuse_factor - 1) / CONFIG_T::reuse_factor;
+    #pragma HLS ALLOCATION instances=mul limit=multiplier_limit operation
+
+    // Position of the window relative to the stride grid
+    unsigned stride_pos = 0;
+
+    ConvIn: for(unsigned ii = 0; ii < padded_width; ii++) {
+        #pragma HLS PIPELINE II=CONFIG_T::reuse_factor
+
+        // Read the next position, or insert padding
+        data_T pixel;
+        if (ii < CONFIG_T::pad_left || ii >= CONFIG_T::pad_left + CONFIG_T::y_in) {
+            PadChan: for(unsigned cc = 0; cc < CONFIG_T::n_chan; cc++) {
+                pixel[cc] = 0;
+            }
+        } else {
+            pixel = data.read();
+        }
+
+        // Shift the window and append the new position
+        ShiftFilt: for(unsigned jj = 0; jj + 1 < CONFIG_T::y_filt; jj++) {
+            ShiftChan: for(unsigned cc = 0; cc < CONFIG_T::n_chan; cc++) {
+                window[jj][cc] = window[jj+1][cc];
+            }
+        }
+        NewChan: for(unsigned cc = 0; cc < CONFIG_T::n_chan; cc++) {
+            window[CONFIG_T::y_filt-1][cc] = pixel[cc];
+        }
+
+        // Once the window covers a full filter on the stride grid, compute all filters
+        if (ii + 1 >= CONFIG_T::y_filt && stride_pos == 0) {
+            res_T out_pixel;
+            ConvFilt: for(unsigned ff = 0; ff < CONFIG_T::n_filt; ff++) {
+                typename CONFIG_T::accum_t mult[CONFIG_T::y_filt * CONFIG_T::n_chan];
+                ConvMult: for(unsigned jj = 0; jj < CONFIG_T::y_filt; jj++) {
+                    ConvChan: for(unsigned cc = 0; cc < CONFIG_T::n_chan; cc++) {
+                        int index_weight = jj*CONFIG_T::n_chan*CONFIG_T::n_filt + cc*CONFIG_T::n_filt + ff;
+                        mult[jj*CONFIG_T::n_chan + cc] = window[jj][cc] * weights[index_weight];
+                        NNET_CHECK_OVERFLOW(CONFIG_T, "mult", typename CONFIG_T::accum_t, (double) window[jj][cc] * (double) weights[index_weight]);
+                    }
+                }
+                typename CONFIG_T::accum_t acc = biases[ff];
+                NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc, mult, CONFIG_T::y_filt * CONFIG_T::n_chan);
+                acc += adder_tree<typename CONFIG_T::accum_t, CONFIG_T::y_filt * CONFIG_T::n_chan, CONFIG_T::adder_tree_regs>(mult);
+                NNET_CHECK_OVERFLOW(CONFIG_T, "result", typename res_T::value_type, acc);
+                out_pixel[ff] = (typename res_T::value_type) acc;
+            }
+            res.write(out_pixel);
+        }
+
+        // Advance the stride position, only once the first full window is reached
+        if (ii + 1 >= CONFIG_T::y_filt) {
+            stride_pos = (stride_pos + 1 == CONFIG_T::stride) ? 0 : stride_pos + 1;
+        }
+    }
+
+}//end conv_1d_stream
+
 }//end namespace
 
 #endif
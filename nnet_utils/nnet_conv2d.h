@@ -21,6 +21,9 @@
 #define NNET_CONV2D_H_
 
 #include "nnet_common.h"
+#include "nnet_csim.h"
+#include "nnet_stream.h"
+#include "hls_stream.h"
 #include <cstdlib>
 
 namespace nnet {
@@ -52,6 +55,8 @@ struct conv2d_config
     static const unsigned reuse_factor = 1;
     static const bool store_weights_in_bram = false;
     static const unsigned n_zeros = 0; // not used yet
+    // Pipeline registers after each level of the adder trees, see nnet::adder_tree
+    static const unsigned adder_tree_regs = 0;
 };
 
 
@@ -172,6 +177,9 @@ void conv_2d(
 		    mult[index_mult] = data_1d  [ (oh*CONFIG_T::stride_height+fh-CONFIG_T::pad_top)*CONFIG_T::in_width*CONFIG_T::n_chan
 						+(ow*CONFIG_T::stride_width+fw-CONFIG_T::pad_left)*CONFIG_T::n_chan
                                                 +cc ] * weights[index_weight];
+		    NNET_CHECK_OVERFLOW(CONFIG_T, "mult", typename CONFIG_T::accum_t, (double) data_1d[ (oh*CONFIG_T::stride_height+fh-CONFIG_T::pad_top)*CONFIG_T::in_width*CONFIG_T::n_chan
+						+(ow*CONFIG_T::stride_width+fw-CONFIG_T::pad_left)*CONFIG_T::n_chan
+                                                +cc ] * (double) weights[index_weight]);
                 // }
 
               }//end mult loop
@@ -196,7 +204,8 @@ void conv_2d(
     AccumOutHeight: for(int oh = 0; oh < CONFIG_T::out_height; oh++) {
       AccumOutWidth: for(int ow = 0; ow < CONFIG_T::out_width; ow++) {
         AccumFilt: for(int ff = 0; ff < CONFIG_T::n_filt; ff++) {
-	  //Do "dot product" sum within filter and sum over channels
+	  //Do "dot product" sum within filter and sum over channels, through an adder tree
+          typename CONFIG_T::accum_t prod[CONFIG_T::n_chan * CONFIG_T::filt_height * CONFIG_T::filt_width];
           AccumChan: for(int cc = 0; cc < CONFIG_T::n_chan; cc++){
             AccumDotHeight: for(int fh = 0; fh < CONFIG_T::filt_height; fh++){
               AccumDotWidth: for(int fw = 0; fw < CONFIG_T::filt_width; fw++){
@@ -208,11 +217,14 @@ void conv_2d(
                                + fh*CONFIG_T::filt_width 
  		               + fw;
 		
-		acc[oh*CONFIG_T::out_width*CONFIG_T::n_filt + ow*CONFIG_T::n_filt + ff] += mult[index_mult];
+		prod[(cc*CONFIG_T::filt_height + fh)*CONFIG_T::filt_width + fw] = mult[index_mult];
                 
               }//end dot product filter width loop
             }//end dot product filter height loop
 	  }//end n channel loop
+	  NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc[oh*CONFIG_T::out_width*CONFIG_T::n_filt + ow*CONFIG_T::n_filt + ff], prod, CONFIG_T::n_chan * CONFIG_T::filt_height * CONFIG_T::filt_width);
+	  acc[oh*CONFIG_T::out_width*CONFIG_T::n_filt + ow*CONFIG_T::n_filt + ff] +=
+	    adder_tree<typename CONFIG_T::accum_t, CONFIG_T::n_chan * CONFIG_T::filt_height * CONFIG_T::filt_width, CONFIG_T::adder_tree_regs>(prod);
 	}//end n filter loop
       }//end output width loop
     }//end output height loop
@@ -221,6 +233,7 @@ void conv_2d(
     for(int oh = 0; oh < CONFIG_T::out_height; oh++) {
       for(int ow = 0; ow < CONFIG_T::out_width; ow++) {
 	for(int ff = 0; ff < CONFIG_T::n_filt; ff++) {
+	  NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, acc[oh*CONFIG_T::out_width*CONFIG_T::n_filt + ow*CONFIG_T::n_filt + ff]);
  	  res[oh][ow][ff] = (res_T)(acc[oh*CONFIG_T::out_width*CONFIG_T::n_filt + ow*CONFIG_T::n_filt + ff]);
 	}
       }
@@ -229,6 +242,169 @@ void conv_2d(
 }//end conv2d
 
 
+// Conv2D followed by a max pooling (POOL_CONFIG_T, a pooling2d_config), without
+// the conv output ever being stored: each pooled output is the maximum of the
+// conv outputs in its pool window. Each accumulator is cast to res_T before the
+// comparison, as the cast may wrap and does not keep the order of the values. Max
+// pooling commutes with any non-decreasing activation, so the activation can run
+// on the pooled outputs, which gives the same result as conv_2d, activation and
+// pooling2d one after the other. Conv outputs that fall in overlapping pool windows
+// are computed once per window. Padding of either step is skipped, as in Keras.
+template<class data_T, class res_T, typename CONFIG_T, typename POOL_CONFIG_T>
+void conv_2d_pool(
+             data_T   data[CONFIG_T::in_height][CONFIG_T::in_width][CONFIG_T::n_chan],
+             res_T    res[POOL_CONFIG_T::out_height][POOL_CONFIG_T::out_width][CONFIG_T::n_filt],
+             typename CONFIG_T::weight_t  weights[CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan * CONFIG_T::n_filt],
+             typename CONFIG_T::bias_t    biases[CONFIG_T::n_filt])
+{
+    // Use a function_instantiate in case it helps to explicitly optimize unchanging weights/biases
+    #pragma HLS function_instantiate variable=weights,biases
+
+    // Limit multipliers to the products of one pooled output, folded by the reuse factor
+    const int multiplier_limit = (POOL_CONFIG_T::pool_height * POOL_CONFIG_T::pool_width * CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan * CONFIG_T::n_filt + CONFIG_T::reuse_factor - 1) / CONFIG_T::reuse_factor;
+    #pragma HLS ALLOCATION instances=mul limit=multiplier_limit operation
+
+    PoolOutHeight: for(int ph = 0; ph < POOL_CONFIG_T::out_height; ph++) {
+      PoolOutWidth: for(int pw = 0; pw < POOL_CONFIG_T::out_width; pw++) {
+        #pragma HLS PIPELINE II=CONFIG_T::reuse_factor
+        ConvFilt: for(int ff = 0; ff < CONFIG_T::n_filt; ff++) {
+          res_T pool_max = 0;
+          bool first = true;
+          PoolHeight: for(int kh = 0; kh < POOL_CONFIG_T::pool_height; kh++) {
+            PoolWidth: for(int kw = 0; kw < POOL_CONFIG_T::pool_width; kw++) {
+              int oh = ph*POOL_CONFIG_T::stride_height + kh - POOL_CONFIG_T::pad_top;
+              int ow = pw*POOL_CONFIG_T::stride_width + kw - POOL_CONFIG_T::pad_left;
+              if (oh < 0 || oh >= CONFIG_T::out_height || ow < 0 || ow >= CONFIG_T::out_width) continue;
+
+              typename CONFIG_T::accum_t mult[CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan];
+              ConvFiltHeight: for(int fh = 0; fh < CONFIG_T::filt_height; fh++) {
+                ConvFiltWidth: for(int fw = 0; fw < CONFIG_T::filt_width; fw++) {
+                  int ih = oh*CONFIG_T::stride_height + fh - CONFIG_T::pad_top;
+                  int iw = ow*CONFIG_T::stride_width + fw - CONFIG_T::pad_left;
+                  bool padded = ih < 0 || ih >= CONFIG_T::in_height || iw < 0 || iw >= CONFIG_T::in_width;
+                  ConvChan: for(int cc = 0; cc < CONFIG_T::n_chan; cc++) {
+                    int index_weight = fh*CONFIG_T::filt_width*CONFIG_T::n_chan*CONFIG_T::n_filt
+                                     + fw*CONFIG_T::n_chan*CONFIG_T::n_filt
+                                     + cc*CONFIG_T::n_filt
+                                     + ff;
+                    int index_mult = (fh*CONFIG_T::filt_width + fw)*CONFIG_T::n_chan + cc;
+                    mult[index_mult] = padded ? (typename CONFIG_T::accum_t) 0 : (typename CONFIG_T::accum_t) (data[ih][iw][cc] * weights[index_weight]);
+                    if (!padded) NNET_CHECK_OVERFLOW(CONFIG_T, "mult", typename CONFIG_T::accum_t, (double) data[ih][iw][cc] * (double) weights[index_weight]);
+                  }
+                }
+              }
+              typename CONFIG_T::accum_t acc = biases[ff];
+              NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc, mult, CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan);
+              acc += adder_tree<typename CONFIG_T::accum_t, CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan, CONFIG_T::adder_tree_regs>(mult);
+              NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, acc);
+              res_T conv_out = (res_T) acc;
+              if (first || conv_out > pool_max) pool_max = conv_out;
+              first = false;
+            }
+          }
+          res[ph][pw][ff] = pool_max;
+        }
+      }
+    }
+}//end conv_2d_pool
+
+
+// Streaming conv2d. Pixels arrive in raster order, one nnet::array of n_chan
+// values per stream word, and one nnet::array of n_filt results is written per
+// output pixel. Only filt_height-1 (padded) rows are kept in a line buffer, plus
+// the filt_height x filt_width window the filters are applied to, so the full
+// image and the mult/acc arrays of conv_2d are never materialized. Zero padding
+// is inserted on the fly, the stream only carries the in_height*in_width pixels.
+template<class data_T, class res_T, typename CONFIG_T>
+void conv_2d_stream(
+             hls::stream<data_T> &data,
+             hls::stream<res_T>  &res,
+             typename CONFIG_T::weight_t  weights[CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan * CONFIG_T::n_filt],
+             typename CONFIG_T::bias_t    biases[CONFIG_T::n_filt])
+{
+    const unsigned padded_height = CONFIG_T::in_height + CONFIG_T::pad_top + CONFIG_T::pad_bottom;
+    const unsigned padded_width = CONFIG_T::in_width + CONFIG_T::pad_left + CONFIG_T::pad_right;
+    // Keep at least one row so filt_height == 1 still gives a valid declaration
+    const unsigned buffer_rows = CONFIG_T::filt_height > 1 ? CONFIG_T::filt_height - 1 : 1;
+
+    typedef typename data_T::value_type pixel_t;
+
+    pixel_t line_buffer[buffer_rows][padded_width][CONFIG_T::n_chan];
+    pixel_t window[CONFIG_T::filt_height][CONFIG_T::filt_width][CONFIG_T::n_chan];
+
+    #pragma HLS ARRAY_PARTITION variable=line_buffer complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=line_buffer complete dim=3
+    #pragma HLS ARRAY_PARTITION variable=window complete dim=0
+
+    // Use a function_instantiate in case it helps to explicitly optimize unchanging weights/biases
+    #pragma HLS function_instantiate variable=weights,biases
+    #pragma HLS ARRAY_PARTITION variable=weights complete dim=0
+    #pragma HLS ARRAY_PARTITION variable=biases complete dim=0
+
+    // Limit multipliers to the products of one output pixel, folded by the reuse factor
+    const int multiplier_limit = (CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan * CONFIG_T::n_filt + CONFIG_T::reuse_factor - 1) / CONFIG_T::reuse_factor;
+    #pragma HLS ALLOCATION instances=mul limit=multiplier_limit operation
+
+    // Position of the window relative to the stride grid
+    unsigned stride_row = 0;
+
+    ConvRow: for(unsigned ih = 0; ih < padded_height; ih++) {
+      unsigned stride_col = 0;
+      ConvCol: for(unsigned iw = 0; iw < padded_width; iw++) {
+        #pragma HLS PIPELINE II=CONFIG_T::reuse_factor
+
+        // Read the next pixel, or insert padding
+        data_T pixel;
+        if (ih < CONFIG_T::pad_top || ih >= CONFIG_T::pad_top + CONFIG_T::in_height
+         || iw < CONFIG_T::pad_left || iw >= CONFIG_T::pad_left + CONFIG_T::in_width) {
+          PadChan: for(unsigned cc = 0; cc < CONFIG_T::n_chan; cc++) {
+            pixel[cc] = 0;
+          }
+        } else {
+          pixel = data.read();
+        }
+
+        shift_line_buffer_2d<data_T, CONFIG_T::filt_height, CONFIG_T::filt_width, padded_width>(pixel, iw, line_buffer, window);
+
+        // Once the window covers a full filter on the stride grid, compute all filters
+        if (ih + 1 >= CONFIG_T::filt_height && iw + 1 >= CONFIG_T::filt_width && stride_row == 0 && stride_col == 0) {
+          res_T out_pixel;
+          ConvFilt: for(unsigned ff = 0; ff < CONFIG_T::n_filt; ff++) {
+            typename CONFIG_T::accum_t mult[CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan];
+            ConvFiltHeight: for(unsigned fh = 0; fh < CONFIG_T::filt_height; fh++) {
+              ConvFiltWidth: for(unsigned fw = 0; fw < CONFIG_T::filt_width; fw++) {
+                ConvChan: for(unsigned cc = 0; cc < CONFIG_T::n_chan; cc++) {
+                  int index_weight = fh*CONFIG_T::filt_width*CONFIG_T::n_chan*CONFIG_T::n_filt
+                                   + fw*CONFIG_T::n_chan*CONFIG_T::n_filt
+                                   + cc*CONFIG_T::n_filt
+                                   + ff;
+                  mult[(fh*CONFIG_T::filt_width + fw)*CONFIG_T::n_chan + cc] = window[fh][fw][cc] * weights[index_weight];
+                  NNET_CHECK_OVERFLOW(CONFIG_T, "mult", typename CONFIG_T::accum_t, (double) window[fh][fw][cc] * (double) weights[index_weight]);
+                }
+              }
+            }
+            typename CONFIG_T::accum_t acc = biases[ff];
+            NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc, mult, CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan);
+            acc += adder_tree<typename CONFIG_T::accum_t, CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan, CONFIG_T::adder_tree_regs>(mult);
+            NNET_CHECK_OVERFLOW(CONFIG_T, "result", typename res_T::value_type, acc);
+            out_pixel[ff] = (typename res_T::value_type) acc;
+          }
+          res.write(out_pixel);
+        }
+
+        // Advance the stride position, only once the first full window is reached
+        if (iw + 1 >= CONFIG_T::filt_width) {
+          stride_col = (stride_col + 1 == CONFIG_T::stride_width) ? 0 : stride_col + 1;
+        }
+      }//end column loop
+      if (ih + 1 >= CONFIG_T::filt_height) {
+        stride_row = (stride_row + 1 == CONFIG_T::stride_height) ? 0 : stride_row + 1;
+      }
+    }//end row loop
+
+}//end conv_2d_stream
+
+
 template<class data_T, int N1, int N2, int N3>
     void flatten(
         data_T    data[N1][N2][N3], 
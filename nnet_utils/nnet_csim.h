@@ -0,0 +1,56 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef NNET_CSIM_H_
+#define NNET_CSIM_H_
+
+// C simulation hooks of the kernels. Each one expands to nothing unless its option is
+// given when compiling the C model, and always in synthesis, so the kernels only pull
+// in the host code of nnet_trace.h, nnet_overflow.h or nnet_weights.h on request.
+
+// Outputs of every layer in C simulation, see nnet_trace.h
+#if defined(NNET_TRACE) && !defined(__SYNTHESIS__)
+#include "nnet_trace.h"
+#define NNET_TRACE_ARRAY(name, layout, precision, data, n) nnet::trace_values(name, layout, precision, data, n)
+#define NNET_TRACE_STREAM(name, precision, fifo) nnet::trace_stream(name, precision, fifo)
+#define NNET_TRACE_EVENT(event) (nnet::trace_event() = (event))
+#else
+#define NNET_TRACE_ARRAY(name, layout, precision, data, n)
+#define NNET_TRACE_STREAM(name, precision, fifo)
+#define NNET_TRACE_EVENT(event)
+#endif
+
+// Overflow counters in C simulation, see nnet_overflow.h. T is the type of the variable
+#if defined(NNET_CHECK_OVERFLOWS) && !defined(__SYNTHESIS__)
+#include "nnet_overflow.h"
+#define NNET_CHECK_OVERFLOW(CONFIG_T, variable, T, x) { static nnet::overflow_counter &nnet_counter = nnet::get_overflow_counter<CONFIG_T, T>(variable); nnet_counter.check(x); }
+#define NNET_CHECK_SUM(CONFIG_T, variable, T, init, x, n) { static nnet::overflow_counter &nnet_counter = nnet::get_overflow_counter<CONFIG_T, T>(variable); nnet_counter.check(nnet::overflow_sum(init, x, n)); }
+#define NNET_CHECK_CLIP(CONFIG_T, variable, clipped) { static nnet::overflow_counter &nnet_counter = nnet::get_overflow_counter<CONFIG_T, int>(variable); nnet_counter.count(clipped); }
+#else
+#define NNET_CHECK_OVERFLOW(CONFIG_T, variable, T, x)
+#define NNET_CHECK_SUM(CONFIG_T, variable, T, init, x, n)
+#define NNET_CHECK_CLIP(CONFIG_T, variable, clipped)
+#endif
+
+// Weights read from $readmemh files in C simulation, see nnet_weights.h
+#if defined(NNET_WEIGHTS_MEM) && !defined(__SYNTHESIS__)
+#include "nnet_weights.h"
+#endif
+
+#endif
@@ -0,0 +1,354 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef NNET_FIXED_H_
+#define NNET_FIXED_H_
+
+// Fast C simulation: compiling with -DNNET_FAST_CSIM replaces ap_fixed/ap_ufixed
+// in everything included after this header (the types in parameters.h, the weights
+// and the testbench) with nnet::fixed/nnet::ufixed. These keep the value as a scaled
+// int64_t and follow the ap_fixed rules: operators return the full precision result,
+// and quantization (all ap_q_mode) and overflow (AP_WRAP, AP_SAT, AP_SAT_ZERO,
+// AP_SAT_SYM) are only applied when assigning to a declared type. Restrictions:
+//   - types of at most 64 bits, and operations whose full precision result fits in 64
+//     bits, which is checked at compile time
+//   - AP_WRAP_SM and the saturation bits N are treated as AP_WRAP
+//   - no mixed arithmetic with the real ap_fixed types, only conversions
+// Synthesis always uses ap_fixed, so only use this for C simulation (not cosim).
+#if defined(NNET_FAST_CSIM) && !defined(__SYNTHESIS__)
+
+#include <stdint.h>
+#include <cmath>
+#include <iostream>
+#include "ap_fixed.h"
+#include "nnet_helpers.h"
+
+namespace nnet {
+
+template<bool B, class T = void> struct fixed_enable_if {};
+template<class T> struct fixed_enable_if<true, T> { typedef T type; };
+
+// Integer operands behave like ap_fixed<bits, bits> (ap_ufixed for unsigned types)
+template<class T> struct fixed_int_traits { static const bool is_int = false; };
+#define NNET_FIXED_INT_TRAITS(T, S) \
+    template<> struct fixed_int_traits<T> { static const bool is_int = true; static const bool sign = S; static const int width = 8 * sizeof(T); };
+NNET_FIXED_INT_TRAITS(bool, false)
+NNET_FIXED_INT_TRAITS(char, true)
+NNET_FIXED_INT_TRAITS(signed char, true)
+NNET_FIXED_INT_TRAITS(unsigned char, false)
+NNET_FIXED_INT_TRAITS(short, true)
+NNET_FIXED_INT_TRAITS(unsigned short, false)
+NNET_FIXED_INT_TRAITS(int, true)
+NNET_FIXED_INT_TRAITS(unsigned int, false)
+NNET_FIXED_INT_TRAITS(long, true)
+NNET_FIXED_INT_TRAITS(unsigned long, false)
+NNET_FIXED_INT_TRAITS(long long, true)
+NNET_FIXED_INT_TRAITS(unsigned long long, false)
+#undef NNET_FIXED_INT_TRAITS
+
+template<class T> struct fixed_float_traits { static const bool is_float = false; };
+template<> struct fixed_float_traits<float> { static const bool is_float = true; };
+template<> struct fixed_float_traits<double> { static const bool is_float = true; };
+
+constexpr int fixed_max(int a, int b) { return a > b ? a : b; }
+constexpr int fixed_min(int a, int b) { return a < b ? a : b; }
+
+// Round away the d lowest bits of v according to the quantization mode
+template<ap_q_mode Q>
+inline int64_t fixed_round(int64_t v, int d) {
+    if (d <= 0) return d <= -64 ? 0 : (int64_t)((uint64_t)v << -d);
+    if (d >= 63) return (v < 0 && Q == AP_TRN) ? -1 : 0;
+    int64_t q = v >> d;
+    int64_t rem = v & (((int64_t)1 << d) - 1);
+    int64_t half = (int64_t)1 << (d - 1);
+    switch (Q) {
+        case AP_TRN:         return q;
+        case AP_TRN_ZERO:    return (v < 0 && rem != 0) ? q + 1 : q;
+        case AP_RND:         return rem >= half ? q + 1 : q;
+        case AP_RND_ZERO:    return (rem > half || (rem == half && v < 0)) ? q + 1 : q;
+        case AP_RND_MIN_INF: return rem > half ? q + 1 : q;
+        case AP_RND_INF:     return (rem > half || (rem == half && v >= 0)) ? q + 1 : q;
+        case AP_RND_CONV:    return (rem > half || (rem == half && (q & 1))) ? q + 1 : q;
+    }
+    return q;
+}
+
+template<int W, int I, bool S, ap_q_mode Q = AP_TRN, ap_o_mode O = AP_WRAP, int N = 0>
+struct fixed_base
+{
+    static_assert(W > 0 && W <= 64, "NNET_FAST_CSIM supports types of 1 to 64 bits");
+
+    static const int width = W;
+    static const int iwidth = I;
+    static const int fwidth = W - I;
+    static const bool sign_flag = S;
+    static const ap_q_mode qmode = Q;
+    static const ap_o_mode omode = O;
+
+    // Value scaled by 2^fwidth
+    int64_t V;
+
+    // Overflow handling of an integer already at this type's scale
+    static int64_t overflow(int64_t v) {
+        const int64_t max_v = S ? (int64_t)(((uint64_t)1 << (W - 1)) - 1) : (W == 64 ? INT64_MAX : (int64_t)(((uint64_t)1 << W) - 1));
+        const int64_t min_v = S ? (W == 64 ? INT64_MIN : -((int64_t)1 << (W - 1))) : 0;
+        if (v >= min_v && v <= max_v) return v;
+        switch (O) {
+            case AP_SAT:      return v < min_v ? min_v : max_v;
+            case AP_SAT_ZERO: return 0;
+            case AP_SAT_SYM:  return v < min_v ? (S ? -max_v : 0) : max_v;
+            default:
+                if (W == 64) return v;
+                if (S) return (int64_t)((uint64_t)v << (64 - W)) >> (64 - W);
+                return (int64_t)((uint64_t)v & (((uint64_t)1 << W) - 1));
+        }
+    }
+
+    static fixed_base from_raw(int64_t v) { fixed_base r; r.V = v; return r; }
+
+    fixed_base() : V(0) {}
+
+    template<int W2, int I2, bool S2, ap_q_mode Q2, ap_o_mode O2, int N2>
+    fixed_base(const fixed_base<W2, I2, S2, Q2, O2, N2> &x) : V(overflow(fixed_round<Q>(x.V, (W2 - I2) - (W - I)))) {}
+
+    // Conversion from the real ap_fixed, e.g. the default table_t of hand-written configs
+    template<int W2, int I2, bool S2, ap_q_mode Q2, ap_o_mode O2, int N2>
+    fixed_base(const ::ap_fixed_base<W2, I2, S2, Q2, O2, N2> &x) : V(from_double(x.to_double())) {}
+
+    template<class T>
+    fixed_base(T x, typename fixed_enable_if<fixed_int_traits<T>::is_int>::type* = 0) : V(overflow(fixed_round<Q>((int64_t)x, I - W))) {}
+
+    template<class T>
+    fixed_base(T x, typename fixed_enable_if<fixed_float_traits<T>::is_float>::type* = 0) : V(from_double(x)) {}
+
+    static int64_t from_double(double x) {
+        double n = std::ldexp(x, W - I);
+        if (n != n) return 0;
+        // Reduce out of range values first, wrapping only depends on the low W bits
+        const double lim = std::ldexp(1.0, 62);
+        if (n >= lim || n < -lim) {
+            if (O == AP_WRAP || O == AP_WRAP_SM) {
+                n = std::fmod(n, std::ldexp(1.0, fixed_min(W, 62)));
+            } else {
+                return overflow(n < 0 ? INT64_MIN : INT64_MAX);
+            }
+        }
+        double fl = std::floor(n);
+        double r = n - fl;
+        int64_t q = (int64_t)fl;
+        switch (Q) {
+            case AP_TRN:         break;
+            case AP_TRN_ZERO:    if (n < 0 && r > 0) q++; break;
+            case AP_RND:         if (r >= 0.5) q++; break;
+            case AP_RND_ZERO:    if (r > 0.5 || (r == 0.5 && n < 0)) q++; break;
+            case AP_RND_MIN_INF: if (r > 0.5) q++; break;
+            case AP_RND_INF:     if (r > 0.5 || (r == 0.5 && n > 0)) q++; break;
+            case AP_RND_CONV:    if (r > 0.5 || (r == 0.5 && (q & 1))) q++; break;
+        }
+        return overflow(q);
+    }
+
+    double to_double() const { return std::ldexp((double)V, I - W); }
+    float to_float() const { return (float)to_double(); }
+    // Like ap_fixed, rounds towards zero
+    int to_int() const { return (int)to_double(); }
+    operator double() const { return to_double(); }
+
+    // Bit access, e.g. x[x.width - 1] = 1 for the most negative value
+    struct bitref {
+        fixed_base &x;
+        int b;
+        bitref(fixed_base &x, int b) : x(x), b(b) {}
+        operator bool() const { return (x.V >> b) & 1; }
+        bitref &operator=(bool v) {
+            int64_t bits = v ? (x.V | ((int64_t)1 << b)) : (x.V & ~((int64_t)1 << b));
+            x.V = fixed_base<W, I, S>::overflow(bits);
+            return *this;
+        }
+    };
+    bitref operator[](int b) { return bitref(*this, b); }
+    bool operator[](int b) const { return (V >> b) & 1; }
+
+    template<class T> fixed_base &operator+=(const T &x) { return *this = *this + x; }
+    template<class T> fixed_base &operator-=(const T &x) { return *this = *this - x; }
+    template<class T> fixed_base &operator*=(const T &x) { return *this = *this * x; }
+    template<class T> fixed_base &operator/=(const T &x) { return *this = *this / x; }
+
+    typedef fixed_base<W + 1, I + 1, true> neg_t;
+    neg_t operator-() const {
+        static_assert(W + 1 <= 64, "NNET_FAST_CSIM: the negation of this type needs more than 64 bits");
+        return neg_t::from_raw(-V);
+    }
+};
+
+template<int W, int I, ap_q_mode Q = AP_TRN, ap_o_mode O = AP_WRAP, int N = 0>
+using fixed = fixed_base<W, I, true, Q, O, N>;
+
+template<int W, int I, ap_q_mode Q = AP_TRN, ap_o_mode O = AP_WRAP, int N = 0>
+using ufixed = fixed_base<W, I, false, Q, O, N>;
+
+// Full precision result types, as for ap_fixed. The operators check that they fit in
+// the 64 bits of the value rather than dropping integer bits
+template<int W1, int I1, bool S1, int W2, int I2, bool S2>
+struct fixed_result {
+    static const int F_add = fixed_max(W1 - I1, W2 - I2);
+    static const int I_add = fixed_max(I1 + (S2 && !S1), I2 + (S1 && !S2)) + 1;
+    static const int W_add = F_add + I_add;
+    typedef fixed_base<W_add, I_add, S1 || S2> add;
+    static const int W_mult = W1 + W2;
+    typedef fixed_base<W_mult, I1 + I2, S1 || S2> mult;
+    // Division keeps the fractional bits of the dividend
+    static const int F2_pos = fixed_max(W2 - I2, 0);
+    static const int F_div = (W1 - I1) + F2_pos - (W2 - I2);
+    static const int I_div = I1 + (W2 - I2) + S2;
+    static const int W_div = F_div + I_div;
+    typedef fixed_base<W_div, I_div, S1 || S2> div;
+};
+
+template<class T, bool IS_INT = fixed_int_traits<T>::is_int>
+struct fixed_of_int {};
+
+template<class T>
+struct fixed_of_int<T, true> {
+    typedef fixed_base<fixed_int_traits<T>::width, fixed_int_traits<T>::width, fixed_int_traits<T>::sign> type;
+};
+
+#define NNET_FIXED_A fixed_base<W1, I1, S1, Q1, O1, N1>
+#define NNET_FIXED_B fixed_base<W2, I2, S2, Q2, O2, N2>
+#define NNET_FIXED_TEMPLATE template<int W1, int I1, bool S1, ap_q_mode Q1, ap_o_mode O1, int N1, int W2, int I2, bool S2, ap_q_mode Q2, ap_o_mode O2, int N2>
+#define NNET_FIXED_TEMPLATE_1 template<int W1, int I1, bool S1, ap_q_mode Q1, ap_o_mode O1, int N1, class T>
+
+NNET_FIXED_TEMPLATE
+typename fixed_result<W1, I1, S1, W2, I2, S2>::add operator+(const NNET_FIXED_A &a, const NNET_FIXED_B &b) {
+    static_assert(fixed_result<W1, I1, S1, W2, I2, S2>::W_add <= 64, "NNET_FAST_CSIM: the sum of these types needs more than 64 bits");
+    typedef typename fixed_result<W1, I1, S1, W2, I2, S2>::add R;
+    return R::from_raw(fixed_round<AP_TRN>(a.V, (W1 - I1) - R::fwidth) + fixed_round<AP_TRN>(b.V, (W2 - I2) - R::fwidth));
+}
+
+NNET_FIXED_TEMPLATE
+typename fixed_result<W1, I1, S1, W2, I2, S2>::add operator-(const NNET_FIXED_A &a, const NNET_FIXED_B &b) {
+    static_assert(fixed_result<W1, I1, S1, W2, I2, S2>::W_add <= 64, "NNET_FAST_CSIM: the difference of these types needs more than 64 bits");
+    typedef typename fixed_result<W1, I1, S1, W2, I2, S2>::add R;
+    return R::from_raw(fixed_round<AP_TRN>(a.V, (W1 - I1) - R::fwidth) - fixed_round<AP_TRN>(b.V, (W2 - I2) - R::fwidth));
+}
+
+NNET_FIXED_TEMPLATE
+typename fixed_result<W1, I1, S1, W2, I2, S2>::mult operator*(const NNET_FIXED_A &a, const NNET_FIXED_B &b) {
+    static_assert(fixed_result<W1, I1, S1, W2, I2, S2>::W_mult <= 64, "NNET_FAST_CSIM: the product of these types needs more than 64 bits");
+    typedef typename fixed_result<W1, I1, S1, W2, I2, S2>::mult R;
+    return R::from_raw(a.V * b.V);
+}
+
+NNET_FIXED_TEMPLATE
+typename fixed_result<W1, I1, S1, W2, I2, S2>::div operator/(const NNET_FIXED_A &a, const NNET_FIXED_B &b) {
+    static_assert(fixed_result<W1, I1, S1, W2, I2, S2>::W_div <= 64, "NNET_FAST_CSIM: the quotient of these types needs more than 64 bits");
+    typedef typename fixed_result<W1, I1, S1, W2, I2, S2>::div R;
+    // Integer division rounds towards zero, as in ap_fixed
+    return R::from_raw(fixed_round<AP_TRN>(a.V, -fixed_result<W1, I1, S1, W2, I2, S2>::F2_pos) / b.V);
+}
+
+#define NNET_FIXED_COMPARE(OP) \
+NNET_FIXED_TEMPLATE \
+bool operator OP(const NNET_FIXED_A &a, const NNET_FIXED_B &b) { \
+    const int F = fixed_max(W1 - I1, W2 - I2); \
+    return fixed_round<AP_TRN>(a.V, (W1 - I1) - F) OP fixed_round<AP_TRN>(b.V, (W2 - I2) - F); \
+}
+NNET_FIXED_COMPARE(==)
+NNET_FIXED_COMPARE(!=)
+NNET_FIXED_COMPARE(<)
+NNET_FIXED_COMPARE(<=)
+NNET_FIXED_COMPARE(>)
+NNET_FIXED_COMPARE(>=)
+#undef NNET_FIXED_COMPARE
+
+// Integer operands are converted to fixed point, floating point operands convert
+// the fixed point value to double
+#define NNET_FIXED_MIXED_OP(OP) \
+NNET_FIXED_TEMPLATE_1 \
+typename fixed_enable_if<fixed_int_traits<T>::is_int, decltype(NNET_FIXED_A() OP typename fixed_of_int<T>::type())>::type \
+operator OP(const NNET_FIXED_A &a, T b) { return a OP typename fixed_of_int<T>::type(b); } \
+NNET_FIXED_TEMPLATE_1 \
+typename fixed_enable_if<fixed_int_traits<T>::is_int, decltype(typename fixed_of_int<T>::type() OP NNET_FIXED_A())>::type \
+operator OP(T a, const NNET_FIXED_A &b) { return typename fixed_of_int<T>::type(a) OP b; } \
+NNET_FIXED_TEMPLATE_1 \
+typename fixed_enable_if<fixed_float_traits<T>::is_float, decltype(double() OP double())>::type \
+operator OP(const NNET_FIXED_A &a, T b) { return a.to_double() OP b; } \
+NNET_FIXED_TEMPLATE_1 \
+typename fixed_enable_if<fixed_float_traits<T>::is_float, decltype(double() OP double())>::type \
+operator OP(T a, const NNET_FIXED_A &b) { return a OP b.to_double(); }
+NNET_FIXED_MIXED_OP(+)
+NNET_FIXED_MIXED_OP(-)
+NNET_FIXED_MIXED_OP(*)
+NNET_FIXED_MIXED_OP(/)
+NNET_FIXED_MIXED_OP(==)
+NNET_FIXED_MIXED_OP(!=)
+NNET_FIXED_MIXED_OP(<)
+NNET_FIXED_MIXED_OP(<=)
+NNET_FIXED_MIXED_OP(>)
+NNET_FIXED_MIXED_OP(>=)
+#undef NNET_FIXED_MIXED_OP
+
+template<int W1, int I1, bool S1, ap_q_mode Q1, ap_o_mode O1, int N1>
+std::ostream &operator<<(std::ostream &os, const NNET_FIXED_A &x) {
+    return os << x.to_double();
+}
+
+template<int W1, int I1, bool S1, ap_q_mode Q1, ap_o_mode O1, int N1>
+std::istream &operator>>(std::istream &is, NNET_FIXED_A &x) {
+    double d;
+    is >> d;
+    x = d;
+    return is;
+}
+
+#undef NNET_FIXED_A
+#undef NNET_FIXED_B
+#undef NNET_FIXED_TEMPLATE
+#undef NNET_FIXED_TEMPLATE_1
+
+// Same as the ap_fixed overload in nnet_merge.h, found by argument dependent lookup
+template<int W, int I, bool S, ap_q_mode Q, ap_o_mode O, int N>
+fixed_base<W + 1, I, S> halve(fixed_base<W, I, S, Q, O, N> x)
+{
+    static_assert(W + 1 <= 64, "NNET_FAST_CSIM: the half of this type needs more than 64 bits");
+    return fixed_base<W + 1, I, S>::from_raw(x.V);
+}
+
+// Same as the ap_fixed overload in nnet_pooling.h, found by argument dependent lookup
+template<int W, int I, int N_IN>
+fixed<W, I> avg(fixed<W, I> (&x)[N_IN]){
+  // Use a wider accumulator than the input to avoid overflow
+  fixed<W + ceillog2(N_IN), I + ceillog2(N_IN)> tmp = 0;
+  for(int i = 0; i < N_IN; i++){
+    tmp += x[i];
+  }
+  tmp /= N_IN;
+  // Now cast back to original type
+  fixed<W, I> y = tmp;
+  return y;
+}
+
+}
+
+#define ap_fixed nnet::fixed
+#define ap_ufixed nnet::ufixed
+
+#endif
+
+#endif
@@ -24,6 +24,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include "hls_stream.h"
+#include "nnet_common.h"
+#include "nnet_csim.h"
 
 namespace nnet {
 
@@ -81,25 +83,6 @@ void change_type(hls::stream<in_T> &in, hls::stream<out_T> &out)
     }
 }
 
-// template<class data_T, int N_IN>
-// void  hls_stream_debug(hls::stream<data_T> &data, hls::stream<data_T> &res)
-// {
-//     data_T datareg;
-//     for (int ii=0; ii<N_IN; ii++) {
-//         datareg = data.read();
-//         std::cout << "[" << ii << "]: " << datareg << std::endl;
-//         res << datareg;
-//     }
-// }
-
-constexpr int ceillog2(int x){
-  return (x <= 2) ? 1 : 1 + ceillog2((x+1) / 2);
-}
-
-constexpr int pow2(int x){
-  return x == 0 ? 1 : 2 * pow2(x - 1);
-}
-
 }
 
 #endif
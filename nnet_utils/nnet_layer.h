@@ -21,6 +21,8 @@
 #define NNET_LAYER_H_
 
 #include "nnet_common.h"
+#include "nnet_csim.h"
+#include "nnet_stream.h"
 #include "hls_stream.h"
 #include <math.h>
 
@@ -42,11 +44,31 @@ struct layer_config
     static const unsigned reuse_factor = 1;
     static const bool store_weights_in_bram = false;
     static const unsigned n_zeros = 0;
+    // Pipeline registers after each level of the adder trees, see nnet::adder_tree
+    static const unsigned adder_tree_regs = 0;
+    // latency:  fully partitioned mult array, multipliers limited by ALLOCATION
+    // resource: weights in BRAM, MAC loop folded reuse_factor times (see compute_layer_resource)
+    // sparse:   only the nonzero weights are stored (see compute_layer_sparse)
+    static const unsigned strategy = latency;
     // partitioning arrays cyclically to go with roll factors?
+
+    // Sparse layers only
+    static const unsigned n_nonzeros = n_in*n_out;
+    typedef unsigned short index_t;
+};
+
+// One nonzero weight of a pruned layer, in coordinate (COO) format:
+// weight connects input row_index to output col_index
+template<class weight_T, class index_T>
+struct sparse_weight
+{
+    index_T  row_index;
+    index_T  col_index;
+    weight_T weight;
 };
 
  template<class data_T, class res_T, typename CONFIG_T>
-void compute_layer(
+void compute_layer_latency(
     data_T    data[CONFIG_T::n_in],
     res_T     res[CONFIG_T::n_out],
     typename CONFIG_T::weight_t  weights[CONFIG_T::n_in*CONFIG_T::n_out],
@@ -107,6 +129,7 @@ void compute_layer(
             }
 	    int index = ii*CONFIG_T::n_out+jj;
 	    mult[index] = cache * weights[index];
+	    NNET_CHECK_OVERFLOW(CONFIG_T, "mult", typename CONFIG_T::accum_t, (double) cache * (double) weights[index]);
         }
     }
 
@@ -119,13 +142,28 @@ void compute_layer(
     }
 
     // Accumulate multiplication result
-    Accum1: for(int ii = 0; ii < CONFIG_T::n_in; ii++) {
-        if (CONFIG_T::io_type == io_serial){
-            #pragma HLS PIPELINE
+    if (CONFIG_T::io_type == io_parallel){
+        // One adder tree per output over the products of all the inputs
+        AccumTree: for(int jj = 0; jj < CONFIG_T::n_out; jj++) {
+            typename CONFIG_T::accum_t prod[CONFIG_T::n_in];
+            #pragma HLS ARRAY_PARTITION variable=prod complete
+            AccumGather: for(int ii = 0; ii < CONFIG_T::n_in; ii++) {
+                prod[ii] = mult[ii*CONFIG_T::n_out+jj];
+            }
+            NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc[jj], prod, CONFIG_T::n_in);
+            acc[jj] += adder_tree<typename CONFIG_T::accum_t, CONFIG_T::n_in, CONFIG_T::adder_tree_regs>(prod);
         }
-        Accum2: for(int jj = 0; jj < CONFIG_T::n_out; jj++) {
-	    int index = ii*CONFIG_T::n_out+jj;
-	    acc[jj] += mult[index];
+    } else {
+        // The serial products are streamed, one input per cycle, so each output adds one
+        // product per cycle as it arrives: one adder deep, there is no chain to break up.
+        // A tree would have to buffer all the n_in products of an event first
+        Accum1: for(int ii = 0; ii < CONFIG_T::n_in; ii++) {
+            #pragma HLS PIPELINE
+            Accum2: for(int jj = 0; jj < CONFIG_T::n_out; jj++) {
+                int index = ii*CONFIG_T::n_out+jj;
+                NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc[jj], &mult[index], 1);
+                acc[jj] += mult[index];
+            }
         }
     }
 
@@ -134,10 +172,177 @@ void compute_layer(
         if (CONFIG_T::io_type == io_serial){
             #pragma HLS UNROLL
         }
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, acc[ires]);
         res[ires] = (res_T) (acc[ires]);
     }    
 }
 
+// Resource strategy: the weights live in block RAM, reshaped so that one word
+// holds the n_in*n_out/reuse_factor weights consumed in a single cycle. The
+// ReuseLoop walks reuse_factor words at II=1, feeding a block of multipliers
+// into per-output partial sums; no n_in*n_out intermediate array is created.
+// The n_in/reuse_factor products of an output in one word go through an adder tree.
+//
+// The weights must be stored transposed, i.e. index = jj*n_in + ii, and
+// n_in must be divisible by reuse_factor (the writer takes care of both).
+template<class data_T, class res_T, typename CONFIG_T>
+void compute_layer_resource(
+    data_T    data[CONFIG_T::n_in],
+    res_T     res[CONFIG_T::n_out],
+    typename CONFIG_T::weight_t  weights[CONFIG_T::n_in*CONFIG_T::n_out],
+    typename CONFIG_T::bias_t    biases[CONFIG_T::n_out])
+{
+    const int rufactor = CONFIG_T::reuse_factor;
+    const int block_factor = (CONFIG_T::n_in*CONFIG_T::n_out + rufactor - 1) / rufactor;
+    const int multscale = block_factor / CONFIG_T::n_out;
+    typedef typename CONFIG_T::accum_t accum_t;
+
+    typename CONFIG_T::accum_t acc[CONFIG_T::n_out];
+
+    #pragma HLS function_instantiate variable=weights,biases
+    #pragma HLS ARRAY_RESHAPE variable=weights block factor=block_factor
+    #pragma HLS RESOURCE variable=weights core=ROM_2P_BRAM
+    #pragma HLS ARRAY_PARTITION variable=biases complete
+    #pragma HLS ARRAY_PARTITION variable=acc complete
+
+    // Initialize accumulator with input biases
+    ResetAccum: for(int iacc = 0; iacc < CONFIG_T::n_out; iacc++) {
+        #pragma HLS UNROLL
+        acc[iacc] = (typename CONFIG_T::accum_t) biases[iacc];
+    }
+
+    // Each iteration reads one BRAM word and does block_factor multiplications,
+    // multscale consecutive ones (inputs ir, ir+reuse_factor, ...) per output
+    ReuseLoop: for(int ir = 0; ir < rufactor; ir++) {
+        #pragma HLS PIPELINE II=1 rewind
+        MultOut: for(int jj = 0; jj < CONFIG_T::n_out; jj++) {
+            #pragma HLS UNROLL
+            accum_t mult[multscale];
+            #pragma HLS ARRAY_PARTITION variable=mult complete
+            MultLoop: for(int im = 0; im < multscale; im++) {
+                #pragma HLS UNROLL
+                int w_index = ir + (jj*multscale + im)*rufactor;
+                mult[im] = data[ir + im*rufactor] * weights[w_index];
+                NNET_CHECK_OVERFLOW(CONFIG_T, "mult", accum_t, (double) data[ir + im*rufactor] * (double) weights[w_index]);
+            }
+            NNET_CHECK_SUM(CONFIG_T, "acc", accum_t, acc[jj], mult, multscale);
+            acc[jj] += adder_tree<accum_t, multscale, CONFIG_T::adder_tree_regs>(mult);
+        }
+    }
+
+    // Cast to "res_t" type
+    Result: for(int ires = 0; ires < CONFIG_T::n_out; ires++){
+        #pragma HLS UNROLL
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, acc[ires]);
+        res[ires] = (res_T) (acc[ires]);
+    }
+}
+
+ template<class data_T, class res_T, typename CONFIG_T>
+void compute_layer(
+    data_T    data[CONFIG_T::n_in],
+    res_T     res[CONFIG_T::n_out],
+    typename CONFIG_T::weight_t  weights[CONFIG_T::n_in*CONFIG_T::n_out],
+    typename CONFIG_T::bias_t    biases[CONFIG_T::n_out])
+{
+    #pragma HLS INLINE
+    if (CONFIG_T::strategy == resource) {
+        compute_layer_resource<data_T, res_T, CONFIG_T>(data, res, weights, biases);
+    } else {
+        compute_layer_latency<data_T, res_T, CONFIG_T>(data, res, weights, biases);
+    }
+}
+
+// Sparse layer: the writer drops the zero weights of pruned layers and emits
+// the remaining n_nonzeros as (row, col, weight) triplets, so there is exactly
+// one multiplication per nonzero weight. The reuse factor applies to the
+// number of nonzero weights instead of n_in*n_out. Each output sums the products
+// of its own weights through an adder tree: the products of the other outputs are
+// masked to zero, which folds away as the indices are constants.
+template<class data_T, class res_T, typename CONFIG_T>
+void compute_layer_sparse(
+    data_T    data[CONFIG_T::n_in],
+    res_T     res[CONFIG_T::n_out],
+    sparse_weight<typename CONFIG_T::weight_t, typename CONFIG_T::index_t> weights[CONFIG_T::n_nonzeros],
+    typename CONFIG_T::bias_t    biases[CONFIG_T::n_out])
+{
+    typename CONFIG_T::accum_t mult[CONFIG_T::n_nonzeros];
+    typename CONFIG_T::accum_t acc[CONFIG_T::n_out];
+
+    // Use a function_instantiate in case it helps to explicitly optimize unchanging weights/biases
+    #pragma HLS function_instantiate variable=weights,biases
+
+    #pragma HLS PIPELINE II=CONFIG_T::reuse_factor
+    #pragma HLS ARRAY_PARTITION variable=weights complete
+    #pragma HLS ARRAY_PARTITION variable=biases complete
+    #pragma HLS ARRAY_PARTITION variable=mult complete
+    #pragma HLS ARRAY_PARTITION variable=acc complete
+
+    int multiplier_limit  = ceil(float(CONFIG_T::n_nonzeros) / float(CONFIG_T::reuse_factor));
+    #pragma HLS ALLOCATION instances=mul limit=multiplier_limit operation
+
+    // The products of the nonzero weights only
+    SparseMult: for(int iw = 0; iw < CONFIG_T::n_nonzeros; iw++) {
+        mult[iw] = data[weights[iw].row_index] * weights[iw].weight;
+        NNET_CHECK_OVERFLOW(CONFIG_T, "mult", typename CONFIG_T::accum_t, (double) data[weights[iw].row_index] * (double) weights[iw].weight);
+    }
+
+    // One adder tree per output, starting from the bias
+    AccumTree: for(int jj = 0; jj < CONFIG_T::n_out; jj++) {
+        typename CONFIG_T::accum_t prod[CONFIG_T::n_nonzeros];
+        #pragma HLS ARRAY_PARTITION variable=prod complete
+        AccumGather: for(int iw = 0; iw < CONFIG_T::n_nonzeros; iw++) {
+            prod[iw] = weights[iw].col_index == jj ? mult[iw] : (typename CONFIG_T::accum_t) 0;
+        }
+        acc[jj] = (typename CONFIG_T::accum_t) biases[jj];
+        NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc[jj], prod, CONFIG_T::n_nonzeros);
+        acc[jj] += adder_tree<typename CONFIG_T::accum_t, CONFIG_T::n_nonzeros, CONFIG_T::adder_tree_regs>(prod);
+    }
+
+    // Cast to "res_t" type
+    Result: for(int ires = 0; ires < CONFIG_T::n_out; ires++){
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, acc[ires]);
+        res[ires] = (res_T) (acc[ires]);
+    }
+}
+
+// io_stream versions: the n_in inputs arrive as stream words of data_T::size values
+// (e.g. one pixel of a conv layer per word) and are gathered before the product,
+// the n_out results leave as words of res_T::size values
+template<class data_T, class res_T, typename CONFIG_T>
+void compute_layer(
+    hls::stream<data_T> &data,
+    hls::stream<res_T>  &res,
+    typename CONFIG_T::weight_t  weights[CONFIG_T::n_in*CONFIG_T::n_out],
+    typename CONFIG_T::bias_t    biases[CONFIG_T::n_out])
+{
+    typename data_T::value_type data_array[CONFIG_T::n_in];
+    typename res_T::value_type res_array[CONFIG_T::n_out];
+    #pragma HLS ARRAY_PARTITION variable=data_array complete
+    #pragma HLS ARRAY_PARTITION variable=res_array complete
+
+    read_stream_array<data_T, CONFIG_T::n_in>(data, data_array);
+    compute_layer<typename data_T::value_type, typename res_T::value_type, CONFIG_T>(data_array, res_array, weights, biases);
+    write_stream_array<res_T, CONFIG_T::n_out>(res_array, res);
+}
+
+template<class data_T, class res_T, typename CONFIG_T>
+void compute_layer_sparse(
+    hls::stream<data_T> &data,
+    hls::stream<res_T>  &res,
+    sparse_weight<typename CONFIG_T::weight_t, typename CONFIG_T::index_t> weights[CONFIG_T::n_nonzeros],
+    typename CONFIG_T::bias_t    biases[CONFIG_T::n_out])
+{
+    typename data_T::value_type data_array[CONFIG_T::n_in];
+    typename res_T::value_type res_array[CONFIG_T::n_out];
+    #pragma HLS ARRAY_PARTITION variable=data_array complete
+    #pragma HLS ARRAY_PARTITION variable=res_array complete
+
+    read_stream_array<data_T, CONFIG_T::n_in>(data, data_array);
+    compute_layer_sparse<typename data_T::value_type, typename res_T::value_type, CONFIG_T>(data_array, res_array, weights, biases);
+    write_stream_array<res_T, CONFIG_T::n_out>(res_array, res);
+}
+
 }
 
 #endif
@@ -0,0 +1,330 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef NNET_MERGE_H_
+#define NNET_MERGE_H_
+
+// Merge layers of functional Keras models (Add, Subtract, Multiply, Average, Maximum,
+// Minimum and Concatenate), which join the outputs of two branches. Each input has its
+// own type, the result is computed at full precision and cast to res_T once.
+
+#include "nnet_common.h"
+#include "nnet_csim.h"
+#include "hls_stream.h"
+
+namespace nnet {
+
+struct merge_config
+{
+    // Values of each input, and of the result
+    static const unsigned n_elem = 10;
+};
+
+// The inputs as n_outer blocks of n_elem1 and n_elem2 values, the result as the block of
+// the first input followed by that of the second one. The values before the axis make the
+// blocks and the values from the axis on fill them, e.g. for the last axis n_outer = 1 with
+// the channel major outputs of the io_parallel 2D layers, and the number of pixels with the
+// channels last words of io_stream.
+struct concat_config
+{
+    static const unsigned n_outer = 1;
+    static const unsigned n_elem1 = 10;
+    static const unsigned n_elem2 = 10;
+};
+
+// Half of x with one more fractional bit, so that the LSB is kept (a division by 2
+// keeps the fractional bits of x). nnet_fixed.h has the NNET_FAST_CSIM overload
+template<int W, int I, bool S, ap_q_mode Q, ap_o_mode O, int N>
+ap_fixed_base<W + 1, I, S> halve(ap_fixed_base<W, I, S, Q, O, N> x)
+{
+    return x * (ap_ufixed<1,0>) 0.5;
+}
+
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void add(
+    input1_T data1[CONFIG_T::n_elem],
+    input2_T data2[CONFIG_T::n_elem],
+    res_T    res[CONFIG_T::n_elem])
+{
+    #pragma HLS PIPELINE
+    Add: for (unsigned ii = 0; ii < CONFIG_T::n_elem; ii++) {
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, (double) data1[ii] + (double) data2[ii]);
+        res[ii] = (res_T) (data1[ii] + data2[ii]);
+    }
+}
+
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void subtract(
+    input1_T data1[CONFIG_T::n_elem],
+    input2_T data2[CONFIG_T::n_elem],
+    res_T    res[CONFIG_T::n_elem])
+{
+    #pragma HLS PIPELINE
+    Subtract: for (unsigned ii = 0; ii < CONFIG_T::n_elem; ii++) {
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, (double) data1[ii] - (double) data2[ii]);
+        res[ii] = (res_T) (data1[ii] - data2[ii]);
+    }
+}
+
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void multiply(
+    input1_T data1[CONFIG_T::n_elem],
+    input2_T data2[CONFIG_T::n_elem],
+    res_T    res[CONFIG_T::n_elem])
+{
+    #pragma HLS PIPELINE
+    Multiply: for (unsigned ii = 0; ii < CONFIG_T::n_elem; ii++) {
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, (double) data1[ii] * (double) data2[ii]);
+        res[ii] = (res_T) (data1[ii] * data2[ii]);
+    }
+}
+
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void average(
+    input1_T data1[CONFIG_T::n_elem],
+    input2_T data2[CONFIG_T::n_elem],
+    res_T    res[CONFIG_T::n_elem])
+{
+    #pragma HLS PIPELINE
+    Average: for (unsigned ii = 0; ii < CONFIG_T::n_elem; ii++) {
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, ((double) data1[ii] + (double) data2[ii]) / 2);
+        res[ii] = (res_T) halve(data1[ii] + data2[ii]);
+    }
+}
+
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void maximum(
+    input1_T data1[CONFIG_T::n_elem],
+    input2_T data2[CONFIG_T::n_elem],
+    res_T    res[CONFIG_T::n_elem])
+{
+    #pragma HLS PIPELINE
+    Maximum: for (unsigned ii = 0; ii < CONFIG_T::n_elem; ii++) {
+        res[ii] = (data1[ii] >= data2[ii]) ? (res_T) data1[ii] : (res_T) data2[ii];
+    }
+}
+
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void minimum(
+    input1_T data1[CONFIG_T::n_elem],
+    input2_T data2[CONFIG_T::n_elem],
+    res_T    res[CONFIG_T::n_elem])
+{
+    #pragma HLS PIPELINE
+    Minimum: for (unsigned ii = 0; ii < CONFIG_T::n_elem; ii++) {
+        res[ii] = (data1[ii] <= data2[ii]) ? (res_T) data1[ii] : (res_T) data2[ii];
+    }
+}
+
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void concat(
+    input1_T data1[CONFIG_T::n_outer * CONFIG_T::n_elem1],
+    input2_T data2[CONFIG_T::n_outer * CONFIG_T::n_elem2],
+    res_T    res[CONFIG_T::n_outer * (CONFIG_T::n_elem1 + CONFIG_T::n_elem2)])
+{
+    #pragma HLS PIPELINE
+    ConcatOuter: for (unsigned oo = 0; oo < CONFIG_T::n_outer; oo++) {
+        ConcatElem1: for (unsigned ii = 0; ii < CONFIG_T::n_elem1; ii++) {
+            res[oo * (CONFIG_T::n_elem1 + CONFIG_T::n_elem2) + ii] = (res_T) data1[oo * CONFIG_T::n_elem1 + ii];
+        }
+        ConcatElem2: for (unsigned ii = 0; ii < CONFIG_T::n_elem2; ii++) {
+            res[oo * (CONFIG_T::n_elem1 + CONFIG_T::n_elem2) + CONFIG_T::n_elem1 + ii] = (res_T) data2[oo * CONFIG_T::n_elem2 + ii];
+        }
+    }
+}
+
+// io_stream versions, one word of each input at a time. The element-wise merges need
+// words of the same size on both inputs.
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void add(
+    hls::stream<input1_T> &data1,
+    hls::stream<input2_T> &data2,
+    hls::stream<res_T>    &res)
+{
+    AddWord: for (unsigned i = 0; i < CONFIG_T::n_elem / res_T::size; i++) {
+        #pragma HLS PIPELINE
+        input1_T in_word1 = data1.read();
+        input2_T in_word2 = data2.read();
+        res_T out_word;
+        Add: for (unsigned jj = 0; jj < res_T::size; jj++) {
+            #pragma HLS UNROLL
+            NNET_CHECK_OVERFLOW(CONFIG_T, "result", typename res_T::value_type, (double) in_word1[jj] + (double) in_word2[jj]);
+            out_word[jj] = (typename res_T::value_type) (in_word1[jj] + in_word2[jj]);
+        }
+        res.write(out_word);
+    }
+}
+
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void subtract(
+    hls::stream<input1_T> &data1,
+    hls::stream<input2_T> &data2,
+    hls::stream<res_T>    &res)
+{
+    SubtractWord: for (unsigned i = 0; i < CONFIG_T::n_elem / res_T::size; i++) {
+        #pragma HLS PIPELINE
+        input1_T in_word1 = data1.read();
+        input2_T in_word2 = data2.read();
+        res_T out_word;
+        Subtract: for (unsigned jj = 0; jj < res_T::size; jj++) {
+            #pragma HLS UNROLL
+            NNET_CHECK_OVERFLOW(CONFIG_T, "result", typename res_T::value_type, (double) in_word1[jj] - (double) in_word2[jj]);
+            out_word[jj] = (typename res_T::value_type) (in_word1[jj] - in_word2[jj]);
+        }
+        res.write(out_word);
+    }
+}
+
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void multiply(
+    hls::stream<input1_T> &data1,
+    hls::stream<input2_T> &data2,
+    hls::stream<res_T>    &res)
+{
+    MultiplyWord: for (unsigned i = 0; i < CONFIG_T::n_elem / res_T::size; i++) {
+        #pragma HLS PIPELINE
+        input1_T in_word1 = data1.read();
+        input2_T in_word2 = data2.read();
+        res_T out_word;
+        Multiply: for (unsigned jj = 0; jj < res_T::size; jj++) {
+            #pragma HLS UNROLL
+            NNET_CHECK_OVERFLOW(CONFIG_T, "result", typename res_T::value_type, (double) in_word1[jj] * (double) in_word2[jj]);
+            out_word[jj] = (typename res_T::value_type) (in_word1[jj] * in_word2[jj]);
+        }
+        res.write(out_word);
+    }
+}
+
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void average(
+    hls::stream<input1_T> &data1,
+    hls::stream<input2_T> &data2,
+    hls::stream<res_T>    &res)
+{
+    AverageWord: for (unsigned i = 0; i < CONFIG_T::n_elem / res_T::size; i++) {
+        #pragma HLS PIPELINE
+        input1_T in_word1 = data1.read();
+        input2_T in_word2 = data2.read();
+        res_T out_word;
+        Average: for (unsigned jj = 0; jj < res_T::size; jj++) {
+            #pragma HLS UNROLL
+            NNET_CHECK_OVERFLOW(CONFIG_T, "result", typename res_T::value_type, ((double) in_word1[jj] + (double) in_word2[jj]) / 2);
+            out_word[jj] = (typename res_T::value_type) halve(in_word1[jj] + in_word2[jj]);
+        }
+        res.write(out_word);
+    }
+}
+
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void maximum(
+    hls::stream<input1_T> &data1,
+    hls::stream<input2_T> &data2,
+    hls::stream<res_T>    &res)
+{
+    MaximumWord: for (unsigned i = 0; i < CONFIG_T::n_elem / res_T::size; i++) {
+        #pragma HLS PIPELINE
+        input1_T in_word1 = data1.read();
+        input2_T in_word2 = data2.read();
+        res_T out_word;
+        Maximum: for (unsigned jj = 0; jj < res_T::size; jj++) {
+            #pragma HLS UNROLL
+            out_word[jj] = (in_word1[jj] >= in_word2[jj]) ? (typename res_T::value_type) in_word1[jj] : (typename res_T::value_type) in_word2[jj];
+        }
+        res.write(out_word);
+    }
+}
+
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void minimum(
+    hls::stream<input1_T> &data1,
+    hls::stream<input2_T> &data2,
+    hls::stream<res_T>    &res)
+{
+    MinimumWord: for (unsigned i = 0; i < CONFIG_T::n_elem / res_T::size; i++) {
+        #pragma HLS PIPELINE
+        input1_T in_word1 = data1.read();
+        input2_T in_word2 = data2.read();
+        res_T out_word;
+        Minimum: for (unsigned jj = 0; jj < res_T::size; jj++) {
+            #pragma HLS UNROLL
+            out_word[jj] = (in_word1[jj] <= in_word2[jj]) ? (typename res_T::value_type) in_word1[jj] : (typename res_T::value_type) in_word2[jj];
+        }
+        res.write(out_word);
+    }
+}
+
+// Concatenation along the last axis: a block is one word of each input, the result word
+// holds both. Along the other axes the words are whole pixels of the same size on both
+// inputs and pass through, see concat_words.
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void concat(
+    hls::stream<input1_T> &data1,
+    hls::stream<input2_T> &data2,
+    hls::stream<res_T>    &res)
+{
+    ConcatWord: for (unsigned oo = 0; oo < CONFIG_T::n_outer; oo++) {
+        #pragma HLS PIPELINE
+        input1_T in_word1 = data1.read();
+        input2_T in_word2 = data2.read();
+        res_T out_word;
+        ConcatElem1: for (unsigned jj = 0; jj < input1_T::size; jj++) {
+            #pragma HLS UNROLL
+            out_word[jj] = (typename res_T::value_type) in_word1[jj];
+        }
+        ConcatElem2: for (unsigned jj = 0; jj < input2_T::size; jj++) {
+            #pragma HLS UNROLL
+            out_word[input1_T::size + jj] = (typename res_T::value_type) in_word2[jj];
+        }
+        res.write(out_word);
+    }
+}
+
+template<class input1_T, class input2_T, class res_T, typename CONFIG_T>
+void concat_words(
+    hls::stream<input1_T> &data1,
+    hls::stream<input2_T> &data2,
+    hls::stream<res_T>    &res)
+{
+    ConcatOuter: for (unsigned oo = 0; oo < CONFIG_T::n_outer; oo++) {
+        ConcatWords1: for (unsigned i = 0; i < CONFIG_T::n_elem1 / input1_T::size; i++) {
+            #pragma HLS PIPELINE
+            input1_T in_word = data1.read();
+            res_T out_word;
+            ConcatElem1: for (unsigned jj = 0; jj < res_T::size; jj++) {
+                #pragma HLS UNROLL
+                out_word[jj] = (typename res_T::value_type) in_word[jj];
+            }
+            res.write(out_word);
+        }
+        ConcatWords2: for (unsigned i = 0; i < CONFIG_T::n_elem2 / input2_T::size; i++) {
+            #pragma HLS PIPELINE
+            input2_T in_word = data2.read();
+            res_T out_word;
+            ConcatElem2: for (unsigned jj = 0; jj < res_T::size; jj++) {
+                #pragma HLS UNROLL
+                out_word[jj] = (typename res_T::value_type) in_word[jj];
+            }
+            res.write(out_word);
+        }
+    }
+}
+
+}
+
+#endif
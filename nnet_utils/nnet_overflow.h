@@ -0,0 +1,218 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef NNET_OVERFLOW_H_
+#define NNET_OVERFLOW_H_
+
+// Host side only: overflow counters of the C model. Compiling with -DNNET_CHECK_OVERFLOWS
+// makes the NNET_CHECK_* macros of the kernels (see nnet_csim.h) compute the exact value
+// of each product (mult), sum (acc) and result cast (result) in double precision and count
+// the values out of the range of their type, which wrap (AP_WRAP) or saturate (AP_SAT*).
+// The checks are per stage: each one computes its operation exactly from the operands the
+// kernel actually holds, e.g. the sum from the products already cast to accum_t and the
+// result from the stored accumulator. A value that wraps is counted at the stage where it
+// wraps, and the later stages see the wrapped value as the hardware does.
+// The activations count the lookup table indices clipped to the table (table_index, and
+// invert_index for the reciprocal table of softmax). The counters are kept per layer, named
+// after its config struct, and per variable, and are printed to stderr at exit along with
+// the largest magnitude seen, so that the integer bits of each type can be compared with
+// the bits the values need.
+
+#include <list>
+#include <cmath>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <limits>
+#include <typeinfo>
+#include <iostream>
+#include <iomanip>
+#include <stdlib.h>
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+#include "ap_int.h"
+#include "ap_fixed.h"
+
+namespace nnet {
+
+// Range of the values of a type: floats and unknown types never overflow
+template<class T> struct overflow_void { typedef void type; };
+
+template<class T, class Enable = void>
+struct overflow_range
+{
+    static const bool saturates = false;
+    static const int int_bits = 0;
+    static double min() { return -std::numeric_limits<double>::infinity(); }
+    static double max() { return std::numeric_limits<double>::infinity(); }
+};
+
+// ap_fixed and ap_ufixed, and the nnet::fixed types that replace them with NNET_FAST_CSIM
+template<class T>
+struct overflow_range<T, typename overflow_void<decltype(T::iwidth)>::type>
+{
+    static const bool saturates = T::omode == AP_SAT || T::omode == AP_SAT_ZERO || T::omode == AP_SAT_SYM;
+    static const int int_bits = T::iwidth;
+    static double min() { return T::sign_flag ? -std::ldexp(1.0, T::iwidth - 1) : 0; }
+    static double max() { return std::ldexp(1.0, T::iwidth - (T::sign_flag ? 1 : 0)) - std::ldexp(1.0, T::iwidth - T::width); }
+};
+
+template<int W>
+struct overflow_range<ap_int<W> >
+{
+    static const bool saturates = false;
+    static const int int_bits = W;
+    static double min() { return -std::ldexp(1.0, W - 1); }
+    static double max() { return std::ldexp(1.0, W - 1) - 1; }
+};
+
+template<int W>
+struct overflow_range<ap_uint<W> >
+{
+    static const bool saturates = false;
+    static const int int_bits = W;
+    static double min() { return 0; }
+    static double max() { return std::ldexp(1.0, W) - 1; }
+};
+
+struct overflow_counter
+{
+    std::string layer;
+    std::string variable;
+    // Range of the type, the bounds are infinite for the table indices
+    double min, max;
+    bool saturates;
+    int int_bits;
+    std::atomic<unsigned long long> n_checked;
+    std::atomic<unsigned long long> n_overflows;
+    std::atomic<double> max_abs;
+
+    overflow_counter(const std::string &layer, const char *variable, double min, double max, bool saturates, int int_bits)
+        : layer(layer), variable(variable), min(min), max(max), saturates(saturates), int_bits(int_bits),
+          n_checked(0), n_overflows(0), max_abs(0) {}
+
+    template<class T>
+    void check(const T &value)
+    {
+        double x = (double) value;
+        n_checked++;
+        if (x < min || x > max) n_overflows++;
+        double a = std::fabs(x);
+        double prev = max_abs.load();
+        while (a > prev && !max_abs.compare_exchange_weak(prev, a));
+    }
+
+    void count(bool clipped)
+    {
+        n_checked++;
+        if (clipped) n_overflows++;
+    }
+};
+
+inline std::ostream &operator<<(std::ostream &os, const overflow_counter &counter)
+{
+    os << std::left << std::setw(28) << counter.layer << std::setw(12) << counter.variable << std::right
+       << std::setw(14) << counter.n_checked << std::setw(12) << counter.n_overflows;
+    if (counter.n_overflows > 0) {
+        const char *kind = counter.int_bits == 0 ? "clipped" : counter.saturates ? "saturated" : "wrapped";
+        os << " " << kind << " (" << std::setprecision(3) << 100. * counter.n_overflows / counter.n_checked << "%)";
+    }
+    if (counter.int_bits != 0) {
+        // Integer bits of the type, and those that hold the largest magnitude with the sign,
+        // at least the sign bit for small magnitudes
+        int sign_bits = counter.min < 0 ? 1 : 0;
+        int needed = counter.max_abs > 0 ? (int) std::floor(std::log2((double) counter.max_abs)) + 1 + sign_bits : sign_bits;
+        if (needed < sign_bits) needed = sign_bits;
+        os << "  max |x| " << std::setprecision(6) << counter.max_abs << ", int bits " << counter.int_bits << " used " << needed;
+    }
+    return os;
+}
+
+struct overflow_registry
+{
+    std::mutex lock;
+    // In the order of the first check, i.e. of the layers. A list keeps the counters in place
+    std::list<overflow_counter> counters;
+
+    ~overflow_registry()
+    {
+        if (counters.empty()) return;
+        std::cerr << "Overflows of the C simulation (values checked, out of the range of their type):" << std::endl;
+        for (std::list<overflow_counter>::const_iterator it = counters.begin(); it != counters.end(); ++it) {
+            std::cerr << *it << std::endl;
+        }
+    }
+};
+
+inline overflow_registry &get_overflow_registry()
+{
+    static overflow_registry registry;
+    return registry;
+}
+
+template<class CONFIG_T>
+std::string overflow_layer_name()
+{
+    // The config struct of the layer, e.g. config3
+    std::string layer = typeid(CONFIG_T).name();
+#ifdef __GNUG__
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(layer.c_str(), 0, 0, &status);
+    if (status == 0 && demangled) {
+        layer = demangled;
+        free(demangled);
+    }
+#endif
+    // The configs of the stream kernels that wrap a layer config, e.g.
+    // nnet::activ_word_config<tanh_config4, 3u>, are named after the layer config
+    size_t begin = layer.find('<');
+    if (begin != std::string::npos) {
+        size_t end = layer.find_first_of(",>", begin);
+        layer = layer.substr(begin + 1, end - begin - 1);
+    }
+    return layer;
+}
+
+// Safe to call from the worker threads of run_batch. The kernels keep the returned
+// counter in a static variable, so this runs once per layer and variable
+template<class CONFIG_T, class T>
+overflow_counter &get_overflow_counter(const char *variable)
+{
+    overflow_registry &registry = get_overflow_registry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    registry.counters.emplace_back(overflow_layer_name<CONFIG_T>(), variable, overflow_range<T>::min(), overflow_range<T>::max(),
+                                   overflow_range<T>::saturates, overflow_range<T>::int_bits);
+    return registry.counters.back();
+}
+
+// Exact value of init plus the n values of x
+template<class init_T, class data_T>
+double overflow_sum(const init_T &init, const data_T *x, unsigned n)
+{
+    double sum = (double) init;
+    for (unsigned ii = 0; ii < n; ii++) {
+        sum += (double) x[ii];
+    }
+    return sum;
+}
+
+}
+
+#endif
@@ -1,7 +1,9 @@
 #ifndef NNET_POOLING_H_
 #define NNET_POOLING_H_
 
-#include "nnet_helpers.h"
+#include "nnet_common.h"
+#include "nnet_csim.h"
+#include "nnet_stream.h"
 
 namespace nnet{
 
@@ -143,22 +145,22 @@ void pooling2d(data_T data[CONFIG_T::in_height][CONFIG_T::in_width][CONFIG_T::n_
   const unsigned padded_width = CONFIG_T::in_width + CONFIG_T::pad_left + CONFIG_T::pad_right;
 
   for(int ff = 0; ff < CONFIG_T::n_filt; ff++){
-	  // Loop over input image y in steps of stride
-	  for(int ii = 0; ii < padded_height; ii += CONFIG_T::stride_height){
+	  // Loop over input image y in steps of stride, one output per pool window
+	  for(int ii = 0; ii < CONFIG_T::out_height * CONFIG_T::stride_height; ii += CONFIG_T::stride_height){
 		  // Loop over input image x in steps of stride
-		  for(int jj = 0; jj < padded_width; jj += CONFIG_T::stride_width){
+		  for(int jj = 0; jj < CONFIG_T::out_width * CONFIG_T::stride_width; jj += CONFIG_T::stride_width){
 			  data_T pool[CONFIG_T::pool_height * CONFIG_T::pool_width];
         // Keep track of number of pixels in image vs padding region
         unsigned img_overlap = 0;
 			  // Loop over pool window y
-			  for(int kk = 0; kk < CONFIG_T::stride_height; kk++){
+			  for(int kk = 0; kk < CONFIG_T::pool_height; kk++){
 				  // Loop over pool window x
-				  for(int ll = 0; ll < CONFIG_T::stride_width; ll++){
+				  for(int ll = 0; ll < CONFIG_T::pool_width; ll++){
             if(ii+kk < CONFIG_T::pad_top || ii+kk >= (padded_height - CONFIG_T::pad_bottom) || jj+ll < CONFIG_T::pad_left || jj+ll >= (padded_width - CONFIG_T::pad_right)){
               // Add padding
-              pool[kk * CONFIG_T::stride_width + ll] = 0;
+              pool[kk * CONFIG_T::pool_width + ll] = 0;
             }else{
-  					  pool[kk * CONFIG_T::stride_width + ll] = data[ii + kk][jj + ll][ff];
+  					  pool[kk * CONFIG_T::pool_width + ll] = data[ii + kk - CONFIG_T::pad_top][jj + ll - CONFIG_T::pad_left][ff];
               img_overlap++;
             }
 				  }
@@ -178,6 +180,184 @@ void pooling2d(data_T data[CONFIG_T::in_height][CONFIG_T::in_width][CONFIG_T::n_
   }
 }
 
+// Streaming pooling2d. Pixels arrive in raster order, one word of n_filt values per
+// stream word, and the pooled pixel is written as soon as its window is complete.
+// Only pool_height-1 rows are kept in a line buffer (see shift_line_buffer_2d), so
+// the pool windows can overlap (pool size larger than the stride). Padded cells
+// are ignored, as in Keras: the pad_val of the operation fills them for Max, and
+// Average divides by the number of cells in the image.
+template<class data_T, class res_T, typename CONFIG_T>
+void pooling2d_stream(
+        hls::stream<data_T> &data,
+        hls::stream<res_T>  &res)
+{
+  typedef typename data_T::value_type pixel_t;
+  const unsigned pool_size = CONFIG_T::pool_height * CONFIG_T::pool_width;
+  const unsigned padded_height = CONFIG_T::in_height + CONFIG_T::pad_top + CONFIG_T::pad_bottom;
+  const unsigned padded_width = CONFIG_T::in_width + CONFIG_T::pad_left + CONFIG_T::pad_right;
+  // Keep at least one row so pool_height == 1 still gives a valid declaration
+  const unsigned buffer_rows = CONFIG_T::pool_height > 1 ? CONFIG_T::pool_height - 1 : 1;
+
+  pixel_t line_buffer[buffer_rows][padded_width][CONFIG_T::n_filt];
+  pixel_t window[CONFIG_T::pool_height][CONFIG_T::pool_width][CONFIG_T::n_filt];
+
+  #pragma HLS ARRAY_PARTITION variable=line_buffer complete dim=1
+  #pragma HLS ARRAY_PARTITION variable=line_buffer complete dim=3
+  #pragma HLS ARRAY_PARTITION variable=window complete dim=0
+
+  // Position of the window relative to the stride grid
+  unsigned stride_row = 0;
+
+  PoolRow: for(unsigned ih = 0; ih < padded_height; ih++) {
+    unsigned stride_col = 0;
+    PoolCol: for(unsigned iw = 0; iw < padded_width; iw++) {
+      #pragma HLS PIPELINE
+
+      // Read the next pixel, or insert padding
+      data_T pixel;
+      if (ih < CONFIG_T::pad_top || ih >= CONFIG_T::pad_top + CONFIG_T::in_height
+       || iw < CONFIG_T::pad_left || iw >= CONFIG_T::pad_left + CONFIG_T::in_width) {
+        PadFilt: for(unsigned ff = 0; ff < CONFIG_T::n_filt; ff++) {
+          pixel[ff] = pad_val<pixel_t, CONFIG_T::pool_op>();
+        }
+      } else {
+        pixel = data.read();
+      }
+
+      shift_line_buffer_2d<data_T, CONFIG_T::pool_height, CONFIG_T::pool_width, padded_width>(pixel, iw, line_buffer, window);
+
+      // Once the window covers a full pool on the stride grid, pool every filter
+      if (ih + 1 >= CONFIG_T::pool_height && iw + 1 >= CONFIG_T::pool_width && stride_row == 0 && stride_col == 0) {
+        // Cells of the window in the image, the window ends at (ih, iw)
+        unsigned img_overlap = 0;
+        OverlapHeight: for(unsigned kk = 0; kk < CONFIG_T::pool_height; kk++) {
+          OverlapWidth: for(unsigned ll = 0; ll < CONFIG_T::pool_width; ll++) {
+            unsigned ph = ih + 1 - CONFIG_T::pool_height + kk;
+            unsigned pw = iw + 1 - CONFIG_T::pool_width + ll;
+            if (ph >= CONFIG_T::pad_top && ph < CONFIG_T::pad_top + CONFIG_T::in_height
+             && pw >= CONFIG_T::pad_left && pw < CONFIG_T::pad_left + CONFIG_T::in_width) {
+              img_overlap++;
+            }
+          }
+        }
+
+        res_T out_pixel;
+        PoolFilt: for(unsigned ff = 0; ff < CONFIG_T::n_filt; ff++) {
+          pixel_t pool[pool_size];
+          PoolHeight: for(unsigned kk = 0; kk < CONFIG_T::pool_height; kk++) {
+            PoolWidth: for(unsigned ll = 0; ll < CONFIG_T::pool_width; ll++) {
+              pool[kk * CONFIG_T::pool_width + ll] = window[kk][ll][ff];
+            }
+          }
+          pixel_t pooled = pool_op<pixel_t, pool_size, CONFIG_T::pool_op>(pool);
+          // The padding added zeros to the average
+          if (CONFIG_T::pool_op == Average && img_overlap < pool_size) {
+            pooled = pooled * pool_size / img_overlap;
+          }
+          out_pixel[ff] = (typename res_T::value_type) pooled;
+        }
+        res.write(out_pixel);
+      }
+
+      // Advance the stride position, only once the first full window is reached
+      if (iw + 1 >= CONFIG_T::pool_width) {
+        stride_col = (stride_col + 1 == CONFIG_T::stride_width) ? 0 : stride_col + 1;
+      }
+    }//end column loop
+    if (ih + 1 >= CONFIG_T::pool_height) {
+      stride_row = (stride_row + 1 == CONFIG_T::stride_height) ? 0 : stride_row + 1;
+    }
+  }//end row loop
+}
+
+struct global_pooling_config{
+  // IO size
+  static const unsigned n_in = 10; // pixels
+  static const unsigned n_filt = 4;
+  // Layout of the flattened input of the array kernel, filter ff of pixel ii is at
+  // data[ff * n_in + ii] (nnet::flatten of the 2D layers) or data[ii * n_filt + ff]
+  static const bool filt_major = false;
+  // Pooling function
+  static const Pool_Op pool_op = Average;
+  // Sum of the average, and the 1/n_in it is multiplied by, which needs its own fractional
+  // bits (ap_ufixed<18, 1 - floor(log2(n_in)), AP_RND> is exact for powers of two)
+  typedef float accum_t;
+  typedef float scale_t;
+};
+
+// Global pooling: one value per filter, the max or the average over all the pixels.
+// The pixels of each filter go through a comparator or adder tree (see nnet::reduce),
+// the average multiplies the sum by 1/n_in instead of dividing it.
+template<class data_T, class res_T, typename CONFIG_T>
+void global_pooling(
+        data_T data[CONFIG_T::n_in * CONFIG_T::n_filt],
+        res_T  res[CONFIG_T::n_filt])
+{
+  typedef typename CONFIG_T::accum_t accum_t;
+  const typename CONFIG_T::scale_t scale = 1.0 / CONFIG_T::n_in;
+
+  GlobalFilt: for(unsigned ff = 0; ff < CONFIG_T::n_filt; ff++){
+    data_T pool[CONFIG_T::n_in];
+    accum_t acc[CONFIG_T::n_in];
+    GlobalPixel: for(unsigned ii = 0; ii < CONFIG_T::n_in; ii++){
+      unsigned index = CONFIG_T::filt_major ? ff * CONFIG_T::n_in + ii : ii * CONFIG_T::n_filt + ff;
+      pool[ii] = data[index];
+      acc[ii] = data[index];
+    }
+    if(CONFIG_T::pool_op == Max){
+      res[ff] = (res_T) reduce<data_T, CONFIG_T::n_in, Op_max<data_T> >(pool, Op_max<data_T>());
+    }else{
+      NNET_CHECK_SUM(CONFIG_T, "acc", accum_t, 0, acc, CONFIG_T::n_in);
+      NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, ((double) reduce<accum_t, CONFIG_T::n_in, Op_add<accum_t> >(acc, Op_add<accum_t>()) / CONFIG_T::n_in));
+      res[ff] = (res_T) (reduce<accum_t, CONFIG_T::n_in, Op_add<accum_t> >(acc, Op_add<accum_t>()) * scale);
+    }
+  }
+}
+
+// Streaming global pooling: reads the n_in pixels of an event, one word of n_filt
+// values each, and writes a single word with the max or the average of every filter
+template<class data_T, class res_T, typename CONFIG_T>
+void global_pooling_stream(
+        hls::stream<data_T> &data,
+        hls::stream<res_T>  &res)
+{
+  typedef typename data_T::value_type pixel_t;
+  typedef typename CONFIG_T::accum_t accum_t;
+  const typename CONFIG_T::scale_t scale = 1.0 / CONFIG_T::n_in;
+
+  pixel_t pool[CONFIG_T::n_filt];
+  accum_t acc[CONFIG_T::n_filt];
+  #pragma HLS ARRAY_PARTITION variable=pool complete
+  #pragma HLS ARRAY_PARTITION variable=acc complete
+
+  GlobalPixel: for(unsigned ii = 0; ii < CONFIG_T::n_in; ii++){
+    #pragma HLS PIPELINE
+    data_T pixel = data.read();
+    GlobalFilt: for(unsigned ff = 0; ff < CONFIG_T::n_filt; ff++){
+      if(ii == 0){
+        pool[ff] = pixel[ff];
+        acc[ff] = pixel[ff];
+      }else{
+        pool[ff] = pixel[ff] > pool[ff] ? pixel[ff] : pool[ff];
+        NNET_CHECK_OVERFLOW(CONFIG_T, "acc", accum_t, (double) acc[ff] + (double) pixel[ff]);
+        acc[ff] += pixel[ff];
+      }
+    }
+  }
+
+  res_T out_pixel;
+  GlobalOut: for(unsigned ff = 0; ff < CONFIG_T::n_filt; ff++){
+    #pragma HLS UNROLL
+    if(CONFIG_T::pool_op == Max){
+      out_pixel[ff] = (typename res_T::value_type) pool[ff];
+    }else{
+      NNET_CHECK_OVERFLOW(CONFIG_T, "result", typename res_T::value_type, (double) acc[ff] / CONFIG_T::n_in);
+      out_pixel[ff] = (typename res_T::value_type) (acc[ff] * scale);
+    }
+  }
+  res.write(out_pixel);
+}
+
 }
 
 #endif
@@ -0,0 +1,297 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef NNET_SEPCONV2D_H_
+#define NNET_SEPCONV2D_H_
+
+// Depthwise-separable conv2d, as in Keras SeparableConv2D: a depthwise conv2d that
+// filters every input channel on its own, followed by a pointwise (1x1) conv2d that
+// mixes the channels. Compared to conv_2d this takes filt_height*filt_width*n_chan*n_filt
+// multiplications per output pixel down to filt_height*filt_width*n_chan*depth_multiplier
+// + n_chan*depth_multiplier*n_filt.
+
+#include "nnet_common.h"
+#include "nnet_csim.h"
+#include "nnet_conv2d.h"
+#include "hls_stream.h"
+
+namespace nnet {
+
+struct depthwise_conv2d_config
+{
+    // Internal data type definitions
+    typedef float bias_t;
+    typedef float weight_t;
+    typedef float accum_t;
+
+    // Convolutional parameters
+    static const unsigned pad_top = 0;
+    static const unsigned pad_bottom = 0;
+    static const unsigned pad_left = 0;
+    static const unsigned pad_right = 0;
+    static const unsigned in_height = 128;
+    static const unsigned in_width = 128;
+    static const unsigned n_chan = 9;
+    static const unsigned filt_height = 3;
+    static const unsigned filt_width = 3;
+    static const unsigned depth_multiplier = 1;
+    static const unsigned n_filt = 9; // n_chan * depth_multiplier
+    static const unsigned stride_height = 1;
+    static const unsigned stride_width = 1;
+    static const unsigned out_height = 126;
+    static const unsigned out_width = 126;
+
+    static const unsigned reuse_factor = 1;
+    static const bool store_weights_in_bram = false;
+    static const unsigned n_zeros = 0; // not used yet
+    // Pipeline registers after each level of the adder trees, see nnet::adder_tree
+    static const unsigned adder_tree_regs = 0;
+};
+
+struct pointwise_conv2d_config
+{
+    // Internal data type definitions
+    typedef float bias_t;
+    typedef float weight_t;
+    typedef float accum_t;
+
+    // Convolutional parameters, always a 1x1 filter with stride 1 and no padding
+    static const unsigned in_height = 128;
+    static const unsigned in_width = 128;
+    static const unsigned n_chan = 9;
+    static const unsigned n_filt = 16;
+
+    static const unsigned reuse_factor = 1;
+    static const bool store_weights_in_bram = false;
+    static const unsigned n_zeros = 0; // not used yet
+    // Pipeline registers after each level of the adder trees, see nnet::adder_tree
+    static const unsigned adder_tree_regs = 0;
+};
+
+// Output filter ff of the depthwise conv2d is the filter ff % depth_multiplier of
+// input channel ff / depth_multiplier. The weights are in the Keras layout
+// [filt_height][filt_width][n_chan][depth_multiplier], i.e. weight ff of filter
+// position (fh, fw) is at (fh*filt_width + fw)*n_filt + ff.
+template<class data_T, class res_T, typename CONFIG_T>
+void depthwise_conv_2d(
+             data_T   data[CONFIG_T::in_height][CONFIG_T::in_width][CONFIG_T::n_chan],
+             res_T    res[CONFIG_T::out_height][CONFIG_T::out_width][CONFIG_T::n_filt],
+             typename CONFIG_T::weight_t  weights[CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_filt],
+             typename CONFIG_T::bias_t    biases[CONFIG_T::n_filt])
+{
+    // Use a function_instantiate in case it helps to explicitly optimize unchanging weights/biases
+    #pragma HLS function_instantiate variable=weights,biases
+
+    // Limit multipliers to the products of one output pixel, folded by the reuse factor
+    const int multiplier_limit = (CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_filt + CONFIG_T::reuse_factor - 1) / CONFIG_T::reuse_factor;
+    #pragma HLS ALLOCATION instances=mul limit=multiplier_limit operation
+
+    DepthOutHeight: for(int oh = 0; oh < CONFIG_T::out_height; oh++) {
+      DepthOutWidth: for(int ow = 0; ow < CONFIG_T::out_width; ow++) {
+        #pragma HLS PIPELINE II=CONFIG_T::reuse_factor
+        DepthFilt: for(int ff = 0; ff < CONFIG_T::n_filt; ff++) {
+          int cc = ff / CONFIG_T::depth_multiplier;
+          typename CONFIG_T::accum_t mult[CONFIG_T::filt_height * CONFIG_T::filt_width];
+          DepthFiltHeight: for(int fh = 0; fh < CONFIG_T::filt_height; fh++) {
+            DepthFiltWidth: for(int fw = 0; fw < CONFIG_T::filt_width; fw++) {
+              int ih = oh*CONFIG_T::stride_height + fh - CONFIG_T::pad_top;
+              int iw = ow*CONFIG_T::stride_width + fw - CONFIG_T::pad_left;
+              // Zero padding adds nothing
+              if (ih >= 0 && ih < CONFIG_T::in_height && iw >= 0 && iw < CONFIG_T::in_width) {
+                mult[fh*CONFIG_T::filt_width + fw] = data[ih][iw][cc] * weights[(fh*CONFIG_T::filt_width + fw)*CONFIG_T::n_filt + ff];
+                NNET_CHECK_OVERFLOW(CONFIG_T, "mult", typename CONFIG_T::accum_t, (double) data[ih][iw][cc] * (double) weights[(fh*CONFIG_T::filt_width + fw)*CONFIG_T::n_filt + ff]);
+              } else {
+                mult[fh*CONFIG_T::filt_width + fw] = 0;
+              }
+            }
+          }
+          typename CONFIG_T::accum_t acc = biases[ff];
+          NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc, mult, CONFIG_T::filt_height * CONFIG_T::filt_width);
+          acc += adder_tree<typename CONFIG_T::accum_t, CONFIG_T::filt_height * CONFIG_T::filt_width, CONFIG_T::adder_tree_regs>(mult);
+          NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, acc);
+          res[oh][ow][ff] = (res_T) acc;
+        }
+      }
+    }
+}//end depthwise_conv_2d
+
+
+// Weights in the Keras layout [n_chan][n_filt] of the 1x1 filter
+template<class data_T, class res_T, typename CONFIG_T>
+void pointwise_conv_2d(
+             data_T   data[CONFIG_T::in_height][CONFIG_T::in_width][CONFIG_T::n_chan],
+             res_T    res[CONFIG_T::in_height][CONFIG_T::in_width][CONFIG_T::n_filt],
+             typename CONFIG_T::weight_t  weights[CONFIG_T::n_chan * CONFIG_T::n_filt],
+             typename CONFIG_T::bias_t    biases[CONFIG_T::n_filt])
+{
+    // Use a function_instantiate in case it helps to explicitly optimize unchanging weights/biases
+    #pragma HLS function_instantiate variable=weights,biases
+
+    // Limit multipliers to the products of one output pixel, folded by the reuse factor
+    const int multiplier_limit = (CONFIG_T::n_chan * CONFIG_T::n_filt + CONFIG_T::reuse_factor - 1) / CONFIG_T::reuse_factor;
+    #pragma HLS ALLOCATION instances=mul limit=multiplier_limit operation
+
+    PointHeight: for(int oh = 0; oh < CONFIG_T::in_height; oh++) {
+      PointWidth: for(int ow = 0; ow < CONFIG_T::in_width; ow++) {
+        #pragma HLS PIPELINE II=CONFIG_T::reuse_factor
+        PointFilt: for(int ff = 0; ff < CONFIG_T::n_filt; ff++) {
+          typename CONFIG_T::accum_t mult[CONFIG_T::n_chan];
+          PointChan: for(int cc = 0; cc < CONFIG_T::n_chan; cc++) {
+            mult[cc] = data[oh][ow][cc] * weights[cc*CONFIG_T::n_filt + ff];
+            NNET_CHECK_OVERFLOW(CONFIG_T, "mult", typename CONFIG_T::accum_t, (double) data[oh][ow][cc] * (double) weights[cc*CONFIG_T::n_filt + ff]);
+          }
+          typename CONFIG_T::accum_t acc = biases[ff];
+          NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc, mult, CONFIG_T::n_chan);
+          acc += adder_tree<typename CONFIG_T::accum_t, CONFIG_T::n_chan, CONFIG_T::adder_tree_regs>(mult);
+          NNET_CHECK_OVERFLOW(CONFIG_T, "result", res_T, acc);
+          res[oh][ow][ff] = (res_T) acc;
+        }
+      }
+    }
+}//end pointwise_conv_2d
+
+
+// Streaming depthwise conv2d, pixels in raster order with one nnet::array of n_chan
+// values per stream word in, n_filt values per output pixel out. Same line buffer
+// and padding as conv_2d_stream, only the filters of the window are depthwise.
+template<class data_T, class res_T, typename CONFIG_T>
+void depthwise_conv_2d_stream(
+             hls::stream<data_T> &data,
+             hls::stream<res_T>  &res,
+             typename CONFIG_T::weight_t  weights[CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_filt],
+             typename CONFIG_T::bias_t    biases[CONFIG_T::n_filt])
+{
+    const unsigned padded_height = CONFIG_T::in_height + CONFIG_T::pad_top + CONFIG_T::pad_bottom;
+    const unsigned padded_width = CONFIG_T::in_width + CONFIG_T::pad_left + CONFIG_T::pad_right;
+    // Keep at least one row so filt_height == 1 still gives a valid declaration
+    const unsigned buffer_rows = CONFIG_T::filt_height > 1 ? CONFIG_T::filt_height - 1 : 1;
+
+    typedef typename data_T::value_type pixel_t;
+
+    pixel_t line_buffer[buffer_rows][padded_width][CONFIG_T::n_chan];
+    pixel_t window[CONFIG_T::filt_height][CONFIG_T::filt_width][CONFIG_T::n_chan];
+
+    #pragma HLS ARRAY_PARTITION variable=line_buffer complete dim=1
+    #pragma HLS ARRAY_PARTITION variable=line_buffer complete dim=3
+    #pragma HLS ARRAY_PARTITION variable=window complete dim=0
+
+    // Use a function_instantiate in case it helps to explicitly optimize unchanging weights/biases
+    #pragma HLS function_instantiate variable=weights,biases
+    #pragma HLS ARRAY_PARTITION variable=weights complete dim=0
+    #pragma HLS ARRAY_PARTITION variable=biases complete dim=0
+
+    // Limit multipliers to the products of one output pixel, folded by the reuse factor
+    const int multiplier_limit = (CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_filt + CONFIG_T::reuse_factor - 1) / CONFIG_T::reuse_factor;
+    #pragma HLS ALLOCATION instances=mul limit=multiplier_limit operation
+
+    // Position of the window relative to the stride grid
+    unsigned stride_row = 0;
+
+    DepthRow: for(unsigned ih = 0; ih < padded_height; ih++) {
+      unsigned stride_col = 0;
+      DepthCol: for(unsigned iw = 0; iw < padded_width; iw++) {
+        #pragma HLS PIPELINE II=CONFIG_T::reuse_factor
+
+        // Read the next pixel, or insert padding
+        data_T pixel;
+        if (ih < CONFIG_T::pad_top || ih >= CONFIG_T::pad_top + CONFIG_T::in_height
+         || iw < CONFIG_T::pad_left || iw >= CONFIG_T::pad_left + CONFIG_T::in_width) {
+          PadChan: for(unsigned cc = 0; cc < CONFIG_T::n_chan; cc++) {
+            pixel[cc] = 0;
+          }
+        } else {
+          pixel = data.read();
+        }
+
+        shift_line_buffer_2d<data_T, CONFIG_T::filt_height, CONFIG_T::filt_width, padded_width>(pixel, iw, line_buffer, window);
+
+        // Once the window covers a full filter on the stride grid, compute all filters
+        if (ih + 1 >= CONFIG_T::filt_height && iw + 1 >= CONFIG_T::filt_width && stride_row == 0 && stride_col == 0) {
+          res_T out_pixel;
+          DepthFilt: for(unsigned ff = 0; ff < CONFIG_T::n_filt; ff++) {
+            unsigned cc = ff / CONFIG_T::depth_multiplier;
+            typename CONFIG_T::accum_t mult[CONFIG_T::filt_height * CONFIG_T::filt_width];
+            DepthFiltHeight: for(unsigned fh = 0; fh < CONFIG_T::filt_height; fh++) {
+              DepthFiltWidth: for(unsigned fw = 0; fw < CONFIG_T::filt_width; fw++) {
+                mult[fh*CONFIG_T::filt_width + fw] = window[fh][fw][cc] * weights[(fh*CONFIG_T::filt_width + fw)*CONFIG_T::n_filt + ff];
+                NNET_CHECK_OVERFLOW(CONFIG_T, "mult", typename CONFIG_T::accum_t, (double) window[fh][fw][cc] * (double) weights[(fh*CONFIG_T::filt_width + fw)*CONFIG_T::n_filt + ff]);
+              }
+            }
+            typename CONFIG_T::accum_t acc = biases[ff];
+            NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc, mult, CONFIG_T::filt_height * CONFIG_T::filt_width);
+            acc += adder_tree<typename CONFIG_T::accum_t, CONFIG_T::filt_height * CONFIG_T::filt_width, CONFIG_T::adder_tree_regs>(mult);
+            NNET_CHECK_OVERFLOW(CONFIG_T, "result", typename res_T::value_type, acc);
+            out_pixel[ff] = (typename res_T::value_type) acc;
+          }
+          res.write(out_pixel);
+        }
+
+        // Advance the stride position, only once the first full window is reached
+        if (iw + 1 >= CONFIG_T::filt_width) {
+          stride_col = (stride_col + 1 == CONFIG_T::stride_width) ? 0 : stride_col + 1;
+        }
+      }//end column loop
+      if (ih + 1 >= CONFIG_T::filt_height) {
+        stride_row = (stride_row + 1 == CONFIG_T::stride_height) ? 0 : stride_row + 1;
+      }
+    }//end row loop
+
+}//end depthwise_conv_2d_stream
+
+
+// Streaming pointwise conv2d, one output pixel per input pixel, no buffering needed
+template<class data_T, class res_T, typename CONFIG_T>
+void pointwise_conv_2d_stream(
+             hls::stream<data_T> &data,
+             hls::stream<res_T>  &res,
+             typename CONFIG_T::weight_t  weights[CONFIG_T::n_chan * CONFIG_T::n_filt],
+             typename CONFIG_T::bias_t    biases[CONFIG_T::n_filt])
+{
+    // Use a function_instantiate in case it helps to explicitly optimize unchanging weights/biases
+    #pragma HLS function_instantiate variable=weights,biases
+    #pragma HLS ARRAY_PARTITION variable=weights complete dim=0
+    #pragma HLS ARRAY_PARTITION variable=biases complete dim=0
+
+    // Limit multipliers to the products of one output pixel, folded by the reuse factor
+    const int multiplier_limit = (CONFIG_T::n_chan * CONFIG_T::n_filt + CONFIG_T::reuse_factor - 1) / CONFIG_T::reuse_factor;
+    #pragma HLS ALLOCATION instances=mul limit=multiplier_limit operation
+
+    PointPixel: for(unsigned ii = 0; ii < CONFIG_T::in_height * CONFIG_T::in_width; ii++) {
+      #pragma HLS PIPELINE II=CONFIG_T::reuse_factor
+      data_T in_pixel = data.read();
+      res_T out_pixel;
+      PointFilt: for(unsigned ff = 0; ff < CONFIG_T::n_filt; ff++) {
+        typename CONFIG_T::accum_t mult[CONFIG_T::n_chan];
+        PointChan: for(unsigned cc = 0; cc < CONFIG_T::n_chan; cc++) {
+          mult[cc] = in_pixel[cc] * weights[cc*CONFIG_T::n_filt + ff];
+          NNET_CHECK_OVERFLOW(CONFIG_T, "mult", typename CONFIG_T::accum_t, (double) in_pixel[cc] * (double) weights[cc*CONFIG_T::n_filt + ff]);
+        }
+        typename CONFIG_T::accum_t acc = biases[ff];
+        NNET_CHECK_SUM(CONFIG_T, "acc", typename CONFIG_T::accum_t, acc, mult, CONFIG_T::n_chan);
+        acc += adder_tree<typename CONFIG_T::accum_t, CONFIG_T::n_chan, CONFIG_T::adder_tree_regs>(mult);
+        NNET_CHECK_OVERFLOW(CONFIG_T, "result", typename res_T::value_type, acc);
+        out_pixel[ff] = (typename res_T::value_type) acc;
+      }
+      res.write(out_pixel);
+    }
+}//end pointwise_conv_2d_stream
+
+}//end namespace
+
+#endif
@@ -0,0 +1,195 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef NNET_STREAM_H_
+#define NNET_STREAM_H_
+
+// Helpers for the io_stream designs, where the layers run under DATAFLOW and pass
+// their outputs through hls::stream FIFOs, one nnet::array word at a time (all the
+// values of a dense layer, or all the channels of one pixel of a conv layer).
+
+#include "ap_int.h"
+#include "hls_stream.h"
+#include "nnet_common.h"
+
+namespace nnet {
+
+// Word of the AXI-Stream ports of the top level function. Vivado HLS maps the
+// members to TDATA and TLAST by name, TLAST marks the last word of an event.
+template<class word_T>
+struct axis
+{
+    word_T data;
+    ap_uint<1> last;
+};
+
+// Reads the N values of one event from stream words of data_T::size values each
+template<class data_T, unsigned N>
+void read_stream_array(
+    hls::stream<data_T> &data,
+    typename data_T::value_type res[N])
+{
+    ReadWord: for (unsigned i = 0; i < N / data_T::size; i++) {
+        #pragma HLS PIPELINE
+        data_T word = data.read();
+        ReadValue: for (unsigned j = 0; j < data_T::size; j++) {
+            #pragma HLS UNROLL
+            res[i * data_T::size + j] = word[j];
+        }
+    }
+}
+
+// Writes the N values of one event as stream words of res_T::size values each
+template<class res_T, unsigned N>
+void write_stream_array(
+    typename res_T::value_type data[N],
+    hls::stream<res_T> &res)
+{
+    WriteWord: for (unsigned i = 0; i < N / res_T::size; i++) {
+        #pragma HLS PIPELINE
+        res_T word;
+        WriteValue: for (unsigned j = 0; j < res_T::size; j++) {
+            #pragma HLS UNROLL
+            word[j] = data[i * res_T::size + j];
+        }
+        res.write(word);
+    }
+}
+
+// Top level input: drops TLAST from the n_words words of one event
+template<class word_T, unsigned n_words>
+void axis_to_stream(
+    hls::stream<axis<word_T> > &data,
+    hls::stream<word_T> &res)
+{
+    AxisIn: for (unsigned i = 0; i < n_words; i++) {
+        #pragma HLS PIPELINE
+        res.write(data.read().data);
+    }
+}
+
+// Top level output: sets TLAST on the last of the n_words words of one event
+template<class word_T, unsigned n_words>
+void stream_to_axis(
+    hls::stream<word_T> &data,
+    hls::stream<axis<word_T> > &res)
+{
+    AxisOut: for (unsigned i = 0; i < n_words; i++) {
+        #pragma HLS PIPELINE
+        axis<word_T> word;
+        word.data = data.read();
+        word.last = (i == n_words - 1);
+        res.write(word);
+    }
+}
+
+template<class word_T>
+void write_copies(const word_T &word) {}
+
+template<class word_T, class... Streams>
+void write_copies(const word_T &word, hls::stream<word_T> &res, Streams&... rest)
+{
+    #pragma HLS INLINE
+    res.write(word);
+    write_copies(word, rest...);
+}
+
+// Fan-out of a layer output read by several layers: under DATAFLOW a FIFO has a single
+// reader, so each reader gets its own copy of the n_words words of one event and the
+// branches run concurrently. clone_stream<word_T, n_words>(data, copy1, copy2, ...)
+template<class word_T, unsigned n_words, class... Streams>
+void clone_stream(
+    hls::stream<word_T> &data,
+    Streams&... res)
+{
+    CloneWord: for (unsigned i = 0; i < n_words; i++) {
+        #pragma HLS PIPELINE
+        write_copies(data.read(), res...);
+    }
+}
+
+// Line buffer step of the streaming 2D kernels, one call per padded input pixel in
+// raster order: shifts the window one column to the left, fills its last column from
+// column iw of the buffered rows and the new pixel, then pushes the pixel into the
+// line buffer. The buffer holds filt_height-1 rows (at least one) of data_T::size values.
+template<class data_T, unsigned filt_height, unsigned filt_width, unsigned padded_width>
+void shift_line_buffer_2d(
+             const data_T &pixel,
+             unsigned iw,
+             typename data_T::value_type line_buffer[][padded_width][data_T::size],
+             typename data_T::value_type window[filt_height][filt_width][data_T::size])
+{
+    #pragma HLS INLINE
+    const unsigned buffer_rows = filt_height > 1 ? filt_height - 1 : 1;
+
+    // Shift the window one column to the left
+    ShiftHeight: for(unsigned fh = 0; fh < filt_height; fh++) {
+      ShiftWidth: for(unsigned fw = 0; fw + 1 < filt_width; fw++) {
+        ShiftChan: for(unsigned cc = 0; cc < data_T::size; cc++) {
+          window[fh][fw][cc] = window[fh][fw+1][cc];
+        }
+      }
+    }
+
+    // Fill the new window column from the line buffer and the new pixel,
+    // then push the pixel into the line buffer column
+    NewColChan: for(unsigned cc = 0; cc < data_T::size; cc++) {
+      NewColHeight: for(unsigned fh = 0; fh + 1 < filt_height; fh++) {
+        window[fh][filt_width-1][cc] = line_buffer[fh][iw][cc];
+      }
+      window[filt_height-1][filt_width-1][cc] = pixel[cc];
+
+      if (filt_height > 1) {
+        LineShift: for(unsigned fh = 0; fh + 2 < filt_height; fh++) {
+          line_buffer[fh][iw][cc] = line_buffer[fh+1][iw][cc];
+        }
+        line_buffer[buffer_rows-1][iw][cc] = pixel[cc];
+      }
+    }
+}
+
+// Host side only (testbench): the flattened values of one event to the top level
+// input words, and the top level output words back to values
+template<class word_T, unsigned n_words, class src_T>
+void array_to_axis(const src_T *data, hls::stream<axis<word_T> > &res)
+{
+    for (unsigned i = 0; i < n_words; i++) {
+        axis<word_T> word;
+        for (unsigned j = 0; j < word_T::size; j++) {
+            word.data[j] = data[i * word_T::size + j];
+        }
+        word.last = (i == n_words - 1);
+        res.write(word);
+    }
+}
+
+template<class word_T, unsigned n_words, class dst_T>
+void axis_to_array(hls::stream<axis<word_T> > &data, dst_T *res)
+{
+    for (unsigned i = 0; i < n_words; i++) {
+        axis<word_T> word = data.read();
+        for (unsigned j = 0; j < word_T::size; j++) {
+            res[i * word_T::size + j] = word.data[j];
+        }
+    }
+}
+
+}
+
+#endif
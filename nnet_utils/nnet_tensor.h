@@ -0,0 +1,219 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef NNET_TENSOR_H_
+#define NNET_TENSOR_H_
+
+// Host side only: binary tensor files for test vectors, memory mapped so that the
+// events can be used in place. hls-writer/tensor_file.py writes and reads the same
+// format and converts text and numpy files to it. The payload is used as is, so this
+// assumes a little endian host. Layout, all little endian:
+//   char     magic[8]     "NNETTNSR"
+//   uint32_t version      1
+//   uint32_t dtype        tensor_dtype
+//   uint32_t ndim         at most tensor_max_dim, the first dimension counts the events
+//   uint32_t reserved
+//   uint64_t shape[ndim]
+//   zero padding up to a multiple of tensor_alignment bytes
+//   payload, row major
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace nnet {
+
+enum tensor_dtype { tensor_float32 = 1, tensor_float64, tensor_int8, tensor_int16, tensor_int32, tensor_int64 };
+
+static const unsigned tensor_max_dim = 8;
+static const unsigned tensor_alignment = 64;
+static const char tensor_magic[8] = {'N', 'N', 'E', 'T', 'T', 'N', 'S', 'R'};
+
+template<class T> struct tensor_dtype_of {};
+template<> struct tensor_dtype_of<float>   { static const tensor_dtype value = tensor_float32; };
+template<> struct tensor_dtype_of<double>  { static const tensor_dtype value = tensor_float64; };
+template<> struct tensor_dtype_of<int8_t>  { static const tensor_dtype value = tensor_int8; };
+template<> struct tensor_dtype_of<int16_t> { static const tensor_dtype value = tensor_int16; };
+template<> struct tensor_dtype_of<int32_t> { static const tensor_dtype value = tensor_int32; };
+template<> struct tensor_dtype_of<int64_t> { static const tensor_dtype value = tensor_int64; };
+
+inline size_t tensor_dtype_size(unsigned dtype)
+{
+    switch (dtype) {
+        case tensor_float32: return 4;
+        case tensor_float64: return 8;
+        case tensor_int8:    return 1;
+        case tensor_int16:   return 2;
+        case tensor_int32:   return 4;
+        case tensor_int64:   return 8;
+        default:             return 0;
+    }
+}
+
+inline size_t tensor_header_size(unsigned ndim)
+{
+    size_t size = 8 + 4 * 4 + 8 * ndim;
+    return (size + tensor_alignment - 1) / tensor_alignment * tensor_alignment;
+}
+
+struct tensor_file
+{
+    unsigned dtype;
+    unsigned ndim;
+    size_t shape[tensor_max_dim];
+    // Number of values per event, i.e. the product of all but the first dimension
+    size_t event_size;
+    const char *payload;
+    void *map;
+    size_t map_size;
+};
+
+// Maps the file, returns -1 if it cannot be opened and -2 if it is not a valid tensor file
+inline int open_tensor_file(const char *filename, tensor_file &tensor)
+{
+    tensor.map = 0;
+    tensor.map_size = 0;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) tensor_header_size(0)) {
+        close(fd);
+        return -2;
+    }
+    void *map = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    const char *bytes = (const char *) map;
+    uint32_t header[4];
+    memcpy(header, bytes + 8, sizeof(header));
+    size_t expected = 0;
+    bool valid = memcmp(bytes, tensor_magic, 8) == 0 && header[0] == 1
+              && tensor_dtype_size(header[1]) != 0 && header[2] >= 1 && header[2] <= tensor_max_dim
+              && (size_t) st.st_size >= tensor_header_size(header[2]);
+    if (valid) {
+        tensor.dtype = header[1];
+        tensor.ndim = header[2];
+        tensor.event_size = 1;
+        for (unsigned i = 0; i < tensor.ndim; i++) {
+            uint64_t dim;
+            memcpy(&dim, bytes + 8 + sizeof(header) + 8 * i, 8);
+            tensor.shape[i] = dim;
+            if (i > 0) tensor.event_size *= dim;
+        }
+        expected = tensor_header_size(tensor.ndim) + tensor.shape[0] * tensor.event_size * tensor_dtype_size(tensor.dtype);
+        valid = (size_t) st.st_size == expected;
+    }
+    if (!valid) {
+        munmap(map, st.st_size);
+        return -2;
+    }
+
+    tensor.payload = bytes + tensor_header_size(tensor.ndim);
+    tensor.map = map;
+    tensor.map_size = st.st_size;
+    return 0;
+}
+
+inline void close_tensor_file(tensor_file &tensor)
+{
+    if (tensor.map) {
+        munmap(tensor.map, tensor.map_size);
+    }
+    tensor.map = 0;
+    tensor.map_size = 0;
+}
+
+// Zero-copy view of the events from first on, 0 if the file does not hold T
+template<class T>
+const T *tensor_events(const tensor_file &tensor, size_t first = 0)
+{
+    if (tensor.dtype != tensor_dtype_of<T>::value) {
+        return 0;
+    }
+    return (const T *) tensor.payload + first * tensor.event_size;
+}
+
+template<class src_T, class dataType>
+void convert_tensor_values(const char *src, size_t n, dataType *data)
+{
+    const src_T *values = (const src_T *) src;
+    for (size_t ii = 0; ii < n; ii++) {
+        data[ii] = values[ii];
+    }
+}
+
+// Copies n_events events from first on into data, converting to dataType (e.g. input_t).
+// Returns -2 if the file does not hold that many events.
+template<class dataType>
+int read_tensor_events(const tensor_file &tensor, size_t first, size_t n_events, dataType *data)
+{
+    if (first + n_events > tensor.shape[0]) {
+        return -2;
+    }
+    const char *src = tensor.payload + first * tensor.event_size * tensor_dtype_size(tensor.dtype);
+    size_t n = n_events * tensor.event_size;
+    switch (tensor.dtype) {
+        case tensor_float32: convert_tensor_values<float>(src, n, data); break;
+        case tensor_float64: convert_tensor_values<double>(src, n, data); break;
+        case tensor_int8:    convert_tensor_values<int8_t>(src, n, data); break;
+        case tensor_int16:   convert_tensor_values<int16_t>(src, n, data); break;
+        case tensor_int32:   convert_tensor_values<int32_t>(src, n, data); break;
+        case tensor_int64:   convert_tensor_values<int64_t>(src, n, data); break;
+    }
+    return 0;
+}
+
+// Writes n_events events of event_size values each as a float64 tensor of shape
+// (n_events, event_size), which holds the fixed point types up to 53 bits exactly.
+// Returns -1 if the file cannot be written.
+template<class dataType>
+int write_tensor_file(const char *filename, const dataType *data, size_t n_events, size_t event_size)
+{
+    FILE *fp = fopen(filename, "wb");
+    if (fp == 0) {
+        return -1;
+    }
+    char header[tensor_alignment];
+    memset(header, 0, sizeof(header));
+    uint32_t info[4] = {1, tensor_float64, 2, 0};
+    uint64_t shape[2] = {n_events, event_size};
+    memcpy(header, tensor_magic, 8);
+    memcpy(header + 8, info, sizeof(info));
+    memcpy(header + 8 + sizeof(info), shape, sizeof(shape));
+    bool ok = fwrite(header, 1, tensor_header_size(2), fp) == tensor_header_size(2);
+    for (size_t ii = 0; ok && ii < n_events * event_size; ii++) {
+        double value = (double) data[ii];
+        ok = fwrite(&value, sizeof(value), 1, fp) == 1;
+    }
+    fclose(fp);
+    return ok ? 0 : -1;
+}
+
+}
+
+#endif
@@ -0,0 +1,143 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef NNET_TRACE_H_
+#define NNET_TRACE_H_
+
+// Host side only: outputs of every layer of the C model, to find the layer that loses
+// precision. Compiling with -DNNET_TRACE makes NNET_TRACE_ARRAY and NNET_TRACE_STREAM
+// (see nnet_csim.h) record the output of each layer for each event of run_batch.
+// write_trace writes one float64 tensor file (see nnet_tensor.h) of shape (events, values)
+// per layer to a directory, exact for the fixed point types up to 53 bits, and trace.txt with "name layout size precision" per layer in
+// the order of the layers. Layout "chw" marks the channel major outputs of the 2D
+// layers of io_parallel designs, "flat" the channels last order of Keras.
+// hls-writer/compare_trace.py compares them to the outputs of the Keras or PyTorch model.
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <errno.h>
+#include <sys/stat.h>
+#include "hls_stream.h"
+#include "nnet_tensor.h"
+
+namespace nnet {
+
+struct trace_layer
+{
+    std::string layout;
+    std::string precision;
+    size_t size;
+    // size values per event
+    std::vector<double> values;
+};
+
+struct trace_data
+{
+    std::mutex lock;
+    // In the order of the first call, i.e. of the layers
+    std::vector<std::string> names;
+    std::map<std::string, trace_layer> layers;
+};
+
+inline trace_data &get_trace()
+{
+    static trace_data trace;
+    return trace;
+}
+
+// Event run by the calling thread, set by run_batch
+inline unsigned &trace_event()
+{
+    static thread_local unsigned event = 0;
+    return event;
+}
+
+// Safe to call from the worker threads of run_batch
+template<class data_T>
+void trace_values(const char *name, const char *layout, const char *precision, const data_T *data, size_t n)
+{
+    trace_data &trace = get_trace();
+    size_t offset = trace_event() * n;
+    std::lock_guard<std::mutex> guard(trace.lock);
+    std::map<std::string, trace_layer>::iterator it = trace.layers.find(name);
+    if (it == trace.layers.end()) {
+        trace_layer layer;
+        layer.layout = layout;
+        layer.precision = precision;
+        layer.size = n;
+        it = trace.layers.insert(std::make_pair(std::string(name), layer)).first;
+        trace.names.push_back(name);
+    }
+    std::vector<double> &values = it->second.values;
+    if (values.size() < offset + n) values.resize(offset + n);
+    for (size_t ii = 0; ii < n; ii++) {
+        values[offset + ii] = (double) data[ii];
+    }
+}
+
+// The C simulation runs a layer to completion before the next one, so the FIFO holds
+// all the words of the event. They are read and written back in the same order.
+template<class word_T>
+void trace_stream(const char *name, const char *precision, hls::stream<word_T> &fifo)
+{
+    std::vector<word_T> words;
+    std::vector<typename word_T::value_type> values;
+    while (!fifo.empty()) {
+        word_T word = fifo.read();
+        for (unsigned jj = 0; jj < word_T::size; jj++) {
+            values.push_back(word[jj]);
+        }
+        words.push_back(word);
+    }
+    for (size_t ii = 0; ii < words.size(); ii++) {
+        fifo.write(words[ii]);
+    }
+    trace_values(name, "flat", precision, values.data(), values.size());
+}
+
+// Returns the number of layers written, -1 if the directory or a file cannot be written
+inline int write_trace(const char *dirname)
+{
+    trace_data &trace = get_trace();
+    std::lock_guard<std::mutex> guard(trace.lock);
+    if (mkdir(dirname, 0777) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    std::string dir(dirname);
+    std::ofstream index((dir + "/trace.txt").c_str());
+    if (!index) {
+        return -1;
+    }
+    for (size_t ii = 0; ii < trace.names.size(); ii++) {
+        const trace_layer &layer = trace.layers[trace.names[ii]];
+        std::string filename = dir + "/" + trace.names[ii] + ".bin";
+        if (write_tensor_file(filename.c_str(), layer.values.data(), layer.size ? layer.values.size() / layer.size : 0, layer.size) != 0) {
+            return -1;
+        }
+        index << trace.names[ii] << " " << layer.layout << " " << layer.size << " " << layer.precision << std::endl;
+    }
+    return trace.names.size();
+}
+
+}
+
+#endif
@@ -0,0 +1,78 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef NNET_WEIGHTS_H_
+#define NNET_WEIGHTS_H_
+
+// Host side only: weights read at startup instead of compiled in. With WeightsMem in the
+// project config, the writer also writes the values of each weight array as a $readmemh
+// file of hex words (the two's complement bits of each value, one per line) next to its
+// header. Compiling with -DNNET_WEIGHTS_MEM drops the initializers of the headers, which
+// make most of the compile time of large models, and each array is filled from its file
+// before main. Synthesis always uses the initializers. The files are looked up in
+// NNET_WEIGHTS_DIR, relative to the working directory unless given as an absolute path.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <iostream>
+
+#ifndef NNET_WEIGHTS_DIR
+#define NNET_WEIGHTS_DIR "firmware/weights/"
+#endif
+
+namespace nnet {
+
+// Fills the n values of w, of width bits with frac_bits fractional bits, from a $readmemh file
+template<class weight_T>
+bool load_weights_mem(weight_T *w, unsigned n, unsigned width, int frac_bits, bool is_signed, const char *name)
+{
+    std::string filename = std::string(NNET_WEIGHTS_DIR) + name;
+    FILE *fp = fopen(filename.c_str(), "r");
+    if (fp == 0) {
+        std::cerr << "ERROR: Cannot open " << filename << std::endl;
+        exit(1);
+    }
+
+    char line[256];
+    unsigned ii = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        char *word = line;
+        while (isspace(*word)) word++;
+        if (*word == '\0' || (word[0] == '/' && word[1] == '/')) continue;
+        unsigned long long bits = strtoull(word, 0, 16);
+        // Sign extension of the two's complement bits
+        long long value = (is_signed && width < 64 && (bits >> (width - 1)) & 1) ? (long long) (bits - (1ULL << width)) : (long long) bits;
+        if (ii < n) w[ii] = ldexp((double) value, -frac_bits);
+        ii++;
+    }
+    fclose(fp);
+
+    if (ii != n) {
+        std::cerr << "ERROR: Expected " << n << " values in " << filename << ", got " << ii << std::endl;
+        exit(1);
+    }
+    return true;
+}
+
+}
+
+#endif
@@ -14,7 +14,7 @@ from shutil import copyfile
 
 filedir = os.path.dirname(os.path.abspath(__file__))
 sys.path.insert(0,os.path.join(filedir, "..", "hls-writer"))
-from hls_writer import parse_config, print_array_to_cpp, hls_writer
+from hls_writer import parse_config, print_array_to_cpp, print_sparse_array_to_cpp, check_resource_reuse, get_layer_type, get_type_precision, get_layer_reuse, hls_writer
 
 ############################################################################################
 ## M A I N
@@ -34,10 +34,23 @@ def main():
         yamlConfig['OutputDir'] = os.path.join(configDir, yamlConfig['OutputDir'])
     if not os.path.isabs(yamlConfig['PytorchModel']):
         yamlConfig['PytorchModel'] = os.path.join(configDir, yamlConfig['PytorchModel'])
+    if yamlConfig.get('FIFODepths') and not os.path.isabs(yamlConfig['FIFODepths']):
+        yamlConfig['FIFODepths'] = os.path.join(configDir, yamlConfig['FIFODepths'])
 
-    if not (yamlConfig["IOType"] == "io_parallel" or yamlConfig["IOType"] == "io_serial"):
+    if not yamlConfig["IOType"] in ["io_parallel", "io_serial", "io_stream"]:
         raise Exception('ERROR: Invalid IO type')
 
+    yamlConfig.setdefault('Strategy', 'Latency')
+    if not yamlConfig["Strategy"] in ["Latency", "Resource", "Sparse"]:
+        raise Exception('ERROR: Invalid strategy')
+    if yamlConfig["Strategy"] == "Sparse" and yamlConfig["IOType"] == "io_serial":
+        # nnet::compute_layer_sparse reads its inputs in the order of the nonzero weights
+        raise Exception('ERROR: The Sparse strategy is not supported with io_serial')
+
+    yamlConfig.setdefault('SoftmaxImplementation', 'stable')
+    if not yamlConfig["SoftmaxImplementation"].lower() in ["stable", "legacy"]:
+        raise Exception('ERROR: Invalid softmax implementation, options: stable/legacy')
+
     ######################
     ##  Do translation
     ######################
@@ -77,6 +90,8 @@ def main():
         ## Extract name for finding weights and biases
         ## Only suport Dense network for now. Will update this later for others
         layer['class_name'] = "Dense"
+        # Module name, e.g. 0 for the first module of a Sequential, for the LayerName config
+        layer['name'] = Nlayer
 
         # #Get number of inputs and outputs
         layer["n_in"] =  int(matchname.group(2))
@@ -87,12 +102,23 @@ def main():
 
         # #Extract type of activation and number of nodes
         layer["activation"] = modelstr[i+1].split(":")[-1].strip().lower()[:-2]
+        # The activation module gives the output of the layer, see get_trace_name in hls_writer
+        ActivationMatch = re.search("\((\d)\):\s", modelstr[i+1])
+        if ActivationMatch is not None:
+            layer['output_name'] = ActivationMatch.group(1)
 
         # Translate weights and biases from tensorfile
         weights = modeldict[Nlayer+".weight"].numpy().transpose()
         biases  = modeldict[Nlayer+".bias"].numpy().transpose()
-        cur_n_zeros = print_array_to_cpp("w{}".format(layer_counter), weights, yamlConfig['OutputDir'])
-        print_array_to_cpp("b{}".format(layer_counter), biases, yamlConfig['OutputDir'])
+        if yamlConfig['Strategy'] == 'Resource':
+            # Resource strategy reads the weights output-major, see nnet::compute_layer_resource
+            check_resource_reuse(layer["n_in"], get_layer_reuse(yamlConfig, layer))
+            cur_n_zeros = print_array_to_cpp("w{}".format(layer_counter), weights.transpose(), yamlConfig['OutputDir'], type_name=get_layer_type(yamlConfig, layer, layer_counter, 'weight'), precision=get_type_precision(yamlConfig, layer, 'weight'), mem=yamlConfig.get('WeightsMem', False))
+        elif yamlConfig['Strategy'] == 'Sparse':
+            cur_n_zeros = print_sparse_array_to_cpp("w{}".format(layer_counter), weights, yamlConfig['OutputDir'], type_name='sparse_'+get_layer_type(yamlConfig, layer, layer_counter, 'weight'), precision=get_type_precision(yamlConfig, layer, 'weight'))
+        else:
+            cur_n_zeros = print_array_to_cpp("w{}".format(layer_counter), weights, yamlConfig['OutputDir'], type_name=get_layer_type(yamlConfig, layer, layer_counter, 'weight'), precision=get_type_precision(yamlConfig, layer, 'weight'), mem=yamlConfig.get('WeightsMem', False))
+        print_array_to_cpp("b{}".format(layer_counter), biases, yamlConfig['OutputDir'], type_name=get_layer_type(yamlConfig, layer, layer_counter, 'bias'), precision=get_type_precision(yamlConfig, layer, 'bias'), mem=yamlConfig.get('WeightsMem', False))
         layer['weights_n_zeros'] = cur_n_zeros
 
         layer_list.append(layer)
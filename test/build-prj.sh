@@ -9,6 +9,7 @@ csim="csim 0"
 synth="synth 0"
 cosim="cosim 0"
 export="export 0"
+fastsim="fastsim 0"
 
 function print_usage {
    echo "Usage: `basename $0` [OPTION]"
@@ -26,6 +27,9 @@ function print_usage {
    echo "      Run with N parallel tasks. Defaults to 1."
    echo "   -c"
    echo "      Run C simulation."
+   echo "   -f"
+   echo "      Use native integer fixed point types in C simulation (see nnet_utils/nnet_fixed.h)."
+   echo "      Disables C/RTL cosimulation."
    echo "   -s"
    echo "      Run C/RTL synthesis."
    echo "   -r"
@@ -63,7 +67,7 @@ function check_status {
    cd ..
 }
 
-while getopts ":d:i:v:p:csreh" opt; do
+while getopts ":d:i:v:p:cfsreh" opt; do
    case "$opt" in
    d) basedir=$OPTARG
       ;;
@@ -75,6 +79,8 @@ while getopts ":d:i:v:p:csreh" opt; do
       ;;
    c) csim="csim 1"
       ;;
+   f) fastsim="fastsim 1"
+      ;;
    s) synth="synth 1"
       ;;
    r) cosim="cosim 1"
@@ -114,7 +120,7 @@ done
 
 source ${vivadodir}/Vivado/${vivadover}/settings64.sh
 
-opt="${csim} ${synth} ${cosim} ${export}"
+opt="${csim} ${synth} ${cosim} ${export} ${fastsim}"
 
 if [ "${parallel}" -gt 1 ]; then
    # Run in parallel
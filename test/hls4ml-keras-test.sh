@@ -6,6 +6,9 @@ VIVADO_VERSION=2017.2
 # If running in docker image we would first need to activate the proper conda environment
 #. activate hls4ml-py36
 
+# Check the kernels that have a C++ reference in kernel-tests/
+./kernel-tests.sh -i ${VIVADO_INSTALL_DIR} -v ${VIVADO_VERSION}
+
 # Convert models in keras-models.txt 
 ./convert-keras-models.sh -x -p 3 -f keras-models.txt
 
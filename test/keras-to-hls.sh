@@ -5,6 +5,7 @@ xilinxpart="xc7vx690tffg1927-2"
 clock=5
 io=io_parallel
 rf=1
+strategy=Latency
 type="ap_fixed<18,8>"
 basedir=vivado_prj
 
@@ -28,8 +29,12 @@ function print_usage {
    echo "      Clock period to use. Defaults to 5."
    echo "   -s"
    echo "      Use serial I/O. If not specified uses parallel I/O."
+   echo "   -S"
+   echo "      Use streaming I/O (io_stream). If not specified uses parallel I/O."
    echo "   -r FACTOR"
    echo "      Reuse factor. Defaults to 1."
+   echo "   -g STRATEGY"
+   echo "      Dense layer strategy (Latency, Resource or Sparse). Defaults to 'Latency'."
    echo "   -t TYPE"
    echo "      Default precision. Defaults to 'ap_fixed<18,8>'."
    echo "   -d DIR"
@@ -38,7 +43,7 @@ function print_usage {
    echo "      Prints this help message."
 }
 
-while getopts ":p:x:c:sr:t:d:h" opt; do
+while getopts ":p:x:c:sSr:g:t:d:h" opt; do
    case "$opt" in
    p) pycmd=${pycmd}$OPTARG
       ;;
@@ -48,8 +53,12 @@ while getopts ":p:x:c:sr:t:d:h" opt; do
       ;;
    s) io=io_serial
       ;;
+   S) io=io_stream
+      ;;
    r) rf=$OPTARG
       ;;
+   g) strategy=$OPTARG
+      ;;
    t) type=$OPTARG
       ;;
    d) basedir=$OPTARG
@@ -89,16 +98,23 @@ do
    base=`echo "${h5}" | sed -e 's/\(_weights\)*$//g'`
    file="${basedir}/${base}-${pycmd}.yml"
 
+   # Only non-default strategies show up in the project name
+   strategy_suffix=""
+   if [ "${strategy}" != "Latency" ]; then
+      strategy_suffix="-${strategy}"
+   fi
+
    # This scheme assumes base output directory is one level deep 
    echo "KerasJson: ../../keras-to-hls/example-keras-model-files/${name}.json" > ${file}
    echo "KerasH5:   ../../keras-to-hls/example-keras-model-files/${h5}.h5" >> ${file}
-   echo "OutputDir: ${base}-${pycmd}-${xilinxpart//${sanitizer}/_}-c${clock}-${io}-rf${rf}-${type//${sanitizer}/_}" >> ${file}
+   echo "OutputDir: ${base}-${pycmd}-${xilinxpart//${sanitizer}/_}-c${clock}-${io}-rf${rf}${strategy_suffix}-${type//${sanitizer}/_}" >> ${file}
    echo "ProjectName: myproject" >> ${file}
    echo "XilinxPart: ${xilinxpart}" >> ${file}
    echo "ClockPeriod: ${clock}" >> ${file}
    echo "" >> ${file}
    echo "IOType: ${io}" >> ${file}
    echo "ReuseFactor: ${rf}" >> ${file}
+   echo "Strategy: ${strategy}" >> ${file}
    echo "DefaultPrecision: ${type} " >> ${file}
 
    ${pycmd} ../keras-to-hls/keras-to-hls.py -c ${file} || exit 1
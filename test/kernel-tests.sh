@@ -0,0 +1,61 @@
+#!/bin/bash
+
+vivadodir=/opt/Xilinx
+vivadover=2017.2
+includedir=""
+failed=0
+
+function print_usage {
+   echo "Usage: `basename $0` [OPTION]"
+   echo ""
+   echo "Compiles and runs the C++ checks of the nnet_utils kernels in kernel-tests/."
+   echo "Each check returns a non-zero status if the kernels disagree."
+   echo ""
+   echo "Options are:"
+   echo "   -i DIR"
+   echo "      Base directory of Vivado installation. Defaults to '/opt/Xilinx'."
+   echo "   -v VERSION"
+   echo "      Vivado HLS version to use. Defaults to '2017.2'."
+   echo "   -I DIR"
+   echo "      Directory of the ap_fixed headers, instead of the Vivado installation."
+   echo "   -h"
+   echo "      Prints this help message."
+}
+
+while getopts ":i:v:I:h" opt; do
+   case "$opt" in
+   i) vivadodir=$OPTARG
+      ;;
+   v) vivadover=$OPTARG
+      ;;
+   I) includedir=$OPTARG
+      ;;
+   h)
+      print_usage
+      exit
+      ;;
+   :)
+      echo "Option -$OPTARG requires an argument."
+      exit 1
+      ;;
+   esac
+done
+
+if [ -z "${includedir}" ]; then
+   includedir=${vivadodir}/Vivado/${vivadover}/include
+fi
+
+cd "$(dirname "$0")/kernel-tests"
+
+for src in *.cpp ; do
+   test="${src%.cpp}"
+   echo "Running ${test}"
+   g++ -std=c++11 -O1 -I"${includedir}" -I../../nnet_utils "${src}" -o "${test}" && ./"${test}"
+   if [ $? -ne 0 ]; then
+      echo "${test} failed."
+      failed=1
+   fi
+   rm -f "${test}"
+done
+
+exit ${failed}
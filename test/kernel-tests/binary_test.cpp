@@ -0,0 +1,198 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// nnet::compute_layer_binary, nnet::conv_2d_binary and nnet::conv_2d_binary_stream
+// against a plain multiply-accumulate of the +1/-1 and -1/0/+1 weights: the XNOR path
+// for +1/-1 inputs (binary_input) and the negate path for any input
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ap_fixed.h"
+#include "nnet_binary.h"
+
+typedef ap_fixed<16,6> input_t;
+typedef ap_fixed<24,10> layer_t;
+
+template<class T1, class T2> struct same_type { static const bool value = false; };
+template<class T> struct same_type<T, T> { static const bool value = true; };
+
+template<class weight_T, bool BINARY_INPUT>
+struct config_dense : nnet::binary_layer_config {
+    typedef ap_fixed<24,10> accum_t;
+    typedef ap_fixed<16,6> bias_t;
+    typedef weight_T weight_t;
+    static const unsigned n_in = 32;
+    static const unsigned n_out = 5;
+    static const bool binary_input = BINARY_INPUT;
+};
+
+// Same padding, so that the windows on the edges cover padding zeros
+template<class weight_T, bool BINARY_INPUT>
+struct config_conv : nnet::binary_conv2d_config {
+    typedef ap_fixed<24,10> accum_t;
+    typedef ap_fixed<16,6> bias_t;
+    typedef weight_T weight_t;
+    static const unsigned pad_top = 1;
+    static const unsigned pad_bottom = 1;
+    static const unsigned pad_left = 1;
+    static const unsigned pad_right = 1;
+    static const unsigned in_height = 5;
+    static const unsigned in_width = 5;
+    static const unsigned n_chan = 2;
+    static const unsigned filt_height = 3;
+    static const unsigned filt_width = 3;
+    static const unsigned n_filt = 3;
+    static const unsigned stride_height = 1;
+    static const unsigned stride_width = 1;
+    static const unsigned out_height = 5;
+    static const unsigned out_width = 5;
+    static const bool binary_input = BINARY_INPUT;
+};
+
+// +1/-1 inputs sum as a popcount on ceillog2(n)+2 bits, 32 products on 7 bits
+static_assert(same_type<nnet::binary_sum<ap_fixed<24,10>, 32, true>::type, ap_int<7> >::value, "popcount type of 32 products");
+static_assert(same_type<nnet::binary_sum<ap_fixed<24,10>, 32, false>::type, ap_fixed<24,10> >::value, "sum type of 32 products");
+
+double weight_value(nnet::binary_weight_t w) { return w == 1 ? 1 : -1; }
+double weight_value(nnet::ternary_weight_t w) { return (int) w; }
+
+void random_weight(nnet::binary_weight_t &w) { w = rand() % 2; }
+void random_weight(nnet::ternary_weight_t &w) { w = rand() % 3 - 1; }
+
+// +1/-1 for the XNOR path, multiples of 1/32 in [-3, 3] otherwise
+double random_input(bool binary_input)
+{
+    if (binary_input) return rand() % 2 ? 1 : -1;
+    return (rand() % 193 - 96) / 32.;
+}
+
+template<typename CONFIG_T>
+int check_dense(const char *name)
+{
+    input_t data[CONFIG_T::n_in];
+    typename CONFIG_T::weight_t weights[CONFIG_T::n_in * CONFIG_T::n_out];
+    typename CONFIG_T::bias_t biases[CONFIG_T::n_out];
+    layer_t res[CONFIG_T::n_out];
+
+    int n_errors = 0;
+    for (int event = 0; event < 100; event++) {
+        for (unsigned i = 0; i < CONFIG_T::n_in; i++) data[i] = random_input(CONFIG_T::binary_input);
+        for (unsigned i = 0; i < CONFIG_T::n_in * CONFIG_T::n_out; i++) random_weight(weights[i]);
+        for (unsigned i = 0; i < CONFIG_T::n_out; i++) biases[i] = (rand() % 129 - 64) / 16.;
+        // Every product +1, and every product -1, the ends of the popcount range
+        if (event < 2) {
+            for (unsigned i = 0; i < CONFIG_T::n_in * CONFIG_T::n_out; i++) weights[i] = 1;
+            for (unsigned i = 0; i < CONFIG_T::n_in; i++) data[i] = event == 0 ? 1 : -1;
+        }
+
+        nnet::compute_layer_binary<input_t, layer_t, CONFIG_T>(data, res, weights, biases);
+
+        for (unsigned jj = 0; jj < CONFIG_T::n_out; jj++) {
+            double expected = biases[jj].to_double();
+            for (unsigned ii = 0; ii < CONFIG_T::n_in; ii++) {
+                expected += data[ii].to_double() * weight_value(weights[ii * CONFIG_T::n_out + jj]);
+            }
+            if (res[jj].to_double() != expected) {
+                if (n_errors++ < 5) printf("%s event %d output %u: %f, expected %f\n", name, event, jj, res[jj].to_double(), expected);
+            }
+        }
+    }
+    return n_errors;
+}
+
+template<typename CONFIG_T>
+int check_conv(const char *name)
+{
+    typedef nnet::array<input_t, CONFIG_T::n_chan> input_word_t;
+    typedef nnet::array<layer_t, CONFIG_T::n_filt> res_word_t;
+    input_t data[CONFIG_T::in_height][CONFIG_T::in_width][CONFIG_T::n_chan];
+    typename CONFIG_T::weight_t weights[CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan * CONFIG_T::n_filt];
+    typename CONFIG_T::bias_t biases[CONFIG_T::n_filt];
+    layer_t res[CONFIG_T::out_height][CONFIG_T::out_width][CONFIG_T::n_filt];
+
+    int n_errors = 0;
+    for (int event = 0; event < 100; event++) {
+        for (unsigned h = 0; h < CONFIG_T::in_height; h++)
+            for (unsigned w = 0; w < CONFIG_T::in_width; w++)
+                for (unsigned c = 0; c < CONFIG_T::n_chan; c++)
+                    data[h][w][c] = random_input(CONFIG_T::binary_input);
+        for (unsigned i = 0; i < CONFIG_T::filt_height * CONFIG_T::filt_width * CONFIG_T::n_chan * CONFIG_T::n_filt; i++) random_weight(weights[i]);
+        for (unsigned i = 0; i < CONFIG_T::n_filt; i++) biases[i] = (rand() % 129 - 64) / 16.;
+
+        nnet::conv_2d_binary<input_t, layer_t, CONFIG_T>(data, res, weights, biases);
+
+        hls::stream<input_word_t> in_stream("in_stream");
+        hls::stream<res_word_t> out_stream("out_stream");
+        for (unsigned h = 0; h < CONFIG_T::in_height; h++) {
+            for (unsigned w = 0; w < CONFIG_T::in_width; w++) {
+                input_word_t pixel;
+                for (unsigned c = 0; c < CONFIG_T::n_chan; c++) pixel[c] = data[h][w][c];
+                in_stream.write(pixel);
+            }
+        }
+        nnet::conv_2d_binary_stream<input_word_t, res_word_t, CONFIG_T>(in_stream, out_stream, weights, biases);
+
+        for (unsigned oh = 0; oh < CONFIG_T::out_height; oh++) {
+            for (unsigned ow = 0; ow < CONFIG_T::out_width; ow++) {
+                res_word_t res_stream = out_stream.read();
+                for (unsigned ff = 0; ff < CONFIG_T::n_filt; ff++) {
+                    // Padding zeros add nothing
+                    double expected = biases[ff].to_double();
+                    for (unsigned fh = 0; fh < CONFIG_T::filt_height; fh++) {
+                        for (unsigned fw = 0; fw < CONFIG_T::filt_width; fw++) {
+                            int ih = oh * CONFIG_T::stride_height + fh - CONFIG_T::pad_top;
+                            int iw = ow * CONFIG_T::stride_width + fw - CONFIG_T::pad_left;
+                            if (ih < 0 || ih >= (int) CONFIG_T::in_height || iw < 0 || iw >= (int) CONFIG_T::in_width) continue;
+                            for (unsigned cc = 0; cc < CONFIG_T::n_chan; cc++) {
+                                unsigned index_weight = ((fh * CONFIG_T::filt_width + fw) * CONFIG_T::n_chan + cc) * CONFIG_T::n_filt + ff;
+                                expected += data[ih][iw][cc].to_double() * weight_value(weights[index_weight]);
+                            }
+                        }
+                    }
+                    if (res[oh][ow][ff].to_double() != expected || res_stream[ff].to_double() != expected) {
+                        if (n_errors++ < 5) printf("%s event %d [%u][%u][%u]: conv_2d_binary %f, conv_2d_binary_stream %f, expected %f\n",
+                                                   name, event, oh, ow, ff, res[oh][ow][ff].to_double(), res_stream[ff].to_double(), expected);
+                    }
+                }
+            }
+        }
+    }
+    return n_errors;
+}
+
+int main()
+{
+    srand(1);
+    int n_errors = 0;
+    n_errors += check_dense<config_dense<nnet::binary_weight_t, true> >("dense binary xnor");
+    n_errors += check_dense<config_dense<nnet::ternary_weight_t, true> >("dense ternary xnor");
+    n_errors += check_dense<config_dense<nnet::binary_weight_t, false> >("dense binary negate");
+    n_errors += check_dense<config_dense<nnet::ternary_weight_t, false> >("dense ternary negate");
+    n_errors += check_conv<config_conv<nnet::binary_weight_t, true> >("conv2d binary xnor");
+    n_errors += check_conv<config_conv<nnet::ternary_weight_t, true> >("conv2d ternary xnor");
+    n_errors += check_conv<config_conv<nnet::binary_weight_t, false> >("conv2d binary negate");
+    n_errors += check_conv<config_conv<nnet::ternary_weight_t, false> >("conv2d ternary negate");
+
+    if (n_errors > 0) {
+        printf("%d values differ\n", n_errors);
+        return 1;
+    }
+    printf("binary and ternary layers match the multiply-accumulate reference\n");
+    return 0;
+}
@@ -0,0 +1,140 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// nnet::concat and nnet::concat_words of two 2D outputs along each Keras axis, with
+// the sizes hls_writer.get_concat_sizes writes, against numpy.concatenate of the
+// (height, width, channels) tensors: flattened channel major for the arrays of
+// io_parallel (see nnet::flatten), channels last for the words of io_stream
+
+#include <stdio.h>
+#include "ap_fixed.h"
+#include "nnet_merge.h"
+
+typedef ap_fixed<16,13> layer_t;
+
+// Keras shapes of the inputs and the concatenation axis, without the batch axis
+template<unsigned H1, unsigned W1, unsigned C1, unsigned H2, unsigned W2, unsigned C2, unsigned AXIS>
+struct shapes
+{
+    static const unsigned h1 = H1, w1 = W1, c1 = C1, h2 = H2, w2 = W2, c2 = C2, axis = AXIS;
+    static const unsigned h = AXIS == 0 ? H1 + H2 : H1;
+    static const unsigned w = AXIS == 1 ? W1 + W2 : W1;
+    static const unsigned c = AXIS == 2 ? C1 + C2 : C1;
+};
+
+template<unsigned N_OUTER, unsigned N_ELEM1, unsigned N_ELEM2>
+struct config : nnet::concat_config {
+    static const unsigned n_outer = N_OUTER;
+    static const unsigned n_elem1 = N_ELEM1;
+    static const unsigned n_elem2 = N_ELEM2;
+};
+
+// Distinct values, input 2 from 1000 on
+double value(unsigned input, unsigned h, unsigned w, unsigned c) { return input * 1000 + (h * 8 + w) * 8 + c; }
+
+// numpy.concatenate((x1, x2), axis)[h, w, c]
+template<typename S>
+double expected(unsigned h, unsigned w, unsigned c)
+{
+    if (S::axis == 0) return h < S::h1 ? value(1, h, w, c) : value(2, h - S::h1, w, c);
+    if (S::axis == 1) return w < S::w1 ? value(1, h, w, c) : value(2, h, w - S::w1, c);
+    return c < S::c1 ? value(1, h, w, c) : value(2, h, w, c - S::c1);
+}
+
+// io_parallel: the arrays of the 2D outputs are channel major
+template<typename S, typename CONFIG_T>
+int check_array(const char *name)
+{
+    layer_t data1[S::c1 * S::h1 * S::w1];
+    layer_t data2[S::c2 * S::h2 * S::w2];
+    layer_t res[S::c * S::h * S::w];
+    for (unsigned c = 0; c < S::c1; c++) for (unsigned h = 0; h < S::h1; h++) for (unsigned w = 0; w < S::w1; w++) data1[(c * S::h1 + h) * S::w1 + w] = value(1, h, w, c);
+    for (unsigned c = 0; c < S::c2; c++) for (unsigned h = 0; h < S::h2; h++) for (unsigned w = 0; w < S::w2; w++) data2[(c * S::h2 + h) * S::w2 + w] = value(2, h, w, c);
+
+    nnet::concat<layer_t, layer_t, layer_t, CONFIG_T>(data1, data2, res);
+
+    int n_errors = 0;
+    for (unsigned c = 0; c < S::c; c++) for (unsigned h = 0; h < S::h; h++) for (unsigned w = 0; w < S::w; w++) {
+        double out = res[(c * S::h + h) * S::w + w].to_double();
+        if (out != expected<S>(h, w, c)) {
+            if (n_errors++ < 5) printf("%s [%u][%u][%u]: %f, expected %f\n", name, h, w, c, out, expected<S>(h, w, c));
+        }
+    }
+    return n_errors;
+}
+
+// io_stream: one word per pixel, concat joins the words of a pixel (last axis) and
+// concat_words passes whole pixels through (other axes)
+template<typename S, typename CONFIG_T>
+int check_stream(const char *name)
+{
+    typedef nnet::array<layer_t, S::c1> word1_t;
+    typedef nnet::array<layer_t, S::c2> word2_t;
+    typedef nnet::array<layer_t, S::c> res_word_t;
+    hls::stream<word1_t> data1("data1");
+    hls::stream<word2_t> data2("data2");
+    hls::stream<res_word_t> res("res");
+    for (unsigned h = 0; h < S::h1; h++) for (unsigned w = 0; w < S::w1; w++) {
+        word1_t word;
+        for (unsigned c = 0; c < S::c1; c++) word[c] = value(1, h, w, c);
+        data1.write(word);
+    }
+    for (unsigned h = 0; h < S::h2; h++) for (unsigned w = 0; w < S::w2; w++) {
+        word2_t word;
+        for (unsigned c = 0; c < S::c2; c++) word[c] = value(2, h, w, c);
+        data2.write(word);
+    }
+
+    if (S::axis == 2) nnet::concat<word1_t, word2_t, res_word_t, CONFIG_T>(data1, data2, res);
+    else nnet::concat_words<word1_t, word2_t, res_word_t, CONFIG_T>(data1, data2, res);
+
+    int n_errors = 0;
+    for (unsigned h = 0; h < S::h; h++) for (unsigned w = 0; w < S::w; w++) {
+        res_word_t word = res.read();
+        for (unsigned c = 0; c < S::c; c++) {
+            if (word[c].to_double() != expected<S>(h, w, c)) {
+                if (n_errors++ < 5) printf("%s [%u][%u][%u]: %f, expected %f\n", name, h, w, c, word[c].to_double(), expected<S>(h, w, c));
+            }
+        }
+    }
+    return n_errors;
+}
+
+int main()
+{
+    typedef shapes<4, 3, 2, 6, 3, 2, 0> height;
+    typedef shapes<4, 3, 2, 4, 5, 2, 1> width;
+    typedef shapes<4, 3, 2, 4, 3, 5, 2> channels;
+
+    // (n_outer, n_elem1, n_elem2) from get_concat_sizes
+    int n_errors = 0;
+    n_errors += check_array<height, config<2, 12, 18> >("io_parallel height");
+    n_errors += check_array<width, config<8, 3, 5> >("io_parallel width");
+    n_errors += check_array<channels, config<1, 24, 60> >("io_parallel channels");
+    n_errors += check_stream<height, config<1, 24, 36> >("io_stream height");
+    n_errors += check_stream<width, config<4, 6, 10> >("io_stream width");
+    n_errors += check_stream<channels, config<12, 2, 5> >("io_stream channels");
+
+    if (n_errors > 0) {
+        printf("%d values differ\n", n_errors);
+        return 1;
+    }
+    printf("concat matches numpy.concatenate\n");
+    return 0;
+}
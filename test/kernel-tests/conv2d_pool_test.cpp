@@ -0,0 +1,122 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// nnet::conv_2d_pool against nnet::conv_2d followed by nnet::pooling2d, with conv
+// outputs that overflow the layer type and wrap
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ap_fixed.h"
+#include "nnet_conv2d.h"
+#include "nnet_pooling.h"
+
+typedef ap_fixed<18,8> input_t;
+typedef ap_fixed<16,6> layer_t;
+
+struct config_conv : nnet::conv2d_config {
+    typedef ap_fixed<32,14> accum_t;
+    typedef ap_fixed<16,6> weight_t;
+    typedef ap_fixed<16,6> bias_t;
+    static const unsigned pad_top = 0;
+    static const unsigned pad_bottom = 0;
+    static const unsigned pad_left = 0;
+    static const unsigned pad_right = 0;
+    static const unsigned in_height = 6;
+    static const unsigned in_width = 6;
+    static const unsigned n_chan = 2;
+    static const unsigned filt_height = 3;
+    static const unsigned filt_width = 3;
+    static const unsigned n_filt = 3;
+    static const unsigned stride_height = 1;
+    static const unsigned stride_width = 1;
+    static const unsigned out_height = 4;
+    static const unsigned out_width = 4;
+};
+
+struct config_pool : nnet::pooling2d_config {
+    static const unsigned in_height = 4;
+    static const unsigned in_width = 4;
+    static const unsigned n_filt = 3;
+    static const unsigned stride_height = 2;
+    static const unsigned stride_width = 2;
+    static const unsigned pool_height = 2;
+    static const unsigned pool_width = 2;
+    static const unsigned out_height = 2;
+    static const unsigned out_width = 2;
+};
+
+int main()
+{
+    input_t data[config_conv::in_height][config_conv::in_width][config_conv::n_chan];
+    config_conv::weight_t weights[config_conv::filt_height * config_conv::filt_width * config_conv::n_chan * config_conv::n_filt];
+    config_conv::bias_t biases[config_conv::n_filt];
+
+    layer_t conv_out[config_conv::out_height][config_conv::out_width][config_conv::n_filt];
+    layer_t pool_out[config_pool::out_height][config_pool::out_width][config_conv::n_filt];
+    layer_t fused_out[config_pool::out_height][config_pool::out_width][config_conv::n_filt];
+
+    srand(1);
+    int n_errors = 0;
+    for (int event = 0; event < 100; event++) {
+        // Conv outputs of up to about +-100, most of them out of the range of layer_t
+        for (int i = 0; i < config_conv::in_height; i++)
+            for (int j = 0; j < config_conv::in_width; j++)
+                for (int c = 0; c < config_conv::n_chan; c++)
+                    data[i][j][c] = (rand() % 2001 - 1000) / 100.;
+        for (unsigned i = 0; i < sizeof(weights) / sizeof(weights[0]); i++) weights[i] = (rand() % 201 - 100) / 100.;
+        for (unsigned i = 0; i < config_conv::n_filt; i++) biases[i] = (rand() % 201 - 100) / 100.;
+
+        nnet::conv_2d<input_t, layer_t, config_conv>(data, conv_out, weights, biases);
+        nnet::pooling2d<layer_t, config_pool>(conv_out, pool_out);
+        nnet::conv_2d_pool<input_t, layer_t, config_conv, config_pool>(data, fused_out, weights, biases);
+
+        for (int i = 0; i < config_pool::out_height; i++)
+            for (int j = 0; j < config_pool::out_width; j++)
+                for (int f = 0; f < config_conv::n_filt; f++) {
+                    if (pool_out[i][j][f] != fused_out[i][j][f]) {
+                        if (n_errors++ < 10) printf("event %d output [%d][%d][%d]: conv_2d + pooling2d %f, conv_2d_pool %f\n", event, i, j, f, pool_out[i][j][f].to_double(), fused_out[i][j][f].to_double());
+                    }
+                }
+    }
+
+    // The case of the cast not keeping the order: 33 wraps to -31 in ap_fixed<16,6>,
+    // the pooled output is 20 either way
+    for (int i = 0; i < config_conv::in_height; i++)
+        for (int j = 0; j < config_conv::in_width; j++)
+            for (int c = 0; c < config_conv::n_chan; c++)
+                data[i][j][c] = c == 0 ? (i == 1 && j == 1 ? 33 : 20) : 0;
+    for (unsigned i = 0; i < sizeof(weights) / sizeof(weights[0]); i++) weights[i] = 0;
+    for (unsigned i = 0; i < config_conv::n_filt; i++) {
+        biases[i] = 0;
+        // Centre tap of the first channel
+        weights[(1*config_conv::filt_width + 1)*config_conv::n_chan*config_conv::n_filt + i] = 1;
+    }
+    nnet::conv_2d_pool<input_t, layer_t, config_conv, config_pool>(data, fused_out, weights, biases);
+    if (fused_out[0][0][0] != 20) {
+        printf("conv outputs 33 and 20: conv_2d_pool %f, expected 20\n", fused_out[0][0][0].to_double());
+        n_errors++;
+    }
+
+    if (n_errors > 0) {
+        printf("%d outputs differ\n", n_errors);
+        return 1;
+    }
+    printf("conv_2d_pool matches conv_2d + pooling2d\n");
+    return 0;
+}
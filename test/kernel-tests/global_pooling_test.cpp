@@ -0,0 +1,121 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// nnet::global_pooling and nnet::global_pooling_stream averages against a double
+// reference, with the types hls_writer uses for a DefaultPrecision of ap_fixed<16,6>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "ap_fixed.h"
+#include "nnet_pooling.h"
+
+typedef ap_fixed<16,6> layer_t;
+
+// 7x7 pixels, 1/49 is not exact in any binary type
+struct config_avg49 : nnet::global_pooling_config {
+    static const unsigned n_in = 49;
+    static const unsigned n_filt = 3;
+    static const bool filt_major = true;
+    static const nnet::Pool_Op pool_op = nnet::Average;
+    typedef ap_fixed<16,6> accum_t;
+    typedef ap_ufixed<18,-4,AP_RND> scale_t;
+};
+
+// 4x4 pixels, 1/16 is exact
+struct config_avg16 : nnet::global_pooling_config {
+    static const unsigned n_in = 16;
+    static const unsigned n_filt = 3;
+    static const bool filt_major = false;
+    static const nnet::Pool_Op pool_op = nnet::Average;
+    typedef ap_fixed<16,6> accum_t;
+    typedef ap_ufixed<18,-3,AP_RND> scale_t;
+};
+
+const double lsb = 1.0 / 1024; // of layer_t
+
+// Reference: the average of the inputs, truncated to layer_t
+template<typename CONFIG_T>
+double reference(layer_t data[CONFIG_T::n_in * CONFIG_T::n_filt], unsigned ff)
+{
+    double sum = 0;
+    for (unsigned ii = 0; ii < CONFIG_T::n_in; ii++) {
+        sum += data[CONFIG_T::filt_major ? ff * CONFIG_T::n_in + ii : ii * CONFIG_T::n_filt + ff].to_double();
+    }
+    return floor(sum / CONFIG_T::n_in / lsb) * lsb;
+}
+
+// Errors above max_error, of the array and the stream kernels
+template<typename CONFIG_T>
+int check(layer_t data[CONFIG_T::n_in * CONFIG_T::n_filt], double max_error, const char *name)
+{
+    typedef nnet::array<layer_t, CONFIG_T::n_filt> word_t;
+    layer_t res[CONFIG_T::n_filt];
+    nnet::global_pooling<layer_t, layer_t, CONFIG_T>(data, res);
+
+    hls::stream<word_t> in_stream("in_stream");
+    hls::stream<word_t> out_stream("out_stream");
+    for (unsigned ii = 0; ii < CONFIG_T::n_in; ii++) {
+        word_t pixel;
+        for (unsigned ff = 0; ff < CONFIG_T::n_filt; ff++) {
+            pixel[ff] = data[CONFIG_T::filt_major ? ff * CONFIG_T::n_in + ii : ii * CONFIG_T::n_filt + ff];
+        }
+        in_stream.write(pixel);
+    }
+    nnet::global_pooling_stream<word_t, word_t, CONFIG_T>(in_stream, out_stream);
+    word_t res_stream = out_stream.read();
+
+    int n_errors = 0;
+    for (unsigned ff = 0; ff < CONFIG_T::n_filt; ff++) {
+        double expected = reference<CONFIG_T>(data, ff);
+        if (fabs(res[ff].to_double() - expected) > max_error || fabs(res_stream[ff].to_double() - expected) > max_error) {
+            printf("%s filter %u: global_pooling %f, global_pooling_stream %f, expected %f\n", name, ff, res[ff].to_double(), res_stream[ff].to_double(), expected);
+            n_errors++;
+        }
+    }
+    return n_errors;
+}
+
+int main()
+{
+    layer_t data49[config_avg49::n_in * config_avg49::n_filt];
+    layer_t data16[config_avg16::n_in * config_avg16::n_filt];
+
+    srand(1);
+    int n_errors = 0;
+    for (int event = 0; event < 100; event++) {
+        // Sums of up to about 29, within the range of accum_t
+        for (unsigned i = 0; i < config_avg49::n_in * config_avg49::n_filt; i++) data49[i] = (rand() % 601) / 1000.;
+        for (unsigned i = 0; i < config_avg16::n_in * config_avg16::n_filt; i++) data16[i] = (rand() % 3001 - 1000) / 1000.;
+        // At most one LSB of layer_t away when 1/n_in is rounded, exact otherwise
+        n_errors += check<config_avg49>(data49, lsb, "7x7");
+        n_errors += check<config_avg16>(data16, 0, "4x4");
+    }
+
+    // The average of equal values is that value
+    for (unsigned i = 0; i < config_avg49::n_in * config_avg49::n_filt; i++) data49[i] = 0.5;
+    n_errors += check<config_avg49>(data49, lsb, "7x7 of 0.5");
+
+    if (n_errors > 0) {
+        printf("%d averages differ\n", n_errors);
+        return 1;
+    }
+    printf("global_pooling averages match the reference\n");
+    return 0;
+}
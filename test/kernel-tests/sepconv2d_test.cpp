@@ -0,0 +1,200 @@
+//
+//    rfnoc-hls-neuralnet: Vivado HLS code for neural-net building blocks
+//
+//    Copyright (C) 2017 EJ Kreinar
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+// nnet::depthwise_conv_2d followed by nnet::pointwise_conv_2d, and their stream
+// versions, against a direct convolution with the Keras kernels of SeparableConv2D,
+// depthwise (filt_height, filt_width, n_chan, depth_multiplier) and pointwise
+// (1, 1, n_chan*depth_multiplier, n_filt). The depthwise weights are the Keras kernel
+// reshaped to (filt_height, filt_width, n_chan*depth_multiplier) as keras-to-hls.py
+// does, weight (fh*filt_width + fw)*n_filt + ff. All values are multiples of 1/64,
+// the results are exact.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ap_fixed.h"
+#include "nnet_sepconv2d.h"
+
+typedef ap_fixed<16,6> input_t;
+typedef ap_fixed<32,14> layer_t;
+
+// Same padding, windows on the edges cover padding zeros
+struct config_same : nnet::depthwise_conv2d_config {
+    typedef ap_fixed<32,14> accum_t;
+    typedef ap_fixed<16,6> weight_t;
+    typedef ap_fixed<16,6> bias_t;
+    static const unsigned pad_top = 1;
+    static const unsigned pad_bottom = 1;
+    static const unsigned pad_left = 1;
+    static const unsigned pad_right = 1;
+    static const unsigned in_height = 5;
+    static const unsigned in_width = 5;
+    static const unsigned n_chan = 2;
+    static const unsigned filt_height = 3;
+    static const unsigned filt_width = 3;
+    static const unsigned depth_multiplier = 3;
+    static const unsigned n_filt = 6;
+    static const unsigned stride_height = 1;
+    static const unsigned stride_width = 1;
+    static const unsigned out_height = 5;
+    static const unsigned out_width = 5;
+};
+
+// Valid padding with strides and a filter that is not square
+struct config_strided : nnet::depthwise_conv2d_config {
+    typedef ap_fixed<32,14> accum_t;
+    typedef ap_fixed<16,6> weight_t;
+    typedef ap_fixed<16,6> bias_t;
+    static const unsigned pad_top = 0;
+    static const unsigned pad_bottom = 0;
+    static const unsigned pad_left = 0;
+    static const unsigned pad_right = 0;
+    static const unsigned in_height = 7;
+    static const unsigned in_width = 6;
+    static const unsigned n_chan = 3;
+    static const unsigned filt_height = 3;
+    static const unsigned filt_width = 2;
+    static const unsigned depth_multiplier = 2;
+    static const unsigned n_filt = 6;
+    static const unsigned stride_height = 2;
+    static const unsigned stride_width = 2;
+    static const unsigned out_height = 3;
+    static const unsigned out_width = 3;
+};
+
+template<typename DW_CONFIG_T, unsigned N_FILT>
+struct config_pointwise : nnet::pointwise_conv2d_config {
+    typedef ap_fixed<32,14> accum_t;
+    typedef ap_fixed<16,6> weight_t;
+    typedef ap_fixed<16,6> bias_t;
+    static const unsigned in_height = DW_CONFIG_T::out_height;
+    static const unsigned in_width = DW_CONFIG_T::out_width;
+    static const unsigned n_chan = DW_CONFIG_T::n_filt;
+    static const unsigned n_filt = N_FILT;
+};
+
+double random_value(int range) { return (rand() % (2 * range + 1) - range) / 64.; }
+
+template<typename DW_CONFIG_T, typename PW_CONFIG_T>
+int check(const char *name)
+{
+    typedef DW_CONFIG_T dw;
+    typedef PW_CONFIG_T pw;
+    typedef nnet::array<input_t, dw::n_chan> input_word_t;
+    typedef nnet::array<layer_t, dw::n_filt> dw_word_t;
+    typedef nnet::array<layer_t, pw::n_filt> res_word_t;
+
+    input_t data[dw::in_height][dw::in_width][dw::n_chan];
+    double kernel[dw::filt_height][dw::filt_width][dw::n_chan][dw::depth_multiplier];
+    typename dw::weight_t dw_weights[dw::filt_height * dw::filt_width * dw::n_filt];
+    typename dw::bias_t dw_biases[dw::n_filt];
+    typename pw::weight_t pw_weights[pw::n_chan * pw::n_filt];
+    typename pw::bias_t pw_biases[pw::n_filt];
+    layer_t dw_out[dw::out_height][dw::out_width][dw::n_filt];
+    layer_t res[dw::out_height][dw::out_width][pw::n_filt];
+
+    int n_errors = 0;
+    for (int event = 0; event < 100; event++) {
+        for (unsigned h = 0; h < dw::in_height; h++)
+            for (unsigned w = 0; w < dw::in_width; w++)
+                for (unsigned c = 0; c < dw::n_chan; c++)
+                    data[h][w][c] = random_value(128);
+        // numpy.reshape of the Keras kernel, in C order
+        unsigned index = 0;
+        for (unsigned fh = 0; fh < dw::filt_height; fh++)
+            for (unsigned fw = 0; fw < dw::filt_width; fw++)
+                for (unsigned c = 0; c < dw::n_chan; c++)
+                    for (unsigned m = 0; m < dw::depth_multiplier; m++) {
+                        kernel[fh][fw][c][m] = random_value(64);
+                        dw_weights[index++] = kernel[fh][fw][c][m];
+                    }
+        // Keras has no depthwise bias in SeparableConv2D, DepthwiseConv2D has one
+        for (unsigned i = 0; i < dw::n_filt; i++) dw_biases[i] = random_value(64);
+        for (unsigned i = 0; i < pw::n_chan * pw::n_filt; i++) pw_weights[i] = random_value(64);
+        for (unsigned i = 0; i < pw::n_filt; i++) pw_biases[i] = random_value(64);
+
+        nnet::depthwise_conv_2d<input_t, layer_t, dw>(data, dw_out, dw_weights, dw_biases);
+        nnet::pointwise_conv_2d<layer_t, layer_t, pw>(dw_out, res, pw_weights, pw_biases);
+
+        hls::stream<input_word_t> in_stream("in_stream");
+        hls::stream<dw_word_t> dw_stream("dw_stream");
+        hls::stream<res_word_t> out_stream("out_stream");
+        for (unsigned h = 0; h < dw::in_height; h++) {
+            for (unsigned w = 0; w < dw::in_width; w++) {
+                input_word_t pixel;
+                for (unsigned c = 0; c < dw::n_chan; c++) pixel[c] = data[h][w][c];
+                in_stream.write(pixel);
+            }
+        }
+        nnet::depthwise_conv_2d_stream<input_word_t, dw_word_t, dw>(in_stream, dw_stream, dw_weights, dw_biases);
+        nnet::pointwise_conv_2d_stream<dw_word_t, res_word_t, pw>(dw_stream, out_stream, pw_weights, pw_biases);
+
+        for (unsigned oh = 0; oh < dw::out_height; oh++) {
+            for (unsigned ow = 0; ow < dw::out_width; ow++) {
+                // Depthwise: filter m of channel c is output c*depth_multiplier + m
+                double expected_dw[dw::n_filt];
+                for (unsigned c = 0; c < dw::n_chan; c++) {
+                    for (unsigned m = 0; m < dw::depth_multiplier; m++) {
+                        double acc = dw_biases[c * dw::depth_multiplier + m].to_double();
+                        for (unsigned fh = 0; fh < dw::filt_height; fh++) {
+                            for (unsigned fw = 0; fw < dw::filt_width; fw++) {
+                                int ih = oh * dw::stride_height + fh - dw::pad_top;
+                                int iw = ow * dw::stride_width + fw - dw::pad_left;
+                                if (ih < 0 || ih >= (int) dw::in_height || iw < 0 || iw >= (int) dw::in_width) continue;
+                                acc += data[ih][iw][c].to_double() * kernel[fh][fw][c][m];
+                            }
+                        }
+                        expected_dw[c * dw::depth_multiplier + m] = acc;
+                        if (dw_out[oh][ow][c * dw::depth_multiplier + m].to_double() != acc) {
+                            if (n_errors++ < 5) printf("%s depthwise event %d [%u][%u] channel %u filter %u: %f, expected %f\n",
+                                                       name, event, oh, ow, c, m, dw_out[oh][ow][c * dw::depth_multiplier + m].to_double(), acc);
+                        }
+                    }
+                }
+                // Pointwise, weight cc*n_filt + ff
+                res_word_t res_stream = out_stream.read();
+                for (unsigned ff = 0; ff < pw::n_filt; ff++) {
+                    double expected = pw_biases[ff].to_double();
+                    for (unsigned cc = 0; cc < pw::n_chan; cc++) {
+                        expected += expected_dw[cc] * pw_weights[cc * pw::n_filt + ff].to_double();
+                    }
+                    if (res[oh][ow][ff].to_double() != expected || res_stream[ff].to_double() != expected) {
+                        if (n_errors++ < 5) printf("%s event %d [%u][%u][%u]: pointwise_conv_2d %f, pointwise_conv_2d_stream %f, expected %f\n",
+                                                   name, event, oh, ow, ff, res[oh][ow][ff].to_double(), res_stream[ff].to_double(), expected);
+                    }
+                }
+            }
+        }
+    }
+    return n_errors;
+}
+
+int main()
+{
+    srand(1);
+    int n_errors = 0;
+    n_errors += check<config_same, config_pointwise<config_same, 4> >("same");
+    n_errors += check<config_strided, config_pointwise<config_strided, 5> >("strided");
+
+    if (n_errors > 0) {
+        printf("%d values differ\n", n_errors);
+        return 1;
+    }
+    printf("depthwise and pointwise conv2d match the direct convolution\n");
+    return 0;
+}